@@ -0,0 +1,198 @@
+// Copyright 2025-current Getnamo.
+
+#include "Internal/LlamaChatRenderer.h"
+
+namespace
+{
+    static void AppendAt(std::vector<char>& Buffer, int32& Length, const std::string& Text)
+    {
+        if (Buffer.size() < (size_t)Length + Text.size())
+        {
+            Buffer.resize(Length + Text.size());
+        }
+        memcpy(Buffer.data() + Length, Text.data(), Text.size());
+        Length += (int32)Text.size();
+    }
+
+    //Out = Longer minus Shorter if Shorter is a prefix of Longer
+    static bool SuffixAfterPrefix(const std::vector<char>& Longer, int32 LongerLen, const std::vector<char>& Shorter, int32 ShorterLen, std::string& Out)
+    {
+        if (LongerLen < 0 || ShorterLen < 0 || ShorterLen > LongerLen)
+        {
+            return false;
+        }
+        if (ShorterLen > 0 && memcmp(Longer.data(), Shorter.data(), ShorterLen) != 0)
+        {
+            return false;
+        }
+        Out.assign(Longer.data() + ShorterLen, Longer.data() + LongerLen);
+        return true;
+    }
+}
+
+void FLlamaChatTemplateRenderer::SetTemplate(const std::string& InTemplate)
+{
+    Template = InTemplate;
+    bPrefixStable = ProbePrefixStable(Template);
+    Reset();
+}
+
+void FLlamaChatTemplateRenderer::Reset()
+{
+    CachedContents.clear();
+    MessageEndOffsets.clear();
+}
+
+int32 FLlamaChatTemplateRenderer::RenderFull(const std::string& InTemplate, const llama_chat_message* Messages, size_t Count, bool bAddAssistant, std::vector<char>& Out)
+{
+    //Empty template means llama.cpp's default
+    const char* TemplatePtr = InTemplate.empty() ? nullptr : InTemplate.c_str();
+
+    int32 Length = llama_chat_apply_template(TemplatePtr, Messages, Count, bAddAssistant, Out.data(), Out.size());
+
+    //Resize once if Out can't hold it
+    if (Length > (int32)Out.size())
+    {
+        Out.resize(Length);
+        Length = llama_chat_apply_template(TemplatePtr, Messages, Count, bAddAssistant, Out.data(), Out.size());
+    }
+    return Length;
+}
+
+int32 FLlamaChatTemplateRenderer::Render(const std::vector<llama_chat_message>& Messages, bool bAddAssistant, std::vector<char>& Buffer)
+{
+    const int32 Count = (int32)Messages.size();
+    if (!bPrefixStable || Count == 0)
+    {
+        Reset();
+        return RenderFull(Template, Messages.data(), Messages.size(), bAddAssistant, Buffer);
+    }
+
+    //Longest cached prefix that still matches the message list
+    int32 Cached = 0;
+    const int32 MaxCached = FMath::Min((int32)CachedContents.size(), Count);
+    while (Cached < MaxCached && CachedContents[Cached] == Messages[Cached].content)
+    {
+        Cached++;
+    }
+
+    //Buffer was cleared or truncated below the cached text
+    if (Cached > 0 && MessageEndOffsets[Cached - 1] > (int32)Buffer.size())
+    {
+        Cached = 0;
+    }
+    CachedContents.resize(Cached);
+    MessageEndOffsets.resize(Cached);
+
+    int32 Length = Cached > 0 ? MessageEndOffsets[Cached - 1] : 0;
+    std::string Delta;
+
+    for (int32 i = Cached; i < Count; i++)
+    {
+        if (!RenderMessageDelta(Messages, i, Delta))
+        {
+            //Content dependent instability, fall back to a full render for this list
+            Reset();
+            return RenderFull(Template, Messages.data(), Messages.size(), bAddAssistant, Buffer);
+        }
+        AppendAt(Buffer, Length, Delta);
+        CachedContents.push_back(Messages[i].content);
+        MessageEndOffsets.push_back(Length);
+    }
+
+    //The assistant header is rewritten by the reply on the next render, so it isn't cached
+    if (bAddAssistant)
+    {
+        if (!RenderAssistantHeader(Messages, Delta))
+        {
+            Reset();
+            return RenderFull(Template, Messages.data(), Messages.size(), bAddAssistant, Buffer);
+        }
+        AppendAt(Buffer, Length, Delta);
+    }
+
+    return Length;
+}
+
+bool FLlamaChatTemplateRenderer::RenderMessageDelta(const std::vector<llama_chat_message>& Messages, int32 Index, std::string& OutDelta)
+{
+    if (Index == 0)
+    {
+        const int32 Length = RenderFull(Template, Messages.data(), 1, false, ScratchB);
+        if (Length < 0)
+        {
+            return false;
+        }
+        OutDelta.assign(ScratchB.data(), ScratchB.data() + Length);
+        return true;
+    }
+
+    //Render [previous] and [previous, current], the difference is what current adds
+    const llama_chat_message* Anchor = Messages.data() + Index - 1;
+    const int32 AnchorLength = RenderFull(Template, Anchor, 1, false, ScratchA);
+    const int32 PairLength = RenderFull(Template, Anchor, 2, false, ScratchB);
+
+    return SuffixAfterPrefix(ScratchB, PairLength, ScratchA, AnchorLength, OutDelta);
+}
+
+bool FLlamaChatTemplateRenderer::RenderAssistantHeader(const std::vector<llama_chat_message>& Messages, std::string& OutHeader)
+{
+    const llama_chat_message* Last = Messages.data() + Messages.size() - 1;
+    const int32 WithoutLength = RenderFull(Template, Last, 1, false, ScratchA);
+    const int32 WithLength = RenderFull(Template, Last, 1, true, ScratchB);
+
+    return SuffixAfterPrefix(ScratchB, WithLength, ScratchA, WithoutLength, OutHeader);
+}
+
+bool FLlamaChatTemplateRenderer::ProbePrefixStable(const std::string& InTemplate)
+{
+    static const char* Roles[] = { "system", "user", "assistant", "user", "assistant", "user" };
+    static const char* Contents[] = {
+        "You are a helpful assistant.",
+        "Hello there.",
+        "Hi! How can I help?",
+        "Tell me a story.",
+        "Once upon a time.",
+        "Thanks."
+    };
+
+    //Conversations with and without a leading system message
+    for (int32 Start = 0; Start < 2; Start++)
+    {
+        FLlamaChatTemplateRenderer Probe;
+        Probe.Template = InTemplate;
+        Probe.bPrefixStable = true;
+
+        std::vector<llama_chat_message> Messages;
+        std::vector<char> Incremental;
+        std::vector<char> Full;
+
+        for (int32 i = Start; i < 6; i++)
+        {
+            Messages.push_back({ Roles[i], Contents[i] });
+
+            for (const bool bAddAssistant : { true, false })
+            {
+                const int32 FullLength = RenderFull(InTemplate, Messages.data(), Messages.size(), bAddAssistant, Full);
+                if (FullLength < 0)
+                {
+                    return false;
+                }
+
+                const int32 IncrementalLength = Probe.Render(Messages, bAddAssistant, Incremental);
+                if (IncrementalLength != FullLength ||
+                    memcmp(Incremental.data(), Full.data(), FullLength) != 0)
+                {
+                    return false;
+                }
+
+                //Render fell back internally, the delta path didn't hold
+                if ((int32)Probe.CachedContents.size() != (int32)Messages.size())
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
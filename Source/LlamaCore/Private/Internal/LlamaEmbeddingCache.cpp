@@ -0,0 +1,394 @@
+// Copyright 2025-current Getnamo.
+
+#include "Internal/LlamaEmbeddingCache.h"
+#include "LlamaUtility.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+    //File: magic + version, then records of { ModelKey, TextHash, TextBytes, Dim, float[Dim] }
+    static constexpr uint32 CacheFileMagic = 0x3143454C; //"LEC1"
+    static constexpr uint32 CacheFileVersion = 1;
+    static constexpr int64 CacheFileHeaderSize = 2 * sizeof(uint32);
+    static constexpr int64 RecordHeaderSize = 2 * sizeof(uint64) + 2 * sizeof(uint32);
+    static constexpr int64 FingerprintSpan = 1024 * 1024;
+
+    static void AppendBytes(TArray<uint8>& Out, const void* Data, int64 Size)
+    {
+        Out.Append(static_cast<const uint8*>(Data), Size);
+    }
+}
+
+FLlamaEmbeddingCache& FLlamaEmbeddingCache::Get()
+{
+    static FLlamaEmbeddingCache Cache;
+    return Cache;
+}
+
+FLlamaEmbeddingCache::FLlamaEmbeddingCache()
+    : Memory(1)
+{
+    FilePath = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() / TEXT("LlamaCache") / TEXT("Embeddings.lec"));
+}
+
+FLlamaEmbeddingCacheKey FLlamaEmbeddingCache::MakeKey(uint64 ModelKey, const std::string& Text)
+{
+    FLlamaEmbeddingCacheKey Key;
+    Key.ModelKey = ModelKey;
+    Key.TextHash = CityHash64(Text.data(), Text.size());
+    Key.TextBytes = (uint32)Text.size();
+    return Key;
+}
+
+uint64 FLlamaEmbeddingCache::FingerprintModelFile(const FString& Path)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+    if (!Reader)
+    {
+        return 0;
+    }
+
+    const int64 Size = Reader->TotalSize();
+    const int64 HeadBytes = FMath::Min(Size, FingerprintSpan);
+    const int64 TailBytes = FMath::Min(Size - HeadBytes, FingerprintSpan);
+
+    TArray<uint8> Bytes;
+    Bytes.SetNumUninitialized(HeadBytes + TailBytes);
+    Reader->Serialize(Bytes.GetData(), HeadBytes);
+    if (TailBytes > 0)
+    {
+        Reader->Seek(Size - TailBytes);
+        Reader->Serialize(Bytes.GetData() + HeadBytes, TailBytes);
+    }
+    if (Reader->IsError())
+    {
+        return 0;
+    }
+
+    return CityHash64WithSeed(reinterpret_cast<const char*>(Bytes.GetData()), Bytes.Num(), (uint64)Size);
+}
+
+void FLlamaEmbeddingCache::Configure(int32 MemoryEntries, bool bPersist, int64 InMaxFileBytes)
+{
+    FScopeLock Lock(&Mutex);
+    MaxFileBytes = FMath::Max(MaxFileBytes, InMaxFileBytes);
+
+    //The LRU can't be resized in place, growing it drops the memory tier (the file keeps everything persisted)
+    if (MemoryEntries > Memory.Max())
+    {
+        Memory.Empty(MemoryEntries);
+    }
+    if (bPersist && !bPersistent)
+    {
+        bPersistent = true;
+        OpenFile();
+    }
+}
+
+void FLlamaEmbeddingCache::OpenFile()
+{
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
+
+    const int64 FileSize = IFileManager::Get().FileSize(*FilePath);
+    if (FileSize <= 0)
+    {
+        IFileManager::Get().Delete(*FilePath, false, true, true);
+        AppendBytes(Pending, &CacheFileMagic, sizeof(uint32));
+        AppendBytes(Pending, &CacheFileVersion, sizeof(uint32));
+        return;
+    }
+
+    MapFile();
+    IndexMappedRecords();
+
+    //Limit may have been lowered since the file was written
+    if (MappedSize > MaxFileBytes)
+    {
+        CompactFile();
+    }
+}
+
+void FLlamaEmbeddingCache::MapFile()
+{
+    UnmapFile();
+
+    IMappedFileHandle* Handle = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath);
+    if (!Handle)
+    {
+        return;
+    }
+    MappedHandle.Reset(Handle);
+    if (MappedHandle->GetFileSize() > 0)
+    {
+        MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+    }
+    MappedSize = MappedRegion ? MappedRegion->GetMappedSize() : 0;
+}
+
+void FLlamaEmbeddingCache::UnmapFile()
+{
+    MappedRegion.Reset();
+    MappedHandle.Reset();
+    MappedSize = 0;
+}
+
+void FLlamaEmbeddingCache::IndexMappedRecords()
+{
+    const uint8* Data = MappedRegion ? MappedRegion->GetMappedPtr() : nullptr;
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    if (Data && MappedSize >= CacheFileHeaderSize)
+    {
+        FMemory::Memcpy(&Magic, Data, sizeof(uint32));
+        FMemory::Memcpy(&Version, Data + sizeof(uint32), sizeof(uint32));
+    }
+    if (Magic != CacheFileMagic || Version != CacheFileVersion)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Embedding cache %s has an unknown format, starting a new one"), *FilePath);
+        UnmapFile();
+        IFileManager::Get().Delete(*FilePath, false, true, true);
+        Pending.Reset();
+        AppendBytes(Pending, &CacheFileMagic, sizeof(uint32));
+        AppendBytes(Pending, &CacheFileVersion, sizeof(uint32));
+        return;
+    }
+
+    int64 Offset = CacheFileHeaderSize;
+    while (Offset + RecordHeaderSize <= MappedSize)
+    {
+        FLlamaEmbeddingCacheKey Key;
+        uint32 Dim = 0;
+        FMemory::Memcpy(&Key.ModelKey, Data + Offset, sizeof(uint64));
+        FMemory::Memcpy(&Key.TextHash, Data + Offset + sizeof(uint64), sizeof(uint64));
+        FMemory::Memcpy(&Key.TextBytes, Data + Offset + 2 * sizeof(uint64), sizeof(uint32));
+        FMemory::Memcpy(&Dim, Data + Offset + 2 * sizeof(uint64) + sizeof(uint32), sizeof(uint32));
+
+        const int64 RecordSize = RecordHeaderSize + (int64)Dim * sizeof(float);
+        if (Offset + RecordSize > MappedSize)
+        {
+            break;
+        }
+        DiskIndex.Add(Key, Offset);
+        Offset += RecordSize;
+    }
+
+    //A record cut short by a crash, keep the valid prefix so appends stay aligned
+    if (Offset < MappedSize)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Embedding cache %s ends in a partial record, dropping %lld bytes"), *FilePath, MappedSize - Offset);
+        TArray<uint8> Valid(Data, (int32)Offset);
+        UnmapFile();
+        FFileHelper::SaveArrayToFile(Valid, *FilePath);
+        MapFile();
+    }
+
+    UE_LOG(LlamaLog, Log, TEXT("Embedding cache %s: %d vectors"), *FilePath, DiskIndex.Num());
+}
+
+bool FLlamaEmbeddingCache::Find(const FLlamaEmbeddingCacheKey& Key, std::vector<float>& OutEmbedding)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (const std::vector<float>* Cached = Memory.FindAndTouch(Key))
+    {
+        OutEmbedding = *Cached;
+        return true;
+    }
+
+    const int64* Offset = DiskIndex.Find(Key);
+    if (!Offset)
+    {
+        return false;
+    }
+
+    //Mapped file or the not yet flushed tail, which starts where the mapping ends
+    const uint8* Record = *Offset < MappedSize ?
+        MappedRegion->GetMappedPtr() + *Offset :
+        Pending.GetData() + (*Offset - MappedSize);
+
+    uint32 Dim = 0;
+    FMemory::Memcpy(&Dim, Record + 2 * sizeof(uint64) + sizeof(uint32), sizeof(uint32));
+    OutEmbedding.resize(Dim);
+    FMemory::Memcpy(OutEmbedding.data(), Record + RecordHeaderSize, (int64)Dim * sizeof(float));
+
+    Memory.Add(Key, OutEmbedding);
+    return true;
+}
+
+void FLlamaEmbeddingCache::Add(const FLlamaEmbeddingCacheKey& Key, const std::vector<float>& Embedding)
+{
+    if (Embedding.empty())
+    {
+        return;
+    }
+
+    FScopeLock Lock(&Mutex);
+    Memory.Add(Key, Embedding);
+
+    if (!bPersistent || DiskIndex.Contains(Key))
+    {
+        return;
+    }
+
+    const uint32 Dim = (uint32)Embedding.size();
+    DiskIndex.Add(Key, MappedSize + Pending.Num());
+    AppendBytes(Pending, &Key.ModelKey, sizeof(uint64));
+    AppendBytes(Pending, &Key.TextHash, sizeof(uint64));
+    AppendBytes(Pending, &Key.TextBytes, sizeof(uint32));
+    AppendBytes(Pending, &Dim, sizeof(uint32));
+    AppendBytes(Pending, Embedding.data(), (int64)Dim * sizeof(float));
+}
+
+void FLlamaEmbeddingCache::Flush()
+{
+    FScopeLock Lock(&Mutex);
+    if (!bPersistent || Pending.Num() == 0)
+    {
+        return;
+    }
+
+    if (MappedSize + Pending.Num() > MaxFileBytes)
+    {
+        CompactFile();
+        return;
+    }
+
+    //Writes can't go through the read-only mapping, unmap, append, remap
+    const int64 ExpectedSize = MappedSize + Pending.Num();
+    UnmapFile();
+
+    bool bWritten = false;
+    {
+        TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FilePath, FILEWRITE_Append));
+        if (Writer)
+        {
+            Writer->Serialize(Pending.GetData(), Pending.Num());
+            bWritten = Writer->Close();
+        }
+    }
+
+    MapFile();
+    if (!bWritten || MappedSize != ExpectedSize)
+    {
+        //Keep serving from memory, the file is re-validated on the next open
+        UE_LOG(LlamaLog, Warning, TEXT("Embedding cache: failed to append to %s, persistence disabled for this session"), *FilePath);
+        UnmapFile();
+        DiskIndex.Empty();
+        bPersistent = false;
+    }
+    Pending.Reset();
+}
+
+void FLlamaEmbeddingCache::CompactFile()
+{
+    //Mapped file then the pending tail form one stream of records in insertion order, keep its newest end
+    const int64 TotalSize = MappedSize + Pending.Num();
+    auto RecordAt = [this](int64 Offset)
+    {
+        return Offset < MappedSize ? MappedRegion->GetMappedPtr() + Offset : Pending.GetData() + (Offset - MappedSize);
+    };
+
+    int64 KeepFrom = CacheFileHeaderSize;
+    while (KeepFrom < TotalSize && TotalSize - KeepFrom > MaxFileBytes / 2)
+    {
+        uint32 Dim = 0;
+        FMemory::Memcpy(&Dim, RecordAt(KeepFrom) + 2 * sizeof(uint64) + sizeof(uint32), sizeof(uint32));
+        KeepFrom += RecordHeaderSize + (int64)Dim * sizeof(float);
+    }
+
+    //Written next to the file and moved over it, the mapping still reads the old one
+    const FString TempPath = FilePath + TEXT(".tmp");
+    bool bWritten = false;
+    {
+        TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+        if (Writer)
+        {
+            uint32 Magic = CacheFileMagic;
+            uint32 Version = CacheFileVersion;
+            Writer->Serialize(&Magic, sizeof(uint32));
+            Writer->Serialize(&Version, sizeof(uint32));
+            if (KeepFrom < MappedSize)
+            {
+                Writer->Serialize(const_cast<uint8*>(MappedRegion->GetMappedPtr()) + KeepFrom, MappedSize - KeepFrom);
+            }
+            const int64 PendingFrom = FMath::Max<int64>(KeepFrom - MappedSize, 0);
+            Writer->Serialize(Pending.GetData() + PendingFrom, Pending.Num() - PendingFrom);
+            bWritten = Writer->Close();
+        }
+    }
+
+    UnmapFile();
+    Pending.Reset();
+    DiskIndex.Empty();
+    if (!bWritten || !IFileManager::Get().Move(*FilePath, *TempPath, true, true))
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Embedding cache: failed to compact %s, persistence disabled for this session"), *FilePath);
+        IFileManager::Get().Delete(*TempPath, false, true, true);
+        bPersistent = false;
+        return;
+    }
+
+    UE_LOG(LlamaLog, Log, TEXT("Embedding cache %s reached its %lld byte limit, dropped the oldest %lld bytes"), *FilePath, MaxFileBytes, KeepFrom - CacheFileHeaderSize);
+    MapFile();
+    IndexMappedRecords();
+}
+
+void FLlamaEmbeddingCache::Clear(bool bDeleteFile)
+{
+    FScopeLock Lock(&Mutex);
+    Memory.Empty(Memory.Max());
+    if (!bDeleteFile)
+    {
+        return;
+    }
+
+    UnmapFile();
+    DiskIndex.Empty();
+    Pending.Reset();
+    IFileManager::Get().Delete(*FilePath, false, true, true);
+    if (bPersistent)
+    {
+        AppendBytes(Pending, &CacheFileMagic, sizeof(uint32));
+        AppendBytes(Pending, &CacheFileVersion, sizeof(uint32));
+    }
+}
+
+int32 FLlamaEmbeddingCache::NumInMemory() const
+{
+    FScopeLock Lock(&Mutex);
+    return Memory.Num();
+}
+
+int32 FLlamaEmbeddingCache::NumOnDisk() const
+{
+    FScopeLock Lock(&Mutex);
+    return DiskIndex.Num();
+}
+
+FString FLlamaEmbeddingCache::GetFilePath() const
+{
+    return FilePath;
+}
+
+void FLlamaEmbeddingCache::SetFilePath(const FString& InFilePath)
+{
+    Flush();
+
+    FScopeLock Lock(&Mutex);
+    UnmapFile();
+    DiskIndex.Empty();
+    Pending.Reset();
+    Memory.Empty(Memory.Max());
+
+    FilePath = FPaths::ConvertRelativePathToFull(InFilePath);
+    if (bPersistent)
+    {
+        OpenFile();
+    }
+}
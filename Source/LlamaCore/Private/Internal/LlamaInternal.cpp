@@ -1,6 +1,8 @@
 // Copyright 2025-current Getnamo.
 
 #include "Internal/LlamaInternal.h"
+#include "Internal/LlamaEmbeddingCache.h"
+#include "Internal/LlamaModelRegistry.h"
 #include "common/common.h"
 #include "common/sampling.h"
 #include "mtmd/mtmd.h"
@@ -8,6 +10,13 @@
 #include "LlamaDataTypes.h"
 #include "LlamaUtility.h"
 #include "HardwareInfo.h"
+#include "Hash/CityHash.h"
+#include "Misc/Compression.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+#include <algorithm>
 
 // Cross-platform strdup. MSVC ships `_strdup` and warns about plain `strdup`;
 // POSIX (glibc/clang on Linux) ships `strdup` and never had `_strdup`.
@@ -67,41 +76,76 @@ namespace
         return Out;
     }
 
-    // Replacement for `common_token_to_piece(vocab, token, special)`.
-    // Output string is owned by the caller's module.
-    static std::string SafeTokenToPiece(
-        const llama_vocab* Vocab,
-        llama_token Token,
-        bool bSpecial)
+    // `common_token_to_piece(vocab, token, special)` is replaced by FLlamaTokenPieceTable,
+    // which detokenizes the vocab once into a buffer owned by this module.
+
+    // Allocation-free equivalent of `common_batch_add` for single-sequence tokens; the common
+    // helper takes a std::vector of seq ids which would allocate per token.
+    static void BatchAddToken(llama_batch& Batch, llama_token Token, llama_pos Pos, llama_seq_id SeqId, bool bLogits)
     {
-        if (!Vocab) return std::string();
+        const int32 i = Batch.n_tokens;
+        Batch.token[i] = Token;
+        Batch.pos[i] = Pos;
+        Batch.n_seq_id[i] = 1;
+        Batch.seq_id[i][0] = SeqId;
+        Batch.logits[i] = bLogits;
+        Batch.n_tokens++;
+    }
 
-        // Common case: pieces are short. Single attempt with a small buffer
-        // covers virtually all tokens; fall back to the size-probe path on
-        // the rare overflow.
-        char StackBuf[128];
-        const int32_t Wrote = llama_token_to_piece(
-            Vocab, Token, StackBuf, (int32_t)sizeof(StackBuf),
-            /*lstrip*/ 0, bSpecial);
+    static ggml_type ToGgmlType(ELlamaKVCacheType Type)
+    {
+        switch (Type)
+        {
+        case ELlamaKVCacheType::BF16: return GGML_TYPE_BF16;
+        case ELlamaKVCacheType::F32:  return GGML_TYPE_F32;
+        case ELlamaKVCacheType::Q8_0: return GGML_TYPE_Q8_0;
+        case ELlamaKVCacheType::Q4_0: return GGML_TYPE_Q4_0;
+        default:                      return GGML_TYPE_F16;
+        }
+    }
 
-        if (Wrote >= 0)
+    //Mean of NRows per-token embeddings, L2 renormalized. Pooling for models with LLAMA_POOLING_TYPE_NONE.
+    static void MeanPoolRows(const float* Rows, int32 NRows, int32 NEmbd, std::vector<float>& Out)
+    {
+        Out.assign(NEmbd, 0.f);
+        for (int32 t = 0; t < NRows; ++t)
         {
-            return std::string(StackBuf, (size_t)Wrote);
+            const float* Row = Rows + (size_t)t * NEmbd;
+            for (int32 d = 0; d < NEmbd; ++d)
+            {
+                Out[d] += Row[d];
+            }
         }
+        const float Inv = 1.f / static_cast<float>(FMath::Max(NRows, 1));
+        for (int32 d = 0; d < NEmbd; ++d) { Out[d] *= Inv; }
 
-        // Negative return = required size (negated). Allocate and retry.
-        const int32_t Needed = -Wrote;
-        std::string Out;
-        Out.resize((size_t)Needed);
-        const int32_t Wrote2 = llama_token_to_piece(
-            Vocab, Token, Out.data(), (int32_t)Out.size(),
-            /*lstrip*/ 0, bSpecial);
-        if (Wrote2 < 0 || Wrote2 > Needed)
+        double SumSq = 0.0;
+        for (int32 d = 0; d < NEmbd; ++d) { SumSq += static_cast<double>(Out[d]) * Out[d]; }
+        const float Norm = SumSq > 0.0 ? static_cast<float>(1.0 / sqrt(SumSq)) : 1.f;
+        for (int32 d = 0; d < NEmbd; ++d) { Out[d] *= Norm; }
+    }
+
+    //KV type, flash attention and batching settings shared by the main and draft contexts
+    static void ApplyMemoryParams(const FLLMMemoryParams& Memory, llama_context_params& ContextParams)
+    {
+        ContextParams.type_k = ToGgmlType(Memory.KCacheType);
+        ContextParams.type_v = ToGgmlType(Memory.VCacheType);
+        ContextParams.n_ubatch = FMath::Clamp(Memory.MicroBatchLength, 1, (int32)ContextParams.n_batch);
+        ContextParams.op_offload = Memory.bOffloadHostOps;
+
+        switch (Memory.FlashAttention)
         {
-            return std::string();
+        case ELlamaFlashAttention::Enabled:  ContextParams.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED; break;
+        case ELlamaFlashAttention::Disabled: ContextParams.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_DISABLED; break;
+        default:                             ContextParams.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_AUTO; break;
+        }
+
+        //llama.cpp refuses a quantized V cache without flash attention
+        if (ggml_is_quantized(ContextParams.type_v) && ContextParams.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_DISABLED)
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("Quantized V cache requires flash attention, using FlashAttention Auto."));
+            ContextParams.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_AUTO;
         }
-        Out.resize((size_t)Wrote2);
-        return Out;
     }
 }
 
@@ -113,6 +157,19 @@ bool FLlamaInternal::LoadModelFromParams(const FLLMModelParams& InModelParams)
     UE_LOG(LogTemp, Log, TEXT("Device Found: %s %s"), *GPU, *RHI);
 
     LastLoadedParams = InModelParams;
+    LastLoadTimings = FLlamaLoadTimings();
+    bLastLoadCancelled = false;
+    const int64 LoadStartTime = ggml_time_us();
+    int64 PhaseStartTime = LoadStartTime;
+
+    //Seconds since the previous phase ended
+    auto EndPhase = [&PhaseStartTime]()
+    {
+        const int64 Now = ggml_time_us();
+        const float Seconds = (Now - PhaseStartTime) / 1000000.0f;
+        PhaseStartTime = Now;
+        return Seconds;
+    };
 
     // only print errors
     llama_log_set([](enum ggml_log_level level, const char* text, void* /* user_data */)
@@ -126,37 +183,103 @@ bool FLlamaInternal::LoadModelFromParams(const FLLMModelParams& InModelParams)
     // load dynamic backends
     ggml_backend_load_all();
 
+    //Pools need the CPU backend registered, contexts below attach them
+    Threadpools.Configure(InModelParams.Advanced.Threading, InModelParams.Threads);
+
     std::string ModelPath = TCHAR_TO_UTF8(*FLlamaPaths::ParsePathIntoFullPath(InModelParams.PathToModel));
 
 
     //Regular init
+    const FLLMMemoryParams& Memory = InModelParams.Advanced.Memory;
+
     llama_model_params LlamaModelParams = llama_model_default_params();
     LlamaModelParams.n_gpu_layers = InModelParams.GPULayers;
+    LlamaModelParams.use_mmap = Memory.bUseMmap;
+    LlamaModelParams.use_mlock = Memory.bUseMlock;
+
+    //Reports weight loading and aborts it on cancel
+    LastReportedLoadProgress = 0.f;
+    LlamaModelParams.progress_callback_user_data = this;
+    LlamaModelParams.progress_callback = [](float Progress, void* UserData)
+    {
+        FLlamaInternal* Self = static_cast<FLlamaInternal*>(UserData);
+        if (Self->OnLoadProgress && (Progress >= 1.f || Progress - Self->LastReportedLoadProgress >= 0.01f))
+        {
+            Self->LastReportedLoadProgress = Progress;
+            Self->OnLoadProgress(Progress);
+        }
+        return !Self->bLoadCancelRequested;
+    };
 
-    LlamaModel = llama_model_load_from_file(ModelPath.c_str(), LlamaModelParams);
+    //Weights are shared with every other instance that loaded the same file and settings
+    LlamaModel = FLlamaModelRegistry::Get().Acquire(ModelPath, LlamaModelParams);
+    if (HandleLoadCancel(TEXT("weights")))
+    {
+        return false;
+    }
     if (!LlamaModel)
     {
         FString ErrorMessage = FString::Printf(TEXT("Unable to load model at <%hs>"), ModelPath.c_str());
         EmitErrorMessage(ErrorMessage, 10, __func__);
         return false;
     }
+    LastLoadTimings.bSharedWeights = FLlamaModelRegistry::Get().GetRefCount(LlamaModel) > 1;
+    if (LastLoadTimings.bSharedWeights && OnLoadProgress)
+    {
+        OnLoadProgress(1.f);
+    }
+    LastLoadTimings.ModelLoadTime = EndPhase();
 
     llama_context_params ContextParams = llama_context_default_params();
     ContextParams.n_ctx = InModelParams.MaxContextLength;
     ContextParams.n_batch = InModelParams.MaxBatchLength;
-    ContextParams.n_threads = InModelParams.Threads;
-    ContextParams.n_threads_batch = InModelParams.Threads;
+    ContextParams.n_threads = Threadpools.GetDecodeThreads();
+    ContextParams.n_threads_batch = Threadpools.GetPrefillThreads();
+    ApplyMemoryParams(Memory, ContextParams);
+
+    //One KV sequence per conversation slot. Unified KV lets slots draw from one shared pool instead of
+    //each getting a fixed n_ctx / n_seq_max share, which suits many short NPC chats.
+    const int32 SlotCount = FMath::Clamp(InModelParams.MaxConversationSlots, 1, (int32)llama_max_parallel_sequences());
+
+    //Cached system prompts live in extra sequences after the slots. Needs the unified cache so seq_cp shares cells.
+    const int32 PrefixCacheCount = InModelParams.Advanced.bEmbeddingMode ? 0 :
+        FMath::Clamp(InModelParams.SystemPromptCacheEntries, 0, (int32)llama_max_parallel_sequences() - SlotCount);
+
+    //Spare sequences for snapshots come last
+    const int32 SnapshotSeqCount = InModelParams.Advanced.bEmbeddingMode ? 0 :
+        FMath::Clamp(InModelParams.KVSnapshotSequences, 0, (int32)llama_max_parallel_sequences() - SlotCount - PrefixCacheCount);
+
+    //Then the spare sequences reply candidates 1..N-1 decode in
+    const int32 CandidateSeqCount = InModelParams.Advanced.bEmbeddingMode ? 0 :
+        FMath::Clamp(InModelParams.ReplyCandidateSequences, 0, (int32)llama_max_parallel_sequences() - SlotCount - PrefixCacheCount - SnapshotSeqCount);
+
+    ContextParams.n_seq_max = SlotCount + PrefixCacheCount + SnapshotSeqCount + CandidateSeqCount;
+    if (ContextParams.n_seq_max > 1)
+    {
+        //Spare sequences copy KV ranges by sharing cells, which only works within one pool
+        const bool bNeedsUnified = PrefixCacheCount + SnapshotSeqCount + CandidateSeqCount > 0;
+        if (!Memory.bUnifiedKVCache && bNeedsUnified)
+        {
+            UE_LOG(LlamaLog, Log, TEXT("bUnifiedKVCache is off but prompt cache, snapshot or candidate sequences are reserved, keeping the KV cache unified."));
+        }
+        ContextParams.kv_unified = Memory.bUnifiedKVCache || bNeedsUnified;
+    }
 
     if (InModelParams.Advanced.bEmbeddingMode)
     {
         ContextParams.embeddings = InModelParams.Advanced.bEmbeddingMode;
+
+        //Batched embedding packs one text per sequence. Non-causal models need the whole batch in one ubatch,
+        //and a unified cache lets any text use the full context instead of an n_ctx / n_seq_max share.
+        ContextParams.n_seq_max = FMath::Clamp(FMath::Max(InModelParams.Advanced.EmbeddingBatchSequences, SlotCount), 1, (int32)llama_max_parallel_sequences());
+        ContextParams.n_ubatch = ContextParams.n_batch;
+        ContextParams.kv_unified = true;
     }
 
-    // Let the model decide flash attention — AUTO picks the best supported mode.
-    // Required for vision models (Qwen2.5-Omni etc.) where the mmproj encoder needs it.
-    if (!InModelParams.MmprojPath.IsEmpty())
+    // Vision models (Qwen2.5-Omni etc.) need flash attention for the mmproj encoder
+    if (!InModelParams.MmprojPath.IsEmpty() && ContextParams.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_DISABLED)
     {
-        ContextParams.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_AUTO;
+        UE_LOG(LlamaLog, Warning, TEXT("FlashAttention is Disabled with a multimodal projector set, the projector may fail to encode."));
     }
 
     SavedFlashAttnType = ContextParams.flash_attn_type;
@@ -168,101 +291,42 @@ bool FLlamaInternal::LoadModelFromParams(const FLLMModelParams& InModelParams)
         EmitErrorMessage(ErrorMessage, 11, __func__);
         return false;
     }
+    Threadpools.Attach(Context);
 
-    //Only standard mode uses sampling
-    if (!InModelParams.Advanced.bEmbeddingMode)
-    {
-        //common sampler strategy
-        if (InModelParams.Advanced.Sampling.bUseCommonSampler)
-        {
-            common_params_sampling SamplingParams;
-
-            if (InModelParams.Advanced.Sampling.MinP != -1.f)
-            {
-                SamplingParams.min_p = InModelParams.Advanced.Sampling.MinP;
-            }
-            if (InModelParams.Advanced.Sampling.TopK != -1.f)
-            {
-                SamplingParams.top_k = InModelParams.Advanced.Sampling.TopK;
-            }
-            if (InModelParams.Advanced.Sampling.TopP != -1.f)
-            {
-                SamplingParams.top_p = InModelParams.Advanced.Sampling.TopP;
-            }
-            if (InModelParams.Advanced.Sampling.TypicalP != -1.f)
-            {
-                SamplingParams.typ_p = InModelParams.Advanced.Sampling.TypicalP;
-            }
-            if (InModelParams.Advanced.Sampling.Mirostat != -1)
-            {
-                SamplingParams.mirostat = InModelParams.Advanced.Sampling.Mirostat;
-                SamplingParams.mirostat_eta = InModelParams.Advanced.Sampling.MirostatEta;
-                SamplingParams.mirostat_tau = InModelParams.Advanced.Sampling.MirostatTau;
-            }
-
-            //Seed is either default or the one specifically passed in for deterministic results
-            if (InModelParams.Seed != -1)
-            {
-                SamplingParams.seed = InModelParams.Seed;
-            }
-
-            CommonSampler = common_sampler_init(LlamaModel, SamplingParams);
-        }
-
-        Sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
-
-        //Temperature is always applied
-        llama_sampler_chain_add(Sampler, llama_sampler_init_temp(InModelParams.Advanced.Sampling.Temp));
-
-        //If any of the repeat penalties are set, apply penalties to sampler
-        if (InModelParams.Advanced.Sampling.PenaltyLastN != 0 ||
-            InModelParams.Advanced.Sampling.PenaltyRepeat != 1.f ||
-            InModelParams.Advanced.Sampling.PenaltyFrequency != 0.f ||
-            InModelParams.Advanced.Sampling.PenaltyPresence != 0.f)
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_penalties(
-                InModelParams.Advanced.Sampling.PenaltyLastN, InModelParams.Advanced.Sampling.PenaltyRepeat,
-                InModelParams.Advanced.Sampling.PenaltyFrequency, InModelParams.Advanced.Sampling.PenaltyPresence));
-        }
+    UE_LOG(LlamaLog, Log, TEXT("Context: %d tokens per sequence, %d sequences (%s), KV %hs/%hs, n_batch %d, n_ubatch %d, flash attention %hs"),
+        llama_n_ctx_seq(Context), llama_n_seq_max(Context), ContextParams.kv_unified ? TEXT("unified") : TEXT("split"),
+        ggml_type_name(ContextParams.type_k), ggml_type_name(ContextParams.type_v),
+        llama_n_batch(Context), llama_n_ubatch(Context), llama_flash_attn_type_name(ContextParams.flash_attn_type));
 
-        //Optional sampling strategies - MinP should be applied by default of 0.05f
-        if (InModelParams.Advanced.Sampling.MinP != -1.f)
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_min_p(InModelParams.Advanced.Sampling.MinP, 1));
-        }
-        if (InModelParams.Advanced.Sampling.TopK != -1.f)
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_top_k(InModelParams.Advanced.Sampling.TopK));
-        }
-        if (InModelParams.Advanced.Sampling.TopP != -1.f)
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_top_p(InModelParams.Advanced.Sampling.TopP, 1));
-        }
-        if (InModelParams.Advanced.Sampling.TypicalP != -1.f)
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_typical(InModelParams.Advanced.Sampling.TypicalP, 1));
-        }
-        if (InModelParams.Advanced.Sampling.Mirostat != -1)
+    EmbeddingCacheModelKey = 0;
+    if (InModelParams.Advanced.bEmbeddingMode && InModelParams.Advanced.bEmbeddingCache)
+    {
+        const uint64 Fingerprint = FLlamaEmbeddingCache::FingerprintModelFile(UTF8_TO_TCHAR(ModelPath.c_str()));
+        if (Fingerprint != 0)
         {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_mirostat_v2(
-                InModelParams.Advanced.Sampling.Mirostat, InModelParams.Advanced.Sampling.MirostatTau, InModelParams.Advanced.Sampling.MirostatEta));
+            //Vectors also depend on pooling and normalization (always L2 here)
+            const uint64 Settings[] = { Fingerprint, (uint64)llama_pooling_type(Context), 2 };
+            EmbeddingCacheModelKey = CityHash64(reinterpret_cast<const char*>(Settings), sizeof(Settings));
+            FLlamaEmbeddingCache::Get().Configure(InModelParams.Advanced.EmbeddingCacheEntries, InModelParams.Advanced.bPersistEmbeddingCache,
+                (int64)InModelParams.Advanced.EmbeddingCacheMaxFileMB * 1024 * 1024);
         }
+    }
 
-        //Seed is either default or the one specifically passed in for deterministic results
-        if (InModelParams.Seed == -1)
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
-        }
-        else
-        {
-            llama_sampler_chain_add(Sampler, llama_sampler_init_dist(InModelParams.Seed));
-        }
+    //Slots start from the adapters' load-time scales
+    LoadLoraAdapters(InModelParams.LoraAdapters);
 
-        //NB: this is just a starting heuristic, 
-        ContextHistory.reserve(1024);
+    //Only standard mode uses sampling
+    if (!InModelParams.Advanced.bEmbeddingMode)
+    {
+        BuildSamplers(InModelParams.Advanced.Sampling, InModelParams.Seed, Sampler, CommonSampler);
 
+        //Sampled tokens are detokenized by lookup from here on
+        PieceTable.Build(llama_model_get_vocab(LlamaModel));
+        ResponseBuffer.reserve(4096);
     }//End non-embedding mode
 
+    InitSlots(SlotCount, PrefixCacheCount, SnapshotSeqCount, CandidateSeqCount);
+
     //empty by default
     Template = std::string();
     TemplateSource = FLlamaString::ToStd(InModelParams.CustomChatTemplate.TemplateSource);
@@ -309,7 +373,16 @@ bool FLlamaInternal::LoadModelFromParams(const FLLMModelParams& InModelParams)
         }
     }
     
-    FilledContextCharLength = 0;
+    //Per-slot incremental renderers, probes once whether the template renders message by message
+    for (FLlamaConversationSlot& Slot : Slots)
+    {
+        Slot.Renderer.SetTemplate(Template);
+    }
+    if (!Slots.empty() && !InModelParams.Advanced.bEmbeddingMode)
+    {
+        UE_LOG(LlamaLog, Log, TEXT("Chat template is %s"), Slots[0].Renderer.IsPrefixStable() ?
+            TEXT("prefix-stable, history is rendered incrementally.") : TEXT("not prefix-stable, history is re-rendered every turn."));
+    }
 
     //Detect thinking mode support from template
     bThinkingEnabled = InModelParams.Advanced.Thinking.bEnableThinking;
@@ -332,20 +405,102 @@ bool FLlamaInternal::LoadModelFromParams(const FLLMModelParams& InModelParams)
     }
 
     bIsModelLoaded = true;
+    LastLoadTimings.ContextInitTime = EndPhase();
+    if (HandleLoadCancel(TEXT("context")))
+    {
+        return false;
+    }
 
     //Initialize multimodal if mmproj path is provided
     if (!InModelParams.MmprojPath.IsEmpty())
     {
         InitMultimodal(InModelParams.MmprojPath);
+        LastLoadTimings.MultimodalInitTime = EndPhase();
+        if (HandleLoadCancel(TEXT("multimodal projector")))
+        {
+            return false;
+        }
+    }
+
+    //Draft model for speculative decoding, failure only disables speculation
+    if (!InModelParams.DraftModelPath.IsEmpty() && !InModelParams.Advanced.bEmbeddingMode)
+    {
+        InitDraftModel(InModelParams.DraftModelPath);
+        LastLoadTimings.DraftModelInitTime = EndPhase();
+        if (HandleLoadCancel(TEXT("draft model")))
+        {
+            return false;
+        }
+    }
+
+    if (InModelParams.bWarmUpOnLoad)
+    {
+        WarmUpContext(Context, LlamaModel);
+        if (DraftContext)
+        {
+            WarmUpContext(DraftContext, DraftModel);
+        }
+        LastLoadTimings.WarmUpTime = EndPhase();
     }
 
+    LastLoadTimings.TotalTime = (ggml_time_us() - LoadStartTime) / 1000000.0f;
+    UE_LOG(LlamaLog, Log, TEXT("Loaded in %.2fs: weights %.2fs%s, context %.2fs, multimodal %.2fs, draft %.2fs, warm-up %.2fs"),
+        LastLoadTimings.TotalTime, LastLoadTimings.ModelLoadTime, LastLoadTimings.bSharedWeights ? TEXT(" (shared)") : TEXT(""),
+        LastLoadTimings.ContextInitTime, LastLoadTimings.MultimodalInitTime, LastLoadTimings.DraftModelInitTime, LastLoadTimings.WarmUpTime);
+
+    return true;
+}
+
+bool FLlamaInternal::HandleLoadCancel(const TCHAR* Phase)
+{
+    if (!bLoadCancelRequested)
+    {
+        return false;
+    }
+
+    UE_LOG(LlamaLog, Log, TEXT("Model load cancelled during %s."), Phase);
+    UnloadModel();
+    bLastLoadCancelled = true;
     return true;
 }
 
+void FLlamaInternal::WarmUpContext(llama_context* WarmContext, const llama_model* WarmModel)
+{
+    const llama_vocab* Vocab = llama_model_get_vocab(WarmModel);
+    llama_token Bos = llama_vocab_bos(Vocab);
+    llama_token Eos = llama_vocab_eos(Vocab);
+    if (Bos == LLAMA_TOKEN_NULL)
+    {
+        Bos = 0;
+    }
+    if (Eos == LLAMA_TOKEN_NULL)
+    {
+        Eos = Bos;
+    }
+
+    //Batched (prefill kernels) then single token (decode kernels), like llama.cpp's common warm-up
+    llama_token Tokens[2] = { Bos, Eos };
+    llama_batch WarmBatch = llama_batch_get_one(Tokens, 2);
+    if (llama_decode(WarmContext, WarmBatch) == 0)
+    {
+        WarmBatch = llama_batch_get_one(&Eos, 1);
+        llama_decode(WarmContext, WarmBatch);
+    }
+    llama_synchronize(WarmContext);
+
+    llama_memory_clear(llama_get_memory(WarmContext), true);
+    llama_perf_context_reset(WarmContext);
+}
+
 void FLlamaInternal::UnloadModel()
 {
     //Free mtmd before context/model since it holds references to them
     FreeMultimodal();
+    FreeDraftModel();
+
+    //Slot samplers are clones of the prototypes below, free them first
+    FreeSlots();
+    PieceTable.Reset();
 
     if (Sampler)
     {
@@ -357,9 +512,13 @@ void FLlamaInternal::UnloadModel()
         llama_free(Context);
         Context = nullptr;
     }
+    EmbeddingCacheModelKey = 0;
+
+    //Adapters are tied to the model, release them first
+    FreeLoraAdapters();
     if (LlamaModel)
     {
-        llama_model_free(LlamaModel);
+        FLlamaModelRegistry::Get().Release(LlamaModel);
         LlamaModel = nullptr;
     }
     if (CommonSampler)
@@ -367,12 +526,107 @@ void FLlamaInternal::UnloadModel()
         common_sampler_free(CommonSampler);
         CommonSampler = nullptr;
     }
-    
-    ContextHistory.clear();
 
     bIsModelLoaded = false;
 }
 
+void FLlamaInternal::BuildSamplers(const FLLMSamplingParams& Params, int32 Seed, llama_sampler*& OutSampler, common_sampler*& OutCommonSampler)
+{
+    OutSampler = nullptr;
+    OutCommonSampler = nullptr;
+
+    //common sampler strategy
+    if (Params.bUseCommonSampler)
+    {
+        common_params_sampling SamplingParams;
+        SamplingParams.temp = Params.Temp;
+        SamplingParams.penalty_last_n = Params.PenaltyLastN;
+        SamplingParams.penalty_repeat = Params.PenaltyRepeat;
+        SamplingParams.penalty_freq = Params.PenaltyFrequency;
+        SamplingParams.penalty_present = Params.PenaltyPresence;
+
+        if (Params.MinP != -1.f)
+        {
+            SamplingParams.min_p = Params.MinP;
+        }
+        if (Params.TopK != -1.f)
+        {
+            SamplingParams.top_k = Params.TopK;
+        }
+        if (Params.TopP != -1.f)
+        {
+            SamplingParams.top_p = Params.TopP;
+        }
+        if (Params.TypicalP != -1.f)
+        {
+            SamplingParams.typ_p = Params.TypicalP;
+        }
+        if (Params.Mirostat != -1)
+        {
+            SamplingParams.mirostat = Params.Mirostat;
+            SamplingParams.mirostat_eta = Params.MirostatEta;
+            SamplingParams.mirostat_tau = Params.MirostatTau;
+        }
+
+        //Seed is either default or the one specifically passed in for deterministic results
+        if (Seed != -1)
+        {
+            SamplingParams.seed = Seed;
+        }
+
+        OutCommonSampler = common_sampler_init(LlamaModel, SamplingParams);
+    }
+
+    OutSampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+
+    //Temperature is always applied
+    llama_sampler_chain_add(OutSampler, llama_sampler_init_temp(Params.Temp));
+
+    //If any of the repeat penalties are set, apply penalties to sampler
+    if (Params.PenaltyLastN != 0 ||
+        Params.PenaltyRepeat != 1.f ||
+        Params.PenaltyFrequency != 0.f ||
+        Params.PenaltyPresence != 0.f)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_penalties(
+            Params.PenaltyLastN, Params.PenaltyRepeat,
+            Params.PenaltyFrequency, Params.PenaltyPresence));
+    }
+
+    //Optional sampling strategies - MinP should be applied by default of 0.05f
+    if (Params.MinP != -1.f)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_min_p(Params.MinP, 1));
+    }
+    if (Params.TopK != -1.f)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_top_k(Params.TopK));
+    }
+    if (Params.TopP != -1.f)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_top_p(Params.TopP, 1));
+    }
+    if (Params.TypicalP != -1.f)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_typical(Params.TypicalP, 1));
+    }
+    if (Params.Mirostat != -1)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_mirostat_v2(
+            Params.Mirostat, Params.MirostatTau, Params.MirostatEta));
+    }
+
+    //Seed is either default or the one specifically passed in for deterministic results
+    if (Seed == -1)
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    }
+    else
+    {
+        llama_sampler_chain_add(OutSampler, llama_sampler_init_dist(Seed));
+    }
+}
+
 std::string FLlamaInternal::WrapPromptForRole(const std::string& Text, EChatTemplateRole Role, const std::string& OverrideTemplate, bool bAddAssistantBoS)
 {
     std::vector<llama_chat_message> MessageListWrapper;
@@ -405,6 +659,12 @@ std::string FLlamaInternal::WrapPromptForRole(const std::string& Text, EChatTemp
 void FLlamaInternal::StopGeneration()
 {
     bGenerationActive = false;
+
+    //Scheduled slots are stopped by the BT on its next step
+    if (bScheduledWorkActive)
+    {
+        bStopScheduledRequested = true;
+    }
 }
 
 bool FLlamaInternal::IsGenerating()
@@ -416,7 +676,7 @@ int32 FLlamaInternal::MaxContext()
 {
     if (Context)
     {
-        return llama_n_ctx(Context);
+        return llama_n_ctx_seq(Context);
     }
     else
     {
@@ -424,11 +684,11 @@ int32 FLlamaInternal::MaxContext()
     }
 }
 
-int32 FLlamaInternal::UsedContext()
+int32 FLlamaInternal::UsedContext(int32 SlotId)
 {
-    if (Context)
+    if (Context && IsValidSlot(SlotId))
     {
-        return llama_memory_seq_pos_max(llama_get_memory(Context), 0);
+        return llama_memory_seq_pos_max(llama_get_memory(Context), SlotId);
     }
     else
     {
@@ -441,76 +701,548 @@ bool FLlamaInternal::IsModelLoaded()
     return bIsModelLoaded;
 }
 
-void FLlamaInternal::ResetContextHistory(bool bKeepSystemsPrompt)
+FLlamaConversationSlot& FLlamaInternal::ActiveSlot()
 {
-    if (!bIsModelLoaded)
+    return Slots[ActiveSlotId];
+}
+
+FLlamaConversationSlot& FLlamaInternal::GetSlot(int32 SlotId)
+{
+    return Slots[SlotId];
+}
+
+int32 FLlamaInternal::NumSlots() const
+{
+    return (int32)Slots.size();
+}
+
+bool FLlamaInternal::IsValidSlot(int32 SlotId) const
+{
+    return SlotId >= 0 && SlotId < (int32)Slots.size();
+}
+
+bool FLlamaInternal::SelectSlot(int32 SlotId, const FString& FunctionName)
+{
+    if (!IsValidSlot(SlotId))
     {
-        return;
+        EmitErrorMessage(FString::Printf(TEXT("Invalid conversation slot %d, model was loaded with %d slot(s). Increase MaxConversationSlots."),
+            SlotId, NumSlots()), 103, FunctionName);
+        return false;
     }
+    ActiveSlotId = SlotId;
+    ApplyLoraScales(Slots[SlotId].ActiveLoraScales());
+    return true;
+}
 
-    if (IsGenerating())
+void FLlamaInternal::InitSlots(int32 SlotCount, int32 PrefixCacheCount, int32 SnapshotSeqCount, int32 CandidateSeqCount)
+{
+    FreeSlots();
+
+    //Stop sequences are matched on UTF-8 bytes, every slot gets its own copy of the automaton
+    std::vector<std::string> StopSequences;
+    for (const FString& StopSequence : LastLoadedParams.StopSequences)
     {
-        StopGeneration();
+        StopSequences.push_back(TCHAR_TO_UTF8(*StopSequence));
     }
+    FLlamaStopSequenceMatcher StopMatcher;
+    StopMatcher.SetPatterns(StopSequences);
 
-    if (bKeepSystemsPrompt)
+    Slots.resize(SlotCount);
+    for (FLlamaConversationSlot& Slot : Slots)
     {
-        //Valid trim case
-        if (Messages.size() > 1)
+        //NB: this is just a starting heuristic,
+        Slot.ContextHistory.reserve(1024);
+        Slot.StopMatcher = StopMatcher;
+        Slot.ActiveSampling = LastLoadedParams.Advanced.Sampling;
+        Slot.LoraScales = DefaultLoraScales;
+
+        //Mirror appends in the generation loop stay within capacity
+        Slot.KVTokens.reserve(llama_n_ctx_seq(Context));
+
+        if (Sampler)
         {
-            //Rollback all the messages except the first one
-            RollbackContextHistoryByMessages(Messages.size() - 1);
-            return;
+            Slot.Sampler = llama_sampler_clone(Sampler);
         }
-        else
+        if (CommonSampler)
         {
-            //Only message is the system's prompt, nothing to do
-            return;
+            Slot.CommonSampler = common_sampler_clone(CommonSampler);
         }
     }
+    ActiveSlotId = 0;
+
+    PrefixCache.resize(PrefixCacheCount);
+    for (int32 i = 0; i < PrefixCacheCount; i++)
+    {
+        PrefixCache[i].SeqId = SlotCount + i;
+    }
+
+    for (int32 i = 0; i < SnapshotSeqCount; i++)
+    {
+        FreeSnapshotSeqs.push_back(SlotCount + PrefixCacheCount + i);
+    }
 
-    //Full Reset
-    ContextHistory.clear();
-    Messages.clear();
+    for (int32 i = 0; i < CandidateSeqCount; i++)
+    {
+        CandidateSeqs.push_back(SlotCount + PrefixCacheCount + SnapshotSeqCount + i);
+    }
 
-    llama_memory_clear(llama_get_memory(Context), false);
-    FilledContextCharLength = 0;
+    SeqBatchCapacity = FMath::Max(1, (int32)llama_n_batch(Context));
+    SeqBatch = llama_batch_init(SeqBatchCapacity, 0, 1);
 }
 
-void FLlamaInternal::RollbackContextHistoryByTokens(int32 NTokensToErase)
+void FLlamaInternal::FreeSlots()
 {
-    // clear the last n_regen tokens from the KV cache and update n_past
-    // seq_pos_max returns the max position (0-indexed), so token count = seq_pos_max + 1
-    int32 TokenCount = llama_memory_seq_pos_max(llama_get_memory(Context), 0) + 1;
+    for (FLlamaConversationSlot& Slot : Slots)
+    {
+        if (Slot.Sampler)
+        {
+            llama_sampler_free(Slot.Sampler);
+            Slot.Sampler = nullptr;
+        }
+        if (Slot.CommonSampler)
+        {
+            common_sampler_free(Slot.CommonSampler);
+            Slot.CommonSampler = nullptr;
+        }
+        if (Slot.GrammarSampler)
+        {
+            llama_sampler_free(Slot.GrammarSampler);
+            Slot.GrammarSampler = nullptr;
+        }
+        for (FLlamaSamplerSet& Set : Slot.SamplerPool)
+        {
+            if (Set.Sampler)
+            {
+                llama_sampler_free(Set.Sampler);
+            }
+            if (Set.CommonSampler)
+            {
+                common_sampler_free(Set.CommonSampler);
+            }
+        }
+        Slot.SamplerPool.clear();
+    }
+    Slots.clear();
+    SamplerPoolClock = 0;
+    ActiveSlotId = 0;
+    PrefillCursor = 0;
+    PrefixCache.clear();
+    PrefixCacheClock = 0;
+    Snapshots.Empty();
+    FreeSnapshotSeqs.clear();
+    ReplyCandidates.clear();
+    CandidateSeqs.clear();
+    CandidateSlotId = -1;
+    bScheduledWorkActive = false;
+    bStopScheduledRequested = false;
+
+    if (SeqBatchCapacity > 0)
+    {
+        llama_batch_free(SeqBatch);
+        SeqBatch = {};
+        SeqBatchCapacity = 0;
+    }
+}
 
-    llama_memory_seq_rm(llama_get_memory(Context), 0, TokenCount - NTokensToErase, -1);
+int32 FLlamaInternal::DecodeTokensForSeq(const llama_token* Tokens, int32 NTokens, llama_pos StartPos, llama_seq_id SeqId)
+{
+    int32 Offset = 0;
+    while (Offset < NTokens)
+    {
+        const int32 ChunkSize = FMath::Min(NTokens - Offset, SeqBatchCapacity);
 
-    //FilledContextCharLength -= NTokensToErase;
+        SeqBatch.n_tokens = 0;
+        for (int32 i = 0; i < ChunkSize; i++)
+        {
+            const bool bLast = (Offset + i) == (NTokens - 1);
+            BatchAddToken(SeqBatch, Tokens[Offset + i], StartPos + Offset + i, SeqId, bLast);
+        }
 
-    //Run a decode to sync everything else
-    //llama_decode(Context, llama_batch_get_one(nullptr, 0));
+        const int32 Result = llama_decode(Context, SeqBatch);
+        if (Result != 0)
+        {
+            return Result;
+        }
+        AppendToTokenMirror(SeqId, Tokens + Offset, ChunkSize, StartPos + Offset);
+        Offset += ChunkSize;
+    }
+    return 0;
 }
 
-void FLlamaInternal::RollbackContextHistoryByMessages(int32 NMessagesToErase)
+void FLlamaInternal::AppendToTokenMirror(llama_seq_id SeqId, const llama_token* Tokens, int32 NTokens, llama_pos StartPos)
 {
-    //cannot do rollback if model isn't loaded, ignore.
-    if (!bIsModelLoaded)
+    //Prefix cache sequences aren't mirrored
+    if (!IsValidSlot(SeqId))
     {
         return;
     }
 
-    if (IsGenerating())
+    FLlamaConversationSlot& Slot = Slots[SeqId];
+
+    //Positions that don't line up (e.g. after M-RoPE media) can't be mirrored by index
+    if (StartPos != (llama_pos)Slot.KVTokens.size())
     {
-        StopGeneration();
+        Slot.bKVTokensValid = false;
     }
+    Slot.KVTokens.insert(Slot.KVTokens.end(), Tokens, Tokens + NTokens);
+}
 
-    if (NMessagesToErase <= Messages.size()) 
+void FLlamaInternal::TruncateSlotKV(int32 SlotId, int32 NTokensToKeep)
+{
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    NTokensToKeep = FMath::Max(NTokensToKeep, 0);
+
+    llama_memory_seq_rm(llama_get_memory(Context), SlotId, NTokensToKeep, -1);
+
+    if (NTokensToKeep < (int32)Slot.KVTokens.size())
     {
-        Messages.resize(Messages.size() - NMessagesToErase);
+        Slot.KVTokens.resize(NTokensToKeep);
     }
-
+    for (int32& End : Slot.MessageTokenEnds)
+    {
+        End = FMath::Min(End, NTokensToKeep);
+    }
+    for (int32& Start : Slot.MessageTokenStarts)
+    {
+        Start = FMath::Min(Start, NTokensToKeep);
+    }
+    Slot.SharedPrefixTokens = FMath::Min(Slot.SharedPrefixTokens, NTokensToKeep);
+}
+
+int32 FLlamaInternal::ShiftSlotContext(int32 SlotId, int32 NTokensNeeded)
+{
+    if (LastLoadedParams.ContextOverflowPolicy != ELlamaContextOverflowPolicy::ShiftContext || !IsValidSlot(SlotId))
+    {
+        return 0;
+    }
+
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    llama_memory_t Memory = llama_get_memory(Context);
+
+    //Shifting needs positions to equal mirror indices (no media) and a cache type that supports it
+    if (!Slot.bKVTokensValid || !llama_memory_can_shift(Memory))
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Context shift unavailable on slot %d (media in context or unsupported KV cache)."), SlotId);
+        return 0;
+    }
+
+    const int32 NPast = Slot.KVTokens.size();
+    const int32 NContext = llama_n_ctx_seq(Context);
+
+    //System prompt, user pinned tokens, and cells shared with the prefix cache (seq_add would move them for every sequence)
+    int32 NKeep = LastLoadedParams.ContextShiftKeepTokens;
+    if (!Slot.Messages.empty() && !Slot.MessageTokenEnds.empty() &&
+        strcmp(Slot.Messages[0].role, RoleForEnum(EChatTemplateRole::System)) == 0)
+    {
+        NKeep += Slot.MessageTokenEnds[0];
+    }
+    NKeep = FMath::Clamp(FMath::Max(NKeep, Slot.SharedPrefixTokens), 0, NPast);
+
+    //Same heuristic as llama.cpp's main: drop half of the shiftable range, or more if the incoming run needs it
+    const int32 NLeft = NPast - NKeep;
+    const int32 NDiscard = FMath::Max(NLeft / 2, NPast + NTokensNeeded - NContext);
+    if (NDiscard <= 0 || NDiscard > NLeft)
+    {
+        return 0;
+    }
+
+    //seq_add moves cells for every sequence holding them
+    DemoteSequenceSnapshots();
+    ReleaseReplyCandidates();
+
+    llama_memory_seq_rm(Memory, SlotId, NKeep, NKeep + NDiscard);
+    llama_memory_seq_add(Memory, SlotId, NKeep + NDiscard, NPast, -NDiscard);
+
+    Slot.KVTokens.erase(Slot.KVTokens.begin() + NKeep, Slot.KVTokens.begin() + NKeep + NDiscard);
+
+    //Spans follow their tokens, ones inside the dropped range collapse onto the keep boundary
+    auto ShiftIndex = [NKeep, NDiscard](int32& Index)
+    {
+        if (Index >= NKeep + NDiscard)
+        {
+            Index -= NDiscard;
+        }
+        else if (Index > NKeep)
+        {
+            Index = NKeep;
+        }
+    };
+    for (int32& Start : Slot.MessageTokenStarts)
+    {
+        ShiftIndex(Start);
+    }
+    for (int32& End : Slot.MessageTokenEnds)
+    {
+        ShiftIndex(End);
+    }
+    ShiftIndex(Slot.ReplyTokenStart);
+    Slot.StopMatcher.OffsetTags(-NDiscard);
+    Slot.ShiftedTokenCount += NDiscard;
+
+    UE_LOG(LlamaLog, Log, TEXT("Context shift on slot %d: kept %d, discarded %d, %d tokens remain."), SlotId, NKeep, NDiscard, NPast - NDiscard);
+    return NDiscard;
+}
+
+void FLlamaInternal::ClearTokenMirror(FLlamaConversationSlot& Slot)
+{
+    Slot.KVTokens.clear();
+    Slot.bKVTokensValid = true;
+    Slot.MessageTokenStarts.clear();
+    Slot.MessageTokenEnds.clear();
+    Slot.ReplyTokenStart = 0;
+    Slot.ReplyPrefill.clear();
+    Slot.SharedPrefixTokens = 0;
+    Slot.ShiftedTokenCount = 0;
+}
+
+void FLlamaInternal::RecordMessageTokenSpan(int32 Start, int32 End)
+{
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    Slot.MessageTokenStarts.push_back(Start);
+    Slot.MessageTokenEnds.push_back(End);
+}
+
+bool FLlamaInternal::HasExactTokenIndex(const FLlamaConversationSlot& Slot) const
+{
+    return Slot.bKVTokensValid &&
+        Slot.Renderer.IsPrefixStable() &&
+        Slot.MessageTokenEnds.size() == Slot.Messages.size() &&
+        (Slot.MessageTokenEnds.empty() || Slot.MessageTokenEnds.back() <= (int32)Slot.KVTokens.size());
+}
+
+void FLlamaInternal::TokenizeTemplatedDelta(const std::string& Delta, int32 MessageBytes, std::vector<llama_token>& OutTokens, int32& OutMessageTokens)
+{
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+    const bool IsFirst = llama_memory_seq_pos_max(llama_get_memory(Context), ActiveSlotId) == 0;
+
+    MessageBytes = FMath::Clamp(MessageBytes, 0, (int32)Delta.size());
+
+    //The message and the assistant header that follows it are tokenized separately so the message's
+    //last token is a known KV boundary. Headers start with special tokens so this matches a joint pass.
+    OutTokens = SafeTokenize(Vocab, Delta.substr(0, MessageBytes), IsFirst, true);
+    OutMessageTokens = (int32)OutTokens.size();
+
+    if (MessageBytes < (int32)Delta.size())
+    {
+        const std::vector<llama_token> HeaderTokens = SafeTokenize(Vocab, Delta.substr(MessageBytes), false, true);
+        OutTokens.insert(OutTokens.end(), HeaderTokens.begin(), HeaderTokens.end());
+    }
+}
+
+bool FLlamaInternal::RestorePrefixFromCache(const std::vector<llama_token>& Tokens, llama_seq_id SeqId)
+{
+    if (PrefixCache.empty() || Tokens.empty())
+    {
+        return false;
+    }
+
+    //KV decoded under other adapters doesn't match this slot's
+    static const std::vector<float> NoLora;
+    const std::vector<float>& LoraScales = IsValidSlot(SeqId) ? Slots[SeqId].ActiveLoraScales() : NoLora;
+
+    const uint64 Hash = CityHash64((const char*)Tokens.data(), Tokens.size() * sizeof(llama_token));
+    for (FLlamaPrefixCacheEntry& Entry : PrefixCache)
+    {
+        if (Entry.TokenHash == Hash && Entry.Tokens == Tokens && Entry.LoraScales == LoraScales)
+        {
+            llama_memory_t Memory = llama_get_memory(Context);
+            llama_memory_seq_rm(Memory, SeqId, -1, -1);
+            llama_memory_seq_cp(Memory, Entry.SeqId, SeqId, -1, -1);
+            Entry.LastUsed = ++PrefixCacheClock;
+
+            if (IsValidSlot(SeqId))
+            {
+                Slots[SeqId].KVTokens = Tokens;
+                Slots[SeqId].bKVTokensValid = true;
+                Slots[SeqId].SharedPrefixTokens = Tokens.size();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void FLlamaInternal::StorePrefixInCache(const std::vector<llama_token>& Tokens, llama_seq_id SeqId)
+{
+    if (PrefixCache.empty() || Tokens.empty())
+    {
+        return;
+    }
+
+    //Only a clean decode is worth caching
+    llama_memory_t Memory = llama_get_memory(Context);
+    if (llama_memory_seq_pos_max(Memory, SeqId) + 1 != (int32)Tokens.size())
+    {
+        return;
+    }
+
+    static const std::vector<float> NoLora;
+    const std::vector<float>& LoraScales = IsValidSlot(SeqId) ? Slots[SeqId].ActiveLoraScales() : NoLora;
+
+    const uint64 Hash = CityHash64((const char*)Tokens.data(), Tokens.size() * sizeof(llama_token));
+
+    //Reuse an exact match (already cached), otherwise evict the least recently used entry
+    FLlamaPrefixCacheEntry* Target = &PrefixCache[0];
+    for (FLlamaPrefixCacheEntry& Entry : PrefixCache)
+    {
+        if (Entry.TokenHash == Hash && Entry.Tokens == Tokens && Entry.LoraScales == LoraScales)
+        {
+            Entry.LastUsed = ++PrefixCacheClock;
+            return;
+        }
+        if (Entry.LastUsed < Target->LastUsed)
+        {
+            Target = &Entry;
+        }
+    }
+
+    llama_memory_seq_rm(Memory, Target->SeqId, -1, -1);
+    llama_memory_seq_cp(Memory, SeqId, Target->SeqId, -1, -1);
+    Target->TokenHash = Hash;
+    Target->Tokens = Tokens;
+    Target->LoraScales = LoraScales;
+    Target->LastUsed = ++PrefixCacheClock;
+
+    if (IsValidSlot(SeqId))
+    {
+        Slots[SeqId].SharedPrefixTokens = Tokens.size();
+    }
+}
+
+bool FLlamaInternal::ProcessPromptWithPrefixCache(const std::vector<llama_token>& Tokens, EChatTemplateRole Role)
+{
+    const llama_seq_id SeqId = ActiveSlotId;
+    if (PrefixCache.empty() || Role != EChatTemplateRole::System || llama_memory_seq_pos_max(llama_get_memory(Context), SeqId) >= 0)
+    {
+        return false;
+    }
+
+    const auto StartTime = ggml_time_us();
+
+    if (RestorePrefixFromCache(Tokens, SeqId))
+    {
+        bPrefillCancelled = false;
+        if (OnPromptProgress)
+        {
+            OnPromptProgress(Tokens.size(), Tokens.size());
+        }
+        if (OnPromptProcessed)
+        {
+            const float Duration = (ggml_time_us() - StartTime) / 1000000.0f;
+            OnPromptProcessed(Tokens.size(), Role, Tokens.size() / FMath::Max(Duration, 1e-6f));
+        }
+        return true;
+    }
+
+    ProcessPromptTokens(Tokens, Role);
+    if (!bPrefillCancelled)
+    {
+        StorePrefixInCache(Tokens, SeqId);
+    }
+    return true;
+}
+
+void FLlamaInternal::ResetContextHistory(bool bKeepSystemsPrompt, int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return;
+    }
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+
+    //Only this slot's work is stopped, other conversations keep generating
+    CancelScheduledSlot(SlotId);
+
+    if (bKeepSystemsPrompt)
+    {
+        //Valid trim case
+        if (Slot.Messages.size() > 1)
+        {
+            //Rollback all the messages except the first one
+            RollbackContextHistoryByMessages(Slot.Messages.size() - 1, SlotId);
+            return;
+        }
+        else
+        {
+            //Only message is the system's prompt, nothing to do
+            return;
+        }
+    }
+
+    //Full Reset, only this slot's KV range is dropped so other conversations are unaffected
+    Slot.ContextHistory.clear();
+    Slot.Messages.clear();
+    Slot.Renderer.Reset();
+
+    llama_memory_seq_rm(llama_get_memory(Context), SlotId, -1, -1);
+    ClearTokenMirror(Slot);
+    Slot.FilledContextCharLength = 0;
+}
+
+void FLlamaInternal::RollbackContextHistoryByTokens(int32 NTokensToErase, int32 SlotId)
+{
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return;
+    }
+
+    CancelScheduledSlot(SlotId);
+
+    // clear the last n_regen tokens from the KV cache and update n_past. The token mirror is the exact
+    // count; otherwise seq_pos_max returns the max position (0-indexed), so token count = seq_pos_max + 1
+    const FLlamaConversationSlot& Slot = ActiveSlot();
+    int32 TokenCount = Slot.bKVTokensValid ? (int32)Slot.KVTokens.size() :
+        llama_memory_seq_pos_max(llama_get_memory(Context), SlotId) + 1;
+
+    TruncateSlotKV(SlotId, TokenCount - NTokensToErase);
+
+    //FilledContextCharLength -= NTokensToErase;
+
+    //Run a decode to sync everything else
+    //llama_decode(Context, llama_batch_get_one(nullptr, 0));
+}
+
+void FLlamaInternal::RollbackContextHistoryByMessages(int32 NMessagesToErase, int32 SlotId)
+{
+    //cannot do rollback if model isn't loaded, ignore.
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return;
+    }
+
+    CancelScheduledSlot(SlotId);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+
+    //Exact path: every message knows where its tokens end in KV, so rollback is a single seq_rm
+    if (HasExactTokenIndex(Slot) && NMessagesToErase <= (int32)Slot.Messages.size())
+    {
+        const int32 KeptMessages = Slot.Messages.size() - NMessagesToErase;
+        const int32 KeptTokens = KeptMessages > 0 ? Slot.MessageTokenEnds[KeptMessages - 1] : 0;
+
+        Slot.Messages.resize(KeptMessages);
+        Slot.MessageTokenStarts.resize(KeptMessages);
+        Slot.MessageTokenEnds.resize(KeptMessages);
+        TruncateSlotKV(SlotId, KeptTokens);
+
+        //Cached render offsets make this a truncation as well
+        Slot.FilledContextCharLength = FMath::Max(ApplyTemplateToContextHistory(false), 0);
+        Slot.ContextHistory.resize(Slot.FilledContextCharLength);
+        return;
+    }
+
+    if (NMessagesToErase <= Slot.Messages.size()) 
+    {
+        Slot.Messages.resize(Slot.Messages.size() - NMessagesToErase);
+    }
+
+    //Message index no longer lines up, further rollbacks use the re-tokenizing path until the next reset
+    Slot.MessageTokenStarts.clear();
+    Slot.MessageTokenEnds.clear();
+
     //Obtain full prompt before it gets deleted
-    std::string FullPrompt(ContextHistory.data(), ContextHistory.data() + FilledContextCharLength);
+    std::string FullPrompt(Slot.ContextHistory.data(), Slot.ContextHistory.data() + Slot.FilledContextCharLength);
     
     //resize the context history
     int32 NewLen = ApplyTemplateToContextHistory(false);
@@ -518,7 +1250,7 @@ void FLlamaInternal::RollbackContextHistoryByMessages(int32 NMessagesToErase)
     //tokenize to find out how many tokens we need to remove
 
     //Obtain new prompt, find delta
-    std::string FormattedPrompt(ContextHistory.data(), ContextHistory.data() + NewLen);
+    std::string FormattedPrompt(Slot.ContextHistory.data(), Slot.ContextHistory.data() + NewLen);
 
     std::string PromptToRemove(FullPrompt.substr(FormattedPrompt.length()));
 
@@ -526,57 +1258,163 @@ void FLlamaInternal::RollbackContextHistoryByMessages(int32 NMessagesToErase)
     const int NPromptTokens = -llama_tokenize(Vocab, PromptToRemove.c_str(), PromptToRemove.size(), NULL, 0, false, true);
 
     //now rollback KV-cache
-    RollbackContextHistoryByTokens(NPromptTokens);
+    RollbackContextHistoryByTokens(NPromptTokens, SlotId);
 
     //Sync resized length;
-    FilledContextCharLength = NewLen;
+    Slot.FilledContextCharLength = NewLen;
 
     //Shrink to fit
-    ContextHistory.resize(FilledContextCharLength);
+    Slot.ContextHistory.resize(Slot.FilledContextCharLength);
 }
 
-std::string FLlamaInternal::InsertRawPrompt(const std::string& Prompt, bool bGenerateReply)
+std::string FLlamaInternal::InsertRawPrompt(const std::string& Prompt, bool bGenerateReply, int32 SlotId)
 {
     if (!bIsModelLoaded)
     {
         UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded"));
         return 0;
     }
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return std::string();
+    }
+    DrainScheduledSlot(SlotId);
 
+    bPrefillCancelled = false;
     int32 TokensProcessed = ProcessPrompt(Prompt);
+    if (bPrefillCancelled)
+    {
+        return "";
+    }
 
-    FLlamaString::AppendToCharVector(ContextHistory, Prompt);
+    FLlamaString::AppendToCharVector(ActiveSlot().ContextHistory, Prompt);
 
     if (bGenerateReply)
     {
         std::string Response = Generate("", false);
-        FLlamaString::AppendToCharVector(ContextHistory, Response);
+        FLlamaString::AppendToCharVector(ActiveSlot().ContextHistory, Response);
     }
     return "";
 }
 
-std::string FLlamaInternal::InsertTemplatedPrompt(const std::string& Prompt, EChatTemplateRole Role, bool bAddAssistantBoS, bool bGenerateReply, const std::string& AssistantPrefill)
+std::string FLlamaInternal::InsertTemplatedPrompt(const std::string& Prompt, EChatTemplateRole Role, bool bAddAssistantBoS, bool bGenerateReply, const std::string& AssistantPrefill, int32 SlotId)
 {
     if (!bIsModelLoaded)
     {
         UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded"));
         return std::string();
     }
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return std::string();
+    }
+
+    //A scheduled prompt on this slot must land first to keep message order
+    DrainScheduledSlot(SlotId);
+    bPrefillCancelled = false;
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    std::vector<char>& ContextHistory = Slot.ContextHistory;
+
+    const int32 MessageTokenStart = Slot.KVTokens.size();
+    const int32 ShiftedBefore = Slot.ShiftedTokenCount;
+    int32 MessageTokens = 0;
+    int32 MessageEndLen = 0;
+
+    int32 NewLen = AppendTemplatedPromptToHistory(Prompt, Role, bAddAssistantBoS, AssistantPrefill, &MessageEndLen);
+    if (NewLen < 0)
+    {
+        return std::string();
+    }
+
+    //Only process non-zero prompts
+    if (NewLen > 0)
+    {
+        std::string FormattedPrompt(ContextHistory.data() + Slot.FilledContextCharLength, ContextHistory.data() + NewLen);
+
+        std::vector<llama_token> PromptTokens;
+        TokenizeTemplatedDelta(FormattedPrompt, MessageEndLen - Slot.FilledContextCharLength, PromptTokens, MessageTokens);
+
+        if (PromptTokens.empty())
+        {
+            EmitErrorMessage(TEXT("failed to tokenize the prompt"), 21, __func__);
+        }
+        //A leading system prompt (shared persona preamble) is reused from the prefix cache when possible
+        else if (!ProcessPromptWithPrefixCache(PromptTokens, Role))
+        {
+            int32 TokensProcessed = ProcessPromptTokens(PromptTokens, Role);
+        }
+
+        //Prefill was stopped: KV is already back where it was, drop the message so history matches it
+        if (bPrefillCancelled)
+        {
+            if (!Prompt.empty())
+            {
+                Slot.Messages.pop_back();
+                ApplyTemplateToContextHistory(false);
+            }
+            return std::string();
+        }
+    }
+
+    if (!Prompt.empty())
+    {
+        //A context shift while decoding moves this message down by what it discarded
+        const int32 Start = MessageTokenStart - (Slot.ShiftedTokenCount - ShiftedBefore);
+        RecordMessageTokenSpan(Start, Start + MessageTokens);
+    }
 
-    int32 NewLen = FilledContextCharLength;
+    Slot.FilledContextCharLength = NewLen;
+
+    //Check for a reply if we want to generate one, otherwise return an empty reply
+    std::string Response;
+    if (bGenerateReply)
+    {
+        //Run generation. AssistantPrefill is forwarded so Generate() can seed the response
+        //accumulator and emit the prefill through OnTokenGenerated before sampling resumes.
+        Response = Generate("", true, bAddAssistantBoS ? AssistantPrefill : std::string());
+    }
+
+    return Response;
+}
+
+int32 FLlamaInternal::AppendTemplatedPromptToHistory(const std::string& Prompt, EChatTemplateRole Role, bool bAddAssistantBoS, const std::string& AssistantPrefill, int32* OutMessageEndLen)
+{
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    std::vector<char>& ContextHistory = Slot.ContextHistory;
+
+    int32 NewLen = Slot.FilledContextCharLength;
+    int32 MessageEndLen = NewLen;
 
     if (!Prompt.empty())
     {
-        Messages.push_back({ RoleForEnum(Role), LLAMA_STRDUP(Prompt.c_str()) });
+        Slot.Messages.push_back({ RoleForEnum(Role), LLAMA_STRDUP(Prompt.c_str()) });
+
+        //Where the message ends and the assistant header begins. Only a prefix-stable template
+        //guarantees the header-less render is a prefix of the one with the header.
+        if (bAddAssistantBoS && Slot.Renderer.IsPrefixStable())
+        {
+            MessageEndLen = ApplyTemplateToContextHistory(false);
+        }
 
         NewLen = ApplyTemplateToContextHistory(bAddAssistantBoS);
+
+        if (!bAddAssistantBoS || !Slot.Renderer.IsPrefixStable() || MessageEndLen < 0 || MessageEndLen > NewLen)
+        {
+            MessageEndLen = NewLen;
+        }
+    }
+
+    if (OutMessageEndLen)
+    {
+        *OutMessageEndLen = MessageEndLen;
     }
 
     //Check for invalid lengths
     if (NewLen < 0)
     {
         UE_LOG(LlamaLog, Warning, TEXT("Inserted prompt after templating has an invalid length of %d, skipping generation. Check your jinja template or model gguf. NB: some templates merge system prompts with user prompts (e.g. gemma) and it's considered normal behavior."), NewLen);
-        return std::string();
+        return NewLen;
     }
 
     //Inject empty think block when thinking is disabled on a thinking-capable model
@@ -610,392 +1448,2711 @@ std::string FLlamaInternal::InsertTemplatedPrompt(const std::string& Prompt, ECh
         UE_LOG(LlamaLog, Warning, TEXT("InsertTemplatedPrompt: AssistantPrefill ignored because bAddAssistantBoS=false"));
     }
 
-    //Only process non-zero prompts
-    if (NewLen > 0)
+    return NewLen;
+}
+
+void FLlamaInternal::RebuildContextFromHistory(const TArray<FStructuredChatMessage>& InMessages, int32 SlotId)
+{
+    if (!bIsModelLoaded)
     {
-        std::string FormattedPrompt(ContextHistory.data() + FilledContextCharLength, ContextHistory.data() + NewLen);
-        int32 TokensProcessed = ProcessPrompt(FormattedPrompt, Role);
+        UE_LOG(LlamaLog, Warning, TEXT("RebuildContextFromHistory: model not loaded, skipping."));
+        return;
+    }
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return;
     }
 
-    FilledContextCharLength = NewLen;
+    CancelScheduledSlot(SlotId);
 
-    //Check for a reply if we want to generate one, otherwise return an empty reply
-    std::string Response;
-    if (bGenerateReply)
+    //Cheap KV+state wipe (mirrors ResetContextHistory full-reset path)
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    Slot.ContextHistory.clear();
+    Slot.Messages.clear();
+    Slot.Renderer.Reset();
+    llama_memory_seq_rm(llama_get_memory(Context), SlotId, -1, -1);
+    ClearTokenMirror(Slot);
+    Slot.FilledContextCharLength = 0;
+
+    //Replay each message through the existing template+decode pipeline without generating
+    for (const FStructuredChatMessage& Msg : InMessages)
     {
-        //Run generation. AssistantPrefill is forwarded so Generate() can seed the response
-        //accumulator and emit the prefill through OnTokenGenerated before sampling resumes.
-        Response = Generate("", true, bAddAssistantBoS ? AssistantPrefill : std::string());
+        const std::string Content = TCHAR_TO_UTF8(*Msg.Content);
+        InsertTemplatedPrompt(Content, Msg.Role, /*bAddAssistantBoS=*/false, /*bGenerateReply=*/false, std::string(), SlotId);
+    }
+}
+
+std::string FLlamaInternal::ResumeGeneration(int32 SlotId)
+{
+    //Todo: erase last assistant message to merge the two messages if the last message was the assistant one.
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return std::string();
+    }
+    DrainScheduledSlot(SlotId);
+
+    //run an empty user prompt
+    return Generate();
+}
+
+std::string FLlamaInternal::RegenerateLastReply(int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return std::string();
+    }
+
+    CancelScheduledSlot(SlotId);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    const char* AssistantRole = RoleForEnum(EChatTemplateRole::Assistant);
+    if (Slot.Messages.empty() || strcmp(Slot.Messages.back().role, AssistantRole) != 0)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("RegenerateLastReply: last message isn't an assistant reply, nothing to regenerate."));
+        return std::string();
+    }
+
+    const int32 ReplyStart = HasExactTokenIndex(Slot) ? Slot.MessageTokenStarts.back() : 0;
+    if (ReplyStart <= 0)
+    {
+        //Legacy path, re-tokenizes the removed text to find the KV cut
+        RollbackContextHistoryByMessages(1, SlotId);
+        return ResumeGeneration(SlotId);
+    }
+
+    //Prefill only belongs to this reply if it was the last one sampled
+    const std::string Prefill = (ReplyStart == Slot.ReplyTokenStart) ? Slot.ReplyPrefill : std::string();
+
+    Slot.Messages.pop_back();
+    Slot.MessageTokenStarts.pop_back();
+    Slot.MessageTokenEnds.pop_back();
+
+    //Header is still in KV, only the reply is cut. Its last token is decoded again for fresh logits.
+    const llama_token LastPromptToken = Slot.KVTokens[ReplyStart - 1];
+    TruncateSlotKV(SlotId, ReplyStart - 1);
+
+    Slot.FilledContextCharLength = FMath::Max(ApplyTemplateToContextHistory(true), 0);
+
+    if (DecodeTokensForSeq(&LastPromptToken, 1, ReplyStart - 1, SlotId))
+    {
+        EmitErrorMessage(TEXT("Failed to decode, could not find a KV slot for the batch (try reducing the size of the batch or increase the context)."), 23, __func__);
+        return std::string();
+    }
+
+    return Generate(std::string(), true, Prefill);
+}
+
+// ---- Reply candidates -------------------------------------------------------
+
+std::vector<std::string> FLlamaInternal::InsertTemplatedPromptCandidates(const std::string& Prompt, EChatTemplateRole Role, int32 NumCandidates, const std::string& AssistantPrefill, int32 SlotId)
+{
+    std::vector<std::string> Responses;
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return Responses;
+    }
+
+    ReleaseReplyCandidates();
+
+    //Candidate 0 uses the slot's sequence, one decoded token per candidate has to fit a batch
+    const int32 MaxCandidates = FMath::Min(1 + (int32)CandidateSeqs.size(), SeqBatchCapacity);
+    if (NumCandidates > MaxCandidates)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("InsertTemplatedPromptCandidates: %d candidates requested, only %d available. Increase ReplyCandidateSequences."), NumCandidates, MaxCandidates);
+    }
+    NumCandidates = FMath::Clamp(NumCandidates, 1, MaxCandidates);
+
+    if (NumCandidates == 1)
+    {
+        Responses.push_back(InsertTemplatedPrompt(Prompt, Role, true, true, AssistantPrefill, SlotId));
+        return Responses;
+    }
+
+    //Decode the prompt once, its last logits seed every candidate
+    InsertTemplatedPrompt(Prompt, Role, true, false, AssistantPrefill, SlotId);
+    if (bPrefillCancelled)
+    {
+        return Responses;
+    }
+
+    //Candidate KV ranges are addressed through the token mirror
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    if (!Slot.bKVTokensValid || Slot.NextGenerationNPast > 0)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("InsertTemplatedPromptCandidates: media in context, generating a single reply."));
+        Responses.push_back(Generate(std::string(), true, AssistantPrefill));
+        return Responses;
+    }
+
+    return GenerateCandidates(NumCandidates, AssistantPrefill);
+}
+
+std::vector<std::string> FLlamaInternal::GenerateCandidates(int32 NumCandidates, const std::string& AssistantPrefill)
+{
+    const auto StartTime = ggml_time_us();
+
+    bGenerationActive = true;
+
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+    llama_memory_t Memory = llama_get_memory(Context);
+    const int32 NContext = llama_n_ctx_seq(Context);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    const llama_seq_id SeqId = ActiveSlotId;
+    const llama_pos NPast = Slot.KVTokens.size();
+
+    Slot.ReplyTokenStart = NPast;
+    Slot.ReplyPrefill = AssistantPrefill;
+
+    //Candidates share the prompt cells, each gets samplers seeded apart so they diverge even with a fixed Seed
+    ReplyCandidates.resize(NumCandidates);
+    for (int32 i = 0; i < NumCandidates; i++)
+    {
+        FLlamaReplyCandidate& Candidate = ReplyCandidates[i];
+        Candidate.SeqId = (i == 0) ? SeqId : CandidateSeqs[i - 1];
+
+        if (i > 0)
+        {
+            llama_memory_seq_rm(Memory, Candidate.SeqId, -1, -1);
+            llama_memory_seq_cp(Memory, SeqId, Candidate.SeqId, -1, -1);
+
+            const int32 Seed = (LastLoadedParams.Seed == -1) ? -1 : LastLoadedParams.Seed + i;
+            BuildSamplers(Slot.ActiveSampling, Seed, Candidate.Sampler, Candidate.CommonSampler);
+            if (Slot.GrammarSampler)
+            {
+                Candidate.GrammarSampler = llama_sampler_clone(Slot.GrammarSampler);
+            }
+
+            //Same penalty history as the slot's own samplers
+            Swap(Slot.Sampler, Candidate.Sampler);
+            Swap(Slot.CommonSampler, Candidate.CommonSampler);
+            ReplaySamplerHistory(Slot, Slot.ActiveSampling.PenaltyLastN);
+            Swap(Slot.Sampler, Candidate.Sampler);
+            Swap(Slot.CommonSampler, Candidate.CommonSampler);
+        }
+
+        Candidate.StopMatcher = Slot.StopMatcher;
+        Candidate.StopMatcher.Reset();
+        Candidate.Response = AssistantPrefill;
+        if (!AssistantPrefill.empty() && OnCandidateTokenGenerated)
+        {
+            OnCandidateTokenGenerated(i, AssistantPrefill);
+        }
+
+        Candidate.NextToken = SampleCandidateToken(Slot, Candidate, -1);
+    }
+
+    int32 NDecoded = 0;
+    while (bGenerationActive)
+    {
+        //One token per live candidate, all in a single decode
+        SeqBatch.n_tokens = 0;
+        for (int32 i = 0; i < NumCandidates; i++)
+        {
+            FLlamaReplyCandidate& Candidate = ReplyCandidates[i];
+            if (Candidate.bDone)
+            {
+                continue;
+            }
+            if (llama_vocab_is_eog(Vocab, Candidate.NextToken))
+            {
+                Candidate.bDone = true;
+                continue;
+            }
+
+            //Candidates can't context shift, their prompt cells are shared
+            const llama_pos Pos = NPast + Candidate.Tokens.size();
+            if (Pos + 1 > NContext)
+            {
+                EmitErrorMessage(FString::Printf(TEXT("Context size %d exceeded on candidate generation. Try increasing the context size and re-run prompt"), NContext), 31, __func__);
+                bGenerationActive = false;
+                break;
+            }
+
+            const bool bStopMatched = Candidate.StopMatcher.Feed(PieceTable.Get(Candidate.NextToken), Pos);
+            const std::string& Emitted = Candidate.StopMatcher.GetEmitted();
+            Candidate.Response += Emitted;
+            if (OnCandidateTokenGenerated && !Emitted.empty())
+            {
+                OnCandidateTokenGenerated(i, Emitted);
+            }
+            if (bStopMatched)
+            {
+                //Tokens holding only stop sequence bytes leave KV, matching Generate
+                const int32 Keep = Candidate.StopMatcher.GetKeepTag() - NPast;
+                Candidate.bDone = true;
+                Candidate.bStopMatched = true;
+                if (Keep > (int32)Candidate.Tokens.size())
+                {
+                    //This token's text was partly released, it lands with the batch but isn't sampled from
+                    BatchAddToken(SeqBatch, Candidate.NextToken, Pos, Candidate.SeqId, false);
+                    Candidate.Tokens.push_back(Candidate.NextToken);
+                    NDecoded++;
+                    continue;
+                }
+                llama_memory_seq_rm(Memory, Candidate.SeqId, NPast + Keep, -1);
+                Candidate.Tokens.resize(FMath::Clamp(Keep, 0, (int32)Candidate.Tokens.size()));
+                continue;
+            }
+
+            Candidate.BatchLogitIndex = SeqBatch.n_tokens;
+            BatchAddToken(SeqBatch, Candidate.NextToken, Pos, Candidate.SeqId, true);
+            Candidate.Tokens.push_back(Candidate.NextToken);
+            NDecoded++;
+        }
+
+        if (SeqBatch.n_tokens == 0 || !bGenerationActive)
+        {
+            break;
+        }
+
+        if (llama_decode(Context, SeqBatch))
+        {
+            EmitErrorMessage(TEXT("Failed to decode. Could not find a KV slot for the batch (try reducing the size of the batch or increase the context)"), 32, __func__);
+            break;
+        }
+
+        for (FLlamaReplyCandidate& Candidate : ReplyCandidates)
+        {
+            if (Candidate.BatchLogitIndex >= 0)
+            {
+                Candidate.NextToken = SampleCandidateToken(Slot, Candidate, Candidate.BatchLogitIndex);
+                Candidate.BatchLogitIndex = -1;
+            }
+        }
+
+        //sleep pacing
+        if (LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep > 0.f)
+        {
+            FPlatformProcess::Sleep(LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep);
+        }
+    }
+
+    bGenerationActive = false;
+
+    std::vector<std::string> Responses;
+    for (int32 i = 0; i < NumCandidates; i++)
+    {
+        FLlamaReplyCandidate& Candidate = ReplyCandidates[i];
+        FreeCandidateSamplers(Candidate);
+
+        //A failed decode leaves the last token unconfirmed, it is dropped from KV and the candidate
+        if (Candidate.BatchLogitIndex >= 0)
+        {
+            Candidate.Tokens.pop_back();
+            llama_memory_seq_rm(Memory, Candidate.SeqId, NPast + Candidate.Tokens.size(), -1);
+            Candidate.BatchLogitIndex = -1;
+        }
+
+        //No stop sequence followed, release the held back tail
+        if (!Candidate.bStopMatched)
+        {
+            const std::string& Tail = Candidate.StopMatcher.Flush();
+            Candidate.Response += Tail;
+            if (OnCandidateTokenGenerated && !Tail.empty())
+            {
+                OnCandidateTokenGenerated(i, Tail);
+            }
+        }
+    }
+
+    //Candidate 0 becomes the slot's reply
+    FLlamaReplyCandidate& Committed = ReplyCandidates[0];
+    AppendToTokenMirror(SeqId, Committed.Tokens.data(), Committed.Tokens.size(), NPast);
+    Responses.push_back(CommitResponse(Committed.Response, true));
+    for (int32 i = 1; i < NumCandidates; i++)
+    {
+        Responses.push_back(CommitResponse(ReplyCandidates[i].Response, false));
+    }
+
+    CandidateSlotId = SeqId;
+    CandidateReplyStart = NPast;
+
+    const auto StopTime = ggml_time_us();
+    const float Duration = (StopTime - StartTime) / 1000000.0f;
+
+    //Speed is aggregate over all candidates
+    LastRunTimings = FLlamaRunTimings();
+    LastRunTimings.TotalTime = Duration;
+    LastRunTimings.TokensPerSecond = NDecoded / Duration;
+
+    if (OnGenerationComplete)
+    {
+        OnGenerationComplete(Responses[0], Duration, NDecoded, NDecoded / Duration);
+    }
+
+    return Responses;
+}
+
+llama_token FLlamaInternal::SampleCandidateToken(FLlamaConversationSlot& Slot, FLlamaReplyCandidate& Candidate, int32 LogitIndex)
+{
+    //Candidate 0 owns no samplers
+    if (!Candidate.Sampler && !Candidate.CommonSampler)
+    {
+        return SampleSlotToken(Slot, LogitIndex);
+    }
+
+    Swap(Slot.Sampler, Candidate.Sampler);
+    Swap(Slot.CommonSampler, Candidate.CommonSampler);
+    Swap(Slot.GrammarSampler, Candidate.GrammarSampler);
+    const llama_token Token = SampleSlotToken(Slot, LogitIndex);
+    Swap(Slot.Sampler, Candidate.Sampler);
+    Swap(Slot.CommonSampler, Candidate.CommonSampler);
+    Swap(Slot.GrammarSampler, Candidate.GrammarSampler);
+    return Token;
+}
+
+void FLlamaInternal::FreeCandidateSamplers(FLlamaReplyCandidate& Candidate)
+{
+    if (Candidate.Sampler)
+    {
+        llama_sampler_free(Candidate.Sampler);
+        Candidate.Sampler = nullptr;
+    }
+    if (Candidate.CommonSampler)
+    {
+        common_sampler_free(Candidate.CommonSampler);
+        Candidate.CommonSampler = nullptr;
+    }
+    if (Candidate.GrammarSampler)
+    {
+        llama_sampler_free(Candidate.GrammarSampler);
+        Candidate.GrammarSampler = nullptr;
+    }
+}
+
+bool FLlamaInternal::SelectReplyCandidate(int32 CandidateIndex, int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return false;
+    }
+
+    DrainScheduledSlot(SlotId);
+
+    //The committed reply must still be candidate 0's, at the end of the conversation
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    const char* AssistantRole = RoleForEnum(EChatTemplateRole::Assistant);
+    const bool bValid = CandidateSlotId == SlotId && CandidateIndex >= 0 && CandidateIndex < (int32)ReplyCandidates.size() &&
+        !Slot.Messages.empty() && strcmp(Slot.Messages.back().role, AssistantRole) == 0 &&
+        Slot.bKVTokensValid && Slot.MessageTokenStarts.size() == Slot.Messages.size() && Slot.MessageTokenStarts.back() == CandidateReplyStart &&
+        (int32)Slot.KVTokens.size() == CandidateReplyStart + (int32)ReplyCandidates[0].Tokens.size() &&
+        memcmp(ReplyCandidates[0].Tokens.data(), Slot.KVTokens.data() + CandidateReplyStart, ReplyCandidates[0].Tokens.size() * sizeof(llama_token)) == 0;
+
+    if (!bValid)
+    {
+        EmitErrorMessage(FString::Printf(TEXT("Reply candidate %d of slot %d is no longer available, the conversation changed since it was generated."), CandidateIndex, SlotId), 33, __func__);
+        ReleaseReplyCandidates();
+        return false;
+    }
+
+    if (CandidateIndex > 0)
+    {
+        const FLlamaReplyCandidate& Candidate = ReplyCandidates[CandidateIndex];
+
+        Slot.Messages.pop_back();
+        Slot.MessageTokenStarts.pop_back();
+        Slot.MessageTokenEnds.pop_back();
+
+        //Prompt cells are shared, only the reply range moves over
+        TruncateSlotKV(SlotId, CandidateReplyStart);
+        llama_memory_seq_cp(llama_get_memory(Context), Candidate.SeqId, SlotId, CandidateReplyStart, -1);
+        AppendToTokenMirror(SlotId, Candidate.Tokens.data(), Candidate.Tokens.size(), CandidateReplyStart);
+
+        Slot.ReplyTokenStart = CandidateReplyStart;
+        CommitResponse(Candidate.Response, true);
+    }
+
+    ReleaseReplyCandidates();
+    return true;
+}
+
+void FLlamaInternal::ReleaseReplyCandidates()
+{
+    llama_memory_t Memory = llama_get_memory(Context);
+    for (int32 i = 1; i < (int32)ReplyCandidates.size(); i++)
+    {
+        llama_memory_seq_rm(Memory, ReplyCandidates[i].SeqId, -1, -1);
+    }
+    ReplyCandidates.clear();
+    CandidateSlotId = -1;
+}
+
+// ---- Session state ---------------------------------------------------------
+
+namespace
+{
+    static constexpr uint32 SessionStateMagic = 0x4C534553; // 'LSES'
+    static constexpr uint32 SessionStateVersion = 1;
+
+    //zlib can't inflate past ~1032:1, a header claiming more is corrupt
+    static constexpr int64 MaxSessionInflateRatio = 1032;
+
+    //Loading: true if Count elements of ElementSize bytes fit in what's left of the archive, else flags the archive.
+    //Sizes come from the file and are checked before anything is allocated for them.
+    static bool CheckRemaining(FArchive& Ar, int32 Count, int64 ElementSize)
+    {
+        if (Ar.IsError() || Count < 0 || (int64)Count * ElementSize > Ar.TotalSize() - Ar.Tell())
+        {
+            Ar.SetError();
+            return false;
+        }
+        return true;
+    }
+
+    static void SerializeStdString(FArchive& Ar, std::string& Text)
+    {
+        int32 Length = (int32)Text.size();
+        Ar << Length;
+        if (Ar.IsLoading())
+        {
+            if (!CheckRemaining(Ar, Length, 1))
+            {
+                Text.clear();
+                return;
+            }
+            Text.resize(Length);
+        }
+        Ar.Serialize(Text.data(), Text.size());
+    }
+
+    template<typename T>
+    static void SerializeStdVector(FArchive& Ar, std::vector<T>& Values)
+    {
+        int32 Count = (int32)Values.size();
+        Ar << Count;
+        if (Ar.IsLoading())
+        {
+            if (!CheckRemaining(Ar, Count, sizeof(T)))
+            {
+                Values.clear();
+                return;
+            }
+            Values.resize(Count);
+        }
+        Ar.Serialize(Values.data(), Values.size() * sizeof(T));
+    }
+}
+
+uint64 FLlamaInternal::ModelStateHash() const
+{
+    if (!LlamaModel)
+    {
+        return 0;
+    }
+
+    //Architecture + size fingerprint, cheap compared to hashing the GGUF and stable across file moves
+    char Desc[256] = {};
+    llama_model_desc(LlamaModel, Desc, sizeof(Desc));
+    const std::string Key = std::string(Desc) +
+        "|" + std::to_string(llama_model_n_params(LlamaModel)) +
+        "|" + std::to_string(llama_model_size(LlamaModel)) +
+        "|" + std::to_string(llama_model_n_embd(LlamaModel)) +
+        "|" + std::to_string(llama_model_n_layer(LlamaModel)) +
+        "|" + std::to_string(llama_vocab_n_tokens(llama_model_get_vocab(LlamaModel)));
+
+    return CityHash64(Key.data(), Key.size());
+}
+
+bool FLlamaInternal::SaveSlotState(TArray<uint8>& OutData, bool bCompress, int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return false;
+    }
+
+    //Land any scheduled work so KV and history agree
+    DrainScheduledSlot(SlotId);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+
+    TArray<uint8> Payload;
+    FMemoryWriter Writer(Payload, /*bIsPersistent*/ true);
+
+    int32 MessageCount = Slot.Messages.size();
+    Writer << MessageCount;
+    for (const llama_chat_message& Message : Slot.Messages)
+    {
+        std::string Role = Message.role;
+        std::string Content = Message.content;
+        SerializeStdString(Writer, Role);
+        SerializeStdString(Writer, Content);
+    }
+
+    uint8 bTokensValid = Slot.bKVTokensValid ? 1 : 0;
+    Writer << bTokensValid;
+    SerializeStdVector(Writer, Slot.KVTokens);
+    SerializeStdVector(Writer, Slot.MessageTokenStarts);
+    SerializeStdVector(Writer, Slot.MessageTokenEnds);
+
+    //Sampler RNG internals aren't reachable through llama.h, the seed is stored and the sampler rebuilt with it on load
+    uint32 Seed = Slot.CommonSampler ? common_sampler_get_seed(Slot.CommonSampler) :
+        (Slot.Sampler ? llama_sampler_get_seed(Slot.Sampler) : LLAMA_DEFAULT_SEED);
+    Writer << Seed;
+
+    //KV last, written straight into the payload
+    int64 KVSize = llama_state_seq_get_size(Context, SlotId);
+    Writer << KVSize;
+    const int64 KVOffset = Payload.Num();
+    Payload.AddUninitialized(KVSize);
+    if (KVSize > 0 && llama_state_seq_get_data(Context, Payload.GetData() + KVOffset, KVSize, SlotId) != (size_t)KVSize)
+    {
+        EmitErrorMessage(FString::Printf(TEXT("Failed to copy %lld bytes of KV state for slot %d."), KVSize, SlotId), 104, __func__);
+        return false;
+    }
+
+    //Header is never compressed so version/model checks don't need to inflate the payload
+    FMemoryWriter Header(OutData, /*bIsPersistent*/ true);
+    uint32 Magic = SessionStateMagic;
+    uint32 Version = SessionStateVersion;
+    uint64 ModelHash = ModelStateHash();
+    int64 PayloadSize = Payload.Num();
+    bCompress = bCompress && PayloadSize < MAX_int32;
+    uint8 bCompressed = bCompress ? 1 : 0;
+    Header << Magic << Version << ModelHash << bCompressed << PayloadSize;
+
+    if (bCompress)
+    {
+        int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, (int32)PayloadSize);
+        const int64 DataOffset = OutData.Num();
+        OutData.AddUninitialized(CompressedSize);
+        if (!FCompression::CompressMemory(NAME_Zlib, OutData.GetData() + DataOffset, CompressedSize, Payload.GetData(), (int32)PayloadSize))
+        {
+            EmitErrorMessage(TEXT("Failed to compress session state."), 104, __func__);
+            return false;
+        }
+        OutData.SetNum(DataOffset + CompressedSize);
+    }
+    else
+    {
+        OutData.Append(Payload);
+    }
+    return true;
+}
+
+bool FLlamaInternal::LoadSlotState(const TArray<uint8>& InData, int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return false;
+    }
+
+    FMemoryReader Header(InData, /*bIsPersistent*/ true);
+    uint32 Magic = 0, Version = 0;
+    uint64 ModelHash = 0;
+    uint8 bCompressed = 0;
+    int64 PayloadSize = 0;
+    Header << Magic << Version << ModelHash << bCompressed << PayloadSize;
+
+    if (Header.IsError() || Magic != SessionStateMagic || Version != SessionStateVersion || PayloadSize < 0)
+    {
+        EmitErrorMessage(FString::Printf(TEXT("Not a session state file or unsupported version (%u)."), Version), 105, __func__);
+        return false;
+    }
+    if (ModelHash != ModelStateHash())
+    {
+        EmitErrorMessage(TEXT("Session state was saved with a different model."), 106, __func__);
+        return false;
+    }
+
+    const int64 DataOffset = Header.Tell();
+    TArray<uint8> Inflated;
+    const uint8* PayloadData = InData.GetData() + DataOffset;
+    if (bCompressed)
+    {
+        const int64 CompressedSize = InData.Num() - DataOffset;
+        if (PayloadSize < MAX_int32 && PayloadSize <= CompressedSize * MaxSessionInflateRatio)
+        {
+            Inflated.SetNumUninitialized(PayloadSize);
+        }
+        if (Inflated.Num() != PayloadSize ||
+            !FCompression::UncompressMemory(NAME_Zlib, Inflated.GetData(), (int32)PayloadSize, PayloadData, (int32)CompressedSize))
+        {
+            EmitErrorMessage(TEXT("Failed to decompress session state."), 105, __func__);
+            return false;
+        }
+        PayloadData = Inflated.GetData();
+    }
+    else if (InData.Num() - DataOffset < PayloadSize)
+    {
+        EmitErrorMessage(TEXT("Session state file is truncated."), 105, __func__);
+        return false;
+    }
+
+    //Parse everything before touching the slot so a bad file leaves it as it was
+    TArrayView<const uint8> PayloadView(PayloadData, PayloadSize);
+    FMemoryReaderView Reader(PayloadView, /*bIsPersistent*/ true);
+
+    //Every message stores at least its two string lengths
+    int32 MessageCount = 0;
+    Reader << MessageCount;
+    if (!CheckRemaining(Reader, MessageCount, 2 * sizeof(int32)))
+    {
+        MessageCount = 0;
+    }
+    std::vector<std::string> Roles(MessageCount);
+    std::vector<std::string> Contents(MessageCount);
+    for (int32 i = 0; i < MessageCount && !Reader.IsError(); i++)
+    {
+        SerializeStdString(Reader, Roles[i]);
+        SerializeStdString(Reader, Contents[i]);
+    }
+
+    uint8 bTokensValid = 0;
+    std::vector<llama_token> Tokens;
+    std::vector<int32> Starts;
+    std::vector<int32> Ends;
+    uint32 Seed = 0;
+    int64 KVSize = 0;
+    Reader << bTokensValid;
+    SerializeStdVector(Reader, Tokens);
+    SerializeStdVector(Reader, Starts);
+    SerializeStdVector(Reader, Ends);
+    Reader << Seed;
+    Reader << KVSize;
+
+    if (Reader.IsError() || KVSize < 0 || Reader.Tell() + KVSize > PayloadSize)
+    {
+        EmitErrorMessage(TEXT("Session state payload is corrupt."), 105, __func__);
+        return false;
+    }
+
+    CancelScheduledSlot(SlotId);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    llama_memory_seq_rm(llama_get_memory(Context), SlotId, -1, -1);
+    ClearTokenMirror(Slot);
+    Slot.Messages.clear();
+    Slot.ContextHistory.clear();
+    Slot.Renderer.Reset();
+    Slot.FilledContextCharLength = 0;
+
+    if (KVSize > 0 && llama_state_seq_set_data(Context, PayloadData + Reader.Tell(), KVSize, SlotId) == 0)
+    {
+        EmitErrorMessage(TEXT("llama_state_seq_set_data rejected the KV state (context settings differ from the save?)."), 105, __func__);
+        llama_memory_seq_rm(llama_get_memory(Context), SlotId, -1, -1);
+        return false;
+    }
+
+    for (int32 i = 0; i < MessageCount; i++)
+    {
+        Slot.Messages.push_back({ LLAMA_STRDUP(Roles[i].c_str()), LLAMA_STRDUP(Contents[i].c_str()) });
+    }
+    Slot.KVTokens = std::move(Tokens);
+    Slot.bKVTokensValid = bTokensValid != 0;
+    Slot.MessageTokenStarts = std::move(Starts);
+    Slot.MessageTokenEnds = std::move(Ends);
+    Slot.FilledContextCharLength = FMath::Max(ApplyTemplateToContextHistory(false), 0);
+
+    //Fresh RNG from the saved seed, then replay recent tokens so repetition penalties see the restored history
+    const uint32 CurrentSeed = Slot.CommonSampler ? common_sampler_get_seed(Slot.CommonSampler) :
+        (Slot.Sampler ? llama_sampler_get_seed(Slot.Sampler) : LLAMA_DEFAULT_SEED);
+    if (CurrentSeed != Seed && (Slot.Sampler || Slot.CommonSampler))
+    {
+        UE_LOG(LlamaLog, Log, TEXT("LoadSlotState: rebuilding slot %d sampler with saved seed %u (was %u)."), SlotId, Seed, CurrentSeed);
+        if (Slot.Sampler)
+        {
+            llama_sampler_free(Slot.Sampler);
+        }
+        if (Slot.CommonSampler)
+        {
+            common_sampler_free(Slot.CommonSampler);
+        }
+        //Rebuilt from the set the slot is using, which may be an override rather than the load-time params
+        BuildSamplers(Slot.ActiveSampling, (int32)Seed, Slot.Sampler, Slot.CommonSampler);
+    }
+
+    ReplaySamplerHistory(Slot, Slot.ActiveSampling.PenaltyLastN);
+    return true;
+}
+
+void FLlamaInternal::ReplaySamplerHistory(FLlamaConversationSlot& Slot, int32 PenaltyLastN)
+{
+    //Samplers only ever accept sampled tokens, so only replies are fed: assistant message spans, then the
+    //reply in progress. Without an exact index only the current reply is known.
+    std::vector<llama_token> History;
+    const int32 NMirrored = Slot.KVTokens.size();
+    if (HasExactTokenIndex(Slot))
+    {
+        const char* AssistantRole = RoleForEnum(EChatTemplateRole::Assistant);
+        for (int32 i = 0; i < (int32)Slot.Messages.size(); i++)
+        {
+            if (strcmp(Slot.Messages[i].role, AssistantRole) == 0)
+            {
+                const int32 Start = FMath::Clamp(Slot.MessageTokenStarts[i], 0, NMirrored);
+                const int32 End = FMath::Clamp(Slot.MessageTokenEnds[i], Start, NMirrored);
+                History.insert(History.end(), Slot.KVTokens.begin() + Start, Slot.KVTokens.begin() + End);
+            }
+        }
+    }
+    const int32 LastSpanEnd = Slot.MessageTokenEnds.empty() ? 0 : Slot.MessageTokenEnds.back();
+    if (Slot.ReplyTokenStart >= LastSpanEnd && Slot.ReplyTokenStart < NMirrored)
+    {
+        History.insert(History.end(), Slot.KVTokens.begin() + Slot.ReplyTokenStart, Slot.KVTokens.end());
+    }
+
+    const int32 ReplayStart = History.size() - FMath::Min((int32)History.size(), FMath::Max(PenaltyLastN, 64));
+    if (Slot.CommonSampler)
+    {
+        common_sampler_reset(Slot.CommonSampler);
+        for (int32 i = ReplayStart; i < (int32)History.size(); i++)
+        {
+            common_sampler_accept(Slot.CommonSampler, History[i], false);
+        }
+    }
+    else if (Slot.Sampler)
+    {
+        llama_sampler_reset(Slot.Sampler);
+        for (int32 i = ReplayStart; i < (int32)History.size(); i++)
+        {
+            llama_sampler_accept(Slot.Sampler, History[i]);
+        }
+    }
+}
+
+// ---- Snapshots -------------------------------------------------------------
+
+bool FLlamaInternal::SnapshotSlot(int32 Handle, int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return false;
+    }
+
+    DrainScheduledSlot(SlotId);
+    ReleaseSnapshot(Handle);
+
+    const FLlamaConversationSlot& Slot = ActiveSlot();
+    FLlamaKVSnapshot Snapshot;
+
+    if (!FreeSnapshotSeqs.empty())
+    {
+        Snapshot.SeqId = FreeSnapshotSeqs.back();
+        FreeSnapshotSeqs.pop_back();
+
+        llama_memory_t Memory = llama_get_memory(Context);
+        llama_memory_seq_rm(Memory, Snapshot.SeqId, -1, -1);
+        llama_memory_seq_cp(Memory, SlotId, Snapshot.SeqId, -1, -1);
+    }
+    else
+    {
+        Snapshot.HostKV.resize(llama_state_seq_get_size(Context, SlotId));
+        if (!Snapshot.HostKV.empty() &&
+            llama_state_seq_get_data(Context, Snapshot.HostKV.data(), Snapshot.HostKV.size(), SlotId) != Snapshot.HostKV.size())
+        {
+            EmitErrorMessage(FString::Printf(TEXT("Failed to copy KV state of slot %d for a snapshot."), SlotId), 104, __func__);
+            return false;
+        }
+    }
+
+    for (const llama_chat_message& Message : Slot.Messages)
+    {
+        Snapshot.Roles.push_back(Message.role);
+        Snapshot.Contents.push_back(Message.content);
+    }
+    Snapshot.KVTokens = Slot.KVTokens;
+    Snapshot.bKVTokensValid = Slot.bKVTokensValid;
+    Snapshot.MessageTokenStarts = Slot.MessageTokenStarts;
+    Snapshot.MessageTokenEnds = Slot.MessageTokenEnds;
+    Snapshot.SharedPrefixTokens = Slot.SharedPrefixTokens;
+
+    Snapshots.Add(Handle, MoveTemp(Snapshot));
+    return true;
+}
+
+bool FLlamaInternal::RestoreSnapshot(int32 Handle, int32 SlotId)
+{
+    if (!bIsModelLoaded || !SelectSlot(SlotId, __func__))
+    {
+        return false;
+    }
+
+    const FLlamaKVSnapshot* Snapshot = Snapshots.Find(Handle);
+    if (!Snapshot)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("RestoreSnapshot: unknown snapshot handle %d."), Handle);
+        return false;
+    }
+
+    CancelScheduledSlot(SlotId);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    llama_memory_t Memory = llama_get_memory(Context);
+    llama_memory_seq_rm(Memory, SlotId, -1, -1);
+
+    if (Snapshot->SeqId >= 0)
+    {
+        llama_memory_seq_cp(Memory, Snapshot->SeqId, SlotId, -1, -1);
+    }
+    else if (!Snapshot->HostKV.empty() &&
+        llama_state_seq_set_data(Context, Snapshot->HostKV.data(), Snapshot->HostKV.size(), SlotId) == 0)
+    {
+        EmitErrorMessage(FString::Printf(TEXT("Failed to restore snapshot %d into slot %d."), Handle, SlotId), 105, __func__);
+        ResetContextHistory(false, SlotId);
+        return false;
+    }
+
+    Slot.Messages.clear();
+    for (int32 i = 0; i < (int32)Snapshot->Roles.size(); i++)
+    {
+        Slot.Messages.push_back({ LLAMA_STRDUP(Snapshot->Roles[i].c_str()), LLAMA_STRDUP(Snapshot->Contents[i].c_str()) });
+    }
+    ClearTokenMirror(Slot);
+    Slot.KVTokens = Snapshot->KVTokens;
+    Slot.bKVTokensValid = Snapshot->bKVTokensValid;
+    Slot.MessageTokenStarts = Snapshot->MessageTokenStarts;
+    Slot.MessageTokenEnds = Snapshot->MessageTokenEnds;
+    Slot.SharedPrefixTokens = Snapshot->SharedPrefixTokens;
+
+    Slot.ContextHistory.clear();
+    Slot.Renderer.Reset();
+    Slot.FilledContextCharLength = FMath::Max(ApplyTemplateToContextHistory(false), 0);
+    return true;
+}
+
+void FLlamaInternal::ReleaseSnapshot(int32 Handle)
+{
+    FLlamaKVSnapshot Snapshot;
+    if (!Snapshots.RemoveAndCopyValue(Handle, Snapshot))
+    {
+        return;
+    }
+
+    if (Snapshot.SeqId >= 0)
+    {
+        llama_memory_seq_rm(llama_get_memory(Context), Snapshot.SeqId, -1, -1);
+        FreeSnapshotSeqs.push_back(Snapshot.SeqId);
+    }
+}
+
+void FLlamaInternal::DemoteSequenceSnapshots()
+{
+    llama_memory_t Memory = llama_get_memory(Context);
+    for (TPair<int32, FLlamaKVSnapshot>& Pair : Snapshots)
+    {
+        FLlamaKVSnapshot& Snapshot = Pair.Value;
+        if (Snapshot.SeqId < 0)
+        {
+            continue;
+        }
+
+        Snapshot.HostKV.resize(llama_state_seq_get_size(Context, Snapshot.SeqId));
+        if (!Snapshot.HostKV.empty())
+        {
+            llama_state_seq_get_data(Context, Snapshot.HostKV.data(), Snapshot.HostKV.size(), Snapshot.SeqId);
+        }
+        llama_memory_seq_rm(Memory, Snapshot.SeqId, -1, -1);
+        FreeSnapshotSeqs.push_back(Snapshot.SeqId);
+        Snapshot.SeqId = -1;
+    }
+}
+
+void FLlamaInternal::ScheduleTemplatedPrompt(const FLlamaScheduledPrompt& Prompt, int32 SlotId)
+{
+    if (!bIsModelLoaded)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded"));
+        return;
+    }
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return;
+    }
+
+    ActiveSlot().QueuedPrompts.push_back(Prompt);
+    bScheduledWorkActive = true;
+}
+
+bool FLlamaInternal::HasScheduledWork()
+{
+    return bScheduledWorkActive;
+}
+
+int32 FLlamaInternal::StepScheduledSlots()
+{
+    if (!bIsModelLoaded || !bScheduledWorkActive)
+    {
+        return 0;
+    }
+
+    const int32 CallerSlotId = ActiveSlotId;
+    const int32 SlotCount = NumSlots();
+
+    //Consume a pending stop request, generating slots finish after this step's decode
+    const bool bStopping = bStopScheduledRequested;
+    bStopScheduledRequested = false;
+
+    //Pull the next queued prompt into every idle slot. Prompts with nothing to decode complete inline.
+    for (int32 SlotId = 0; SlotId < SlotCount; SlotId++)
+    {
+        FLlamaConversationSlot& Slot = Slots[SlotId];
+        while (!Slot.QueuedPrompts.empty() && !Slot.bScheduledGenerating && Slot.PrefillOffset >= (int32)Slot.PrefillTokens.size())
+        {
+            BeginScheduledPrompt(SlotId);
+        }
+    }
+
+    //LoRA adapters are set per context, so a batch only carries slots running the same adapter set.
+    //The slot that picks the set rotates with PrefillCursor, so every set gets its turn.
+    const std::vector<float>* BatchLora = nullptr;
+    for (int32 i = 0; i < SlotCount && !LoraAdapters.empty(); i++)
+    {
+        const FLlamaConversationSlot& Slot = Slots[(PrefillCursor + i) % SlotCount];
+        if ((Slot.bScheduledGenerating && Slot.PendingToken != LLAMA_TOKEN_NULL) || Slot.PrefillOffset < (int32)Slot.PrefillTokens.size())
+        {
+            BatchLora = &Slot.ActiveLoraScales();
+            ApplyLoraScales(*BatchLora);
+            break;
+        }
+    }
+    auto InLoraGroup = [BatchLora](const FLlamaConversationSlot& Slot)
+    {
+        return !BatchLora || Slot.ActiveLoraScales() == *BatchLora;
+    };
+
+    //Build one batch: the last sampled token of every generating slot first so decode latency stays
+    //flat, then fill the remaining n_batch room with prompt prefill chunks.
+    SeqBatch.n_tokens = 0;
+
+    for (int32 SlotId = 0; SlotId < SlotCount && SeqBatch.n_tokens < SeqBatchCapacity; SlotId++)
+    {
+        FLlamaConversationSlot& Slot = Slots[SlotId];
+        if (Slot.bScheduledGenerating && Slot.PendingToken != LLAMA_TOKEN_NULL && InLoraGroup(Slot))
+        {
+            Slot.BatchLogitIndex = SeqBatch.n_tokens;
+            BatchAddToken(SeqBatch, Slot.PendingToken, Slot.ScheduledNPast, SlotId, true);
+        }
+    }
+
+    //Rotate the starting slot so one long prompt can't starve the others of prefill room
+    for (int32 i = 0; i < SlotCount && SeqBatch.n_tokens < SeqBatchCapacity; i++)
+    {
+        const int32 SlotId = (PrefillCursor + i) % SlotCount;
+        FLlamaConversationSlot& Slot = Slots[SlotId];
+
+        const int32 TotalTokens = (int32)Slot.PrefillTokens.size();
+        const int32 Remaining = TotalTokens - Slot.PrefillOffset;
+        if (Remaining <= 0 || !InLoraGroup(Slot))
+        {
+            continue;
+        }
+
+        const int32 ChunkSize = FMath::Min(Remaining, SeqBatchCapacity - SeqBatch.n_tokens);
+        for (int32 j = 0; j < ChunkSize; j++)
+        {
+            const int32 TokenIndex = Slot.PrefillOffset + j;
+            const bool bLogits = (TokenIndex == TotalTokens - 1) && Slot.CurrentPrompt.bGenerateReply;
+            if (bLogits)
+            {
+                Slot.BatchLogitIndex = SeqBatch.n_tokens;
+            }
+            BatchAddToken(SeqBatch, Slot.PrefillTokens[TokenIndex], Slot.ScheduledNPast + j, SlotId, bLogits);
+        }
+        Slot.PrefillInFlight = ChunkSize;
+    }
+    PrefillCursor = SlotCount > 0 ? (PrefillCursor + 1) % SlotCount : 0;
+
+    const int32 NTokens = SeqBatch.n_tokens;
+    if (NTokens == 0)
+    {
+        UpdateScheduledWorkState();
+        ActiveSlotId = CallerSlotId;
+        return 0;
+    }
+
+    if (llama_decode(Context, SeqBatch) != 0)
+    {
+        EmitErrorMessage(FString::Printf(TEXT("Failed to decode a scheduled batch of %d tokens. Could not find a KV slot for the batch (try reducing the number of active slots or increase the context)"), NTokens), 32, __func__);
+
+        //Nothing in this batch landed in KV, drop every participant so history doesn't drift further
+        for (int32 SlotId = 0; SlotId < SlotCount; SlotId++)
+        {
+            FLlamaConversationSlot& Slot = Slots[SlotId];
+            if (Slot.PrefillInFlight > 0)
+            {
+                //Earlier chunks of this prompt did land, cut them back out so KV matches the mirror
+                TruncateSlotKV(SlotId, (int32)Slot.KVTokens.size() - Slot.PrefillOffset);
+
+                Slot.PrefillTokens.clear();
+                Slot.PrefillOffset = 0;
+                Slot.PrefillInFlight = 0;
+                Slot.BatchLogitIndex = -1;
+                Slot.bStorePrefillInCache = false;
+
+                //The message never made it into KV, drop it and its span like the synchronous cancel path
+                ActiveSlotId = SlotId;
+                if (!Slot.CurrentPrompt.Prompt.empty() && !Slot.Messages.empty())
+                {
+                    Slot.Messages.pop_back();
+                    if (!Slot.MessageTokenStarts.empty())
+                    {
+                        Slot.MessageTokenStarts.pop_back();
+                        Slot.MessageTokenEnds.pop_back();
+                    }
+                }
+                Slot.FilledContextCharLength = FMath::Max(ApplyTemplateToContextHistory(false), 0);
+
+                //Same as a prompt with nothing to decode, the caller still gets its finish callback.
+                //Move out first, the callback may queue a follow-up prompt on this slot.
+                FLlamaScheduledPrompt Failed = MoveTemp(Slot.CurrentPrompt);
+                Slot.CurrentPrompt = FLlamaScheduledPrompt();
+                SetSlotLoraOverride(nullptr, SlotId);
+                if (Failed.OnReplyFinished && Failed.bGenerateReply)
+                {
+                    Failed.OnReplyFinished(std::string());
+                }
+            }
+            if (Slot.bScheduledGenerating && Slot.PendingToken != LLAMA_TOKEN_NULL && Slot.BatchLogitIndex >= 0)
+            {
+                Slot.PendingToken = LLAMA_TOKEN_NULL;
+
+                //The reply isn't committed to history, so its streamed tokens can't stay in KV either
+                TruncateSlotKV(SlotId, Slot.ReplyTokenStart);
+                FinishScheduledGeneration(SlotId, false);
+            }
+        }
+        UpdateScheduledWorkState();
+        ActiveSlotId = CallerSlotId;
+        return 0;
+    }
+
+    //Commit what landed in KV
+    for (int32 SlotId = 0; SlotId < SlotCount; SlotId++)
+    {
+        FLlamaConversationSlot& Slot = Slots[SlotId];
+
+        //Generating slots held back for another adapter set keep their pending token
+        if (Slot.bScheduledGenerating && Slot.PendingToken != LLAMA_TOKEN_NULL && Slot.BatchLogitIndex >= 0)
+        {
+            AppendToTokenMirror(SlotId, &Slot.PendingToken, 1, Slot.ScheduledNPast);
+            Slot.PendingToken = LLAMA_TOKEN_NULL;
+            Slot.ScheduledNPast++;
+        }
+
+        if (Slot.PrefillInFlight > 0)
+        {
+            AppendToTokenMirror(SlotId, Slot.PrefillTokens.data() + Slot.PrefillOffset, Slot.PrefillInFlight, Slot.ScheduledNPast);
+            Slot.PrefillOffset += Slot.PrefillInFlight;
+            Slot.ScheduledNPast += Slot.PrefillInFlight;
+            Slot.PrefillInFlight = 0;
+
+            ActiveSlotId = SlotId;
+            if (OnPromptProgress)
+            {
+                OnPromptProgress(Slot.PrefillOffset, Slot.PrefillTokens.size());
+            }
+
+            if (Slot.PrefillOffset >= (int32)Slot.PrefillTokens.size())
+            {
+
+                const int32 NPromptTokens = (int32)Slot.PrefillTokens.size();
+                if (Slot.bStorePrefillInCache)
+                {
+                    StorePrefixInCache(Slot.PrefillTokens, SlotId);
+                    Slot.bStorePrefillInCache = false;
+                }
+                Slot.PrefillTokens.clear();
+                Slot.PrefillOffset = 0;
+
+                const float Duration = (ggml_time_us() - Slot.ScheduledStartTime) / 1000000.0f;
+                if (OnPromptProcessed)
+                {
+                    OnPromptProcessed(NPromptTokens, Slot.CurrentPrompt.Role, NPromptTokens / FMath::Max(Duration, 1e-6f));
+                }
+
+                if (Slot.CurrentPrompt.bGenerateReply)
+                {
+                    Slot.bScheduledGenerating = true;
+                    Slot.StopMatcher.Reset();
+                    if (!Slot.CurrentPrompt.Grammar.empty() || !Slot.CurrentPrompt.JsonSchema.empty())
+                    {
+                        SetSlotGrammar(Slot.CurrentPrompt.Grammar, Slot.CurrentPrompt.JsonSchema, SlotId);
+                    }
+                    if (Slot.CurrentPrompt.bOverrideSampling)
+                    {
+                        SetSlotSampling(&Slot.CurrentPrompt.SamplingOverride, SlotId);
+                    }
+                    Slot.ScheduledNDecoded = 0;
+                    Slot.ScheduledStartTime = ggml_time_us();
+
+                    //Same prefill seeding as Generate()
+                    Slot.ScheduledResponse = Slot.CurrentPrompt.bAddAssistantBoS ? Slot.CurrentPrompt.AssistantPrefill : std::string();
+                    Slot.ReplyTokenStart = Slot.KVTokens.size();
+                    Slot.ReplyPrefill = Slot.ScheduledResponse;
+                    if (!Slot.ScheduledResponse.empty() && OnTokenGenerated)
+                    {
+                        OnTokenGenerated(Slot.ScheduledResponse);
+                    }
+                }
+                else
+                {
+                    Slot.CurrentPrompt = FLlamaScheduledPrompt();
+                    SetSlotLoraOverride(nullptr, SlotId);
+                }
+            }
+        }
+    }
+
+    //Sample the next token for every slot that got logits this step
+    for (int32 SlotId = 0; SlotId < SlotCount; SlotId++)
+    {
+        FLlamaConversationSlot& Slot = Slots[SlotId];
+        if (!Slot.bScheduledGenerating || Slot.BatchLogitIndex < 0)
+        {
+            continue;
+        }
+
+        if (bStopping)
+        {
+            FinishScheduledGeneration(SlotId);
+        }
+        else
+        {
+            SampleScheduledSlot(SlotId);
+        }
+    }
+
+    //Slots that didn't fit in this batch still owe the stop
+    if (bStopping)
+    {
+        for (const FLlamaConversationSlot& Slot : Slots)
+        {
+            if (Slot.bScheduledGenerating)
+            {
+                bStopScheduledRequested = true;
+                break;
+            }
+        }
+    }
+
+    UpdateScheduledWorkState();
+    ActiveSlotId = CallerSlotId;
+
+    //sleep pacing, applies per step so all slots are paced together
+    if (bScheduledWorkActive && LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep > 0.f)
+    {
+        FPlatformProcess::Sleep(LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep);
+    }
+
+    return NTokens;
+}
+
+bool FLlamaInternal::BeginScheduledPrompt(int32 SlotId)
+{
+    ActiveSlotId = SlotId;
+    FLlamaConversationSlot& Slot = ActiveSlot();
+
+    Slot.CurrentPrompt = std::move(Slot.QueuedPrompts.front());
+    Slot.QueuedPrompts.pop_front();
+
+    Slot.PrefillTokens.clear();
+    Slot.PrefillOffset = 0;
+    Slot.PrefillInFlight = 0;
+    Slot.BatchLogitIndex = -1;
+    Slot.ScheduledStartTime = ggml_time_us();
+    Slot.bStorePrefillInCache = false;
+
+    //The prompt's adapters apply to its prefill too, and pick the prefix cache entry
+    SetSlotLoraOverride(Slot.CurrentPrompt.bOverrideLoraAdapters ? &Slot.CurrentPrompt.LoraAdapters : nullptr, SlotId);
+
+    const FLlamaScheduledPrompt& Prompt = Slot.CurrentPrompt;
+    int32 MessageTokenStart = Slot.KVTokens.size();
+    int32 MessageTokens = 0;
+    int32 MessageEndLen = 0;
+    const int32 NewLen = AppendTemplatedPromptToHistory(Prompt.Prompt, Prompt.Role, Prompt.bAddAssistantBoS, Prompt.AssistantPrefill, &MessageEndLen);
+
+    if (NewLen > 0)
+    {
+        const std::string FormattedPrompt(Slot.ContextHistory.data() + Slot.FilledContextCharLength, Slot.ContextHistory.data() + NewLen);
+        int32 NContextUsed = llama_memory_seq_pos_max(llama_get_memory(Context), SlotId);
+
+        TokenizeTemplatedDelta(FormattedPrompt, MessageEndLen - Slot.FilledContextCharLength, Slot.PrefillTokens, MessageTokens);
+
+        const int32 NPromptTokens = Slot.PrefillTokens.size();
+        if (NContextUsed + NPromptTokens > (int32)llama_n_ctx_seq(Context) && NPromptTokens > 0 && ShiftSlotContext(SlotId, NPromptTokens) > 0)
+        {
+            NContextUsed = llama_memory_seq_pos_max(llama_get_memory(Context), SlotId);
+            MessageTokenStart = Slot.KVTokens.size();
+        }
+        Slot.ScheduledNPast = NContextUsed + 1;
+
+        if (Slot.PrefillTokens.empty() && !FormattedPrompt.empty())
+        {
+            EmitErrorMessage(TEXT("failed to tokenize the prompt"), 21, __func__);
+        }
+        else if (NContextUsed + (int32)Slot.PrefillTokens.size() > (int32)llama_n_ctx_seq(Context))
+        {
+            EmitErrorMessage(FString::Printf(
+                TEXT("Failed to insert, tried to insert %d tokens to currently used %d tokens which is more than the max %d context size. Try increasing the context size and re-run prompt."),
+                (int32)Slot.PrefillTokens.size(), NContextUsed, (int32)llama_n_ctx_seq(Context)
+            ), 22, __func__);
+            Slot.PrefillTokens.clear();
+        }
+        else if (Prompt.Role == EChatTemplateRole::System && NContextUsed < 0 && !Prompt.bGenerateReply)
+        {
+            //System prompt into an empty sequence: copy from the prefix cache, or cache it once prefilled
+            if (RestorePrefixFromCache(Slot.PrefillTokens, SlotId))
+            {
+                if (OnPromptProcessed)
+                {
+                    const float Duration = (ggml_time_us() - Slot.ScheduledStartTime) / 1000000.0f;
+                    OnPromptProcessed(Slot.PrefillTokens.size(), Prompt.Role, Slot.PrefillTokens.size() / FMath::Max(Duration, 1e-6f));
+                }
+                Slot.PrefillTokens.clear();
+            }
+            else
+            {
+                Slot.bStorePrefillInCache = true;
+            }
+        }
+
+        //Mirrors InsertTemplatedPrompt, history advances even if the decode gets rejected
+        Slot.FilledContextCharLength = NewLen;
+    }
+
+    //Span is where the tokens will land once prefilled, rollback cancels pending prefill first
+    if (NewLen >= 0 && !Prompt.Prompt.empty())
+    {
+        RecordMessageTokenSpan(MessageTokenStart, MessageTokenStart + MessageTokens);
+    }
+
+    if (Slot.PrefillTokens.empty())
+    {
+        //Sampling needs fresh logits for this sequence, which only a prefill can provide in a shared batch
+        if (Prompt.bGenerateReply && NewLen >= 0)
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("Scheduled prompt on slot %d had no new tokens to decode, skipping reply."), SlotId);
+        }
+        if (Prompt.OnReplyFinished && Prompt.bGenerateReply)
+        {
+            Prompt.OnReplyFinished(std::string());
+        }
+        Slot.CurrentPrompt = FLlamaScheduledPrompt();
+        SetSlotLoraOverride(nullptr, SlotId);
+        return false;
+    }
+    return true;
+}
+
+void FLlamaInternal::SampleScheduledSlot(int32 SlotId)
+{
+    ActiveSlotId = SlotId;
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+
+    const int32 LogitIndex = Slot.BatchLogitIndex;
+    Slot.BatchLogitIndex = -1;
+
+    const llama_token NewTokenId = SampleSlotToken(Slot, LogitIndex);
+
+    if (llama_vocab_is_eog(Vocab, NewTokenId))
+    {
+        FinishScheduledGeneration(SlotId);
+        return;
+    }
+
+    const std::string_view Piece = PieceTable.Get(NewTokenId);
+    Slot.ScheduledNDecoded++;
+
+    const int32 NContext = llama_n_ctx_seq(Context);
+    if (Slot.ScheduledNPast + 1 > NContext)
+    {
+        const int32 NDiscarded = ShiftSlotContext(SlotId, 1);
+        if (NDiscarded <= 0)
+        {
+            EmitErrorMessage(FString::Printf(TEXT("Context size %d exceeded on generation. Try increasing the context size and re-run prompt"), NContext), 31, __func__);
+            FinishScheduledGeneration(SlotId, false);
+            return;
+        }
+        Slot.ScheduledNPast -= NDiscarded;
+    }
+
+    const bool bStopMatched = Slot.StopMatcher.Feed(Piece, Slot.ScheduledNPast);
+    const std::string& Emitted = Slot.StopMatcher.GetEmitted();
+    Slot.ScheduledResponse += Emitted;
+
+    if (OnTokenGenerated && !Emitted.empty())
+    {
+        OnTokenGenerated(Emitted);
+    }
+
+    if (bStopMatched)
+    {
+        //Tokens holding only stop sequence bytes are cut back out of KV. One whose text was partly
+        //released is part of the reply, land it before finishing.
+        const int32 KeepTag = Slot.StopMatcher.GetKeepTag();
+        if (KeepTag > Slot.ScheduledNPast)
+        {
+            if (DecodeTokensForSeq(&NewTokenId, 1, Slot.ScheduledNPast, SlotId) == 0)
+            {
+                Slot.ScheduledNPast++;
+            }
+        }
+        else
+        {
+            TruncateSlotKV(SlotId, KeepTag);
+            Slot.ScheduledNPast = KeepTag;
+        }
+        Slot.StopMatcher.Reset();
+        FinishScheduledGeneration(SlotId);
+        return;
+    }
+
+    //Decoded with the next step's batch
+    Slot.PendingToken = NewTokenId;
+}
+
+void FLlamaInternal::FinishScheduledGeneration(int32 SlotId, bool bCommitResponse)
+{
+    ActiveSlotId = SlotId;
+    FLlamaConversationSlot& Slot = ActiveSlot();
+
+    Slot.bScheduledGenerating = false;
+    Slot.BatchLogitIndex = -1;
+    Slot.PendingToken = LLAMA_TOKEN_NULL;
+
+    //Release text held back for a stop sequence that never completed
+    const std::string& Tail = Slot.StopMatcher.Flush();
+    if (!Tail.empty())
+    {
+        Slot.ScheduledResponse += Tail;
+        if (bCommitResponse && OnTokenGenerated)
+        {
+            OnTokenGenerated(Tail);
+        }
+    }
+
+    //Grammar and sampling overrides only applied to this reply
+    if (Slot.GrammarSampler)
+    {
+        llama_sampler_free(Slot.GrammarSampler);
+        Slot.GrammarSampler = nullptr;
+    }
+    SetSlotSampling(nullptr, SlotId);
+    SetSlotLoraOverride(nullptr, SlotId);
+
+    //Move out first, callbacks may queue a follow-up prompt on this slot
+    FLlamaScheduledPrompt Prompt = std::move(Slot.CurrentPrompt);
+    Slot.CurrentPrompt = FLlamaScheduledPrompt();
+    std::string Response;
+    Response.swap(Slot.ScheduledResponse);
+
+    std::string EmittedResponse = Response;
+    if (bCommitResponse)
+    {
+        const float Duration = (ggml_time_us() - Slot.ScheduledStartTime) / 1000000.0f;
+        const int32 NDecoded = Slot.ScheduledNDecoded;
+
+        EmittedResponse = CommitResponse(Response, true);
+
+        LastRunTimings = FLlamaRunTimings();
+        LastRunTimings.TotalTime = Duration;
+        LastRunTimings.TokensPerSecond = NDecoded / FMath::Max(Duration, 1e-6f);
+
+        if (OnGenerationComplete)
+        {
+            OnGenerationComplete(EmittedResponse, Duration, NDecoded, NDecoded / FMath::Max(Duration, 1e-6f));
+        }
+    }
+
+    if (Prompt.OnReplyFinished)
+    {
+        Prompt.OnReplyFinished(EmittedResponse);
+    }
+}
+
+void FLlamaInternal::DrainScheduledSlot(int32 SlotId)
+{
+    while (IsValidSlot(SlotId) && Slots[SlotId].IsScheduled())
+    {
+        //No decode and still busy means nothing can advance it, stop instead of spinning
+        if (StepScheduledSlots() == 0 && Slots[SlotId].IsScheduled())
+        {
+            CancelScheduledSlot(SlotId);
+            break;
+        }
+    }
+    ActiveSlotId = SlotId;
+
+    //Steps ran other slots' adapter sets, the caller decodes with this slot's
+    if (IsValidSlot(SlotId))
+    {
+        ApplyLoraScales(Slots[SlotId].ActiveLoraScales());
+    }
+}
+
+void FLlamaInternal::CancelScheduledSlot(int32 SlotId)
+{
+    if (!IsValidSlot(SlotId))
+    {
+        return;
+    }
+
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    Slot.QueuedPrompts.clear();
+
+    if (!Slot.IsScheduled())
+    {
+        return;
+    }
+
+    //The templated history already includes this prompt, so finish its prefill to keep KV in step
+    ApplyLoraScales(Slot.ActiveLoraScales());
+    const int32 Remaining = (int32)Slot.PrefillTokens.size() - Slot.PrefillOffset;
+    if (Remaining > 0)
+    {
+        if (DecodeTokensForSeq(Slot.PrefillTokens.data() + Slot.PrefillOffset, Remaining, Slot.ScheduledNPast, SlotId))
+        {
+            EmitErrorMessage(TEXT("Failed to decode, could not find a KV slot for the batch (try reducing the size of the batch or increase the context)."), 23, __func__);
+        }
+        Slot.PrefillTokens.clear();
+        Slot.PrefillOffset = 0;
+        Slot.CurrentPrompt = FLlamaScheduledPrompt();
+        SetSlotLoraOverride(nullptr, SlotId);
+    }
+
+    if (Slot.bScheduledGenerating)
+    {
+        //Last emitted token is part of the response, land it before committing
+        if (Slot.PendingToken != LLAMA_TOKEN_NULL)
+        {
+            DecodeTokensForSeq(&Slot.PendingToken, 1, Slot.ScheduledNPast, SlotId);
+            Slot.ScheduledNPast++;
+        }
+        FinishScheduledGeneration(SlotId);
+    }
+
+    ActiveSlotId = SlotId;
+    UpdateScheduledWorkState();
+}
+
+void FLlamaInternal::UpdateScheduledWorkState()
+{
+    bool bAnyScheduled = false;
+    for (const FLlamaConversationSlot& Slot : Slots)
+    {
+        if (Slot.IsScheduled())
+        {
+            bAnyScheduled = true;
+            break;
+        }
+    }
+    bScheduledWorkActive = bAnyScheduled;
+}
+
+void FLlamaInternal::GetPromptEmbeddings(const std::string& Text, std::vector<float>& Embeddings)
+{
+    std::vector<std::vector<float>> Batched;
+    GetPromptEmbeddingsBatch({ Text }, Batched);
+    Embeddings = Batched.empty() ? std::vector<float>() : std::move(Batched[0]);
+}
+
+void FLlamaInternal::GetPromptEmbeddingsBatch(const std::vector<std::string>& Texts, std::vector<std::vector<float>>& OutEmbeddings,
+    TFunction<void(int32 Index, const std::vector<float>& Embedding)> OnEmbedding)
+{
+    //apply https://github.com/ggml-org/llama.cpp/blob/master/examples/embedding/embedding.cpp wrapping logic
+    OutEmbeddings.clear();
+    OutEmbeddings.resize(Texts.size());
+
+    if (!Context)
+    {
+        EmitErrorMessage(TEXT("Context invalid, did you load the model?"), 43, __func__);
+        return;
+    }
+
+    // SafeTokenize replaces `common_tokenize` to keep the result vector's
+    // backing storage on our side of the static-lib boundary. See helper
+    // definition at the top of this file for the cross-allocator background.
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+    const int32 NEmbd = llama_model_n_embd(LlamaModel);
+    const int32 NSeqMax = llama_n_seq_max(Context);
+    const enum llama_pooling_type PoolingType = llama_pooling_type(Context);
+    const bool bTokenRows = PoolingType == LLAMA_POOLING_TYPE_NONE;
+
+    //Cache keys per text, only texts that are decoded whole are stored
+    FLlamaEmbeddingCache& Cache = FLlamaEmbeddingCache::Get();
+    const bool bCached = EmbeddingCacheModelKey != 0;
+    std::vector<FLlamaEmbeddingCacheKey> CacheKeys(bCached ? Texts.size() : 0);
+    std::vector<bool> Cacheable(bCached ? Texts.size() : 0, false);
+
+    //Texts in the batch being packed, one sequence each, and where each one's tokens start
+    std::vector<int32> BatchTexts;
+    std::vector<int32> SeqTokenStarts;
+    std::vector<float> Raw;
+    SeqBatch.n_tokens = 0;
+
+    auto DecodePacked = [&]()
+    {
+        if (BatchTexts.empty())
+        {
+            return;
+        }
+
+        const int32 NSeq = BatchTexts.size();
+        const int32 NRows = bTokenRows ? SeqBatch.n_tokens : NSeq;
+        Raw.assign((size_t)NRows * NEmbd, 0.f);
+        const bool bDecoded = BatchDecodeEmbedding(Context, SeqBatch, Raw.data(), NSeq, NEmbd, 2, NRows);
+
+        for (int32 Seq = 0; Seq < NSeq; Seq++)
+        {
+            std::vector<float>& Embeddings = OutEmbeddings[BatchTexts[Seq]];
+            if (bDecoded)
+            {
+                //Always return a single pooled vector. For NONE pooling, mean-pool the sequence's token rows.
+                if (bTokenRows)
+                {
+                    const int32 Start = SeqTokenStarts[Seq];
+                    const int32 End = Seq + 1 < NSeq ? SeqTokenStarts[Seq + 1] : SeqBatch.n_tokens;
+                    MeanPoolRows(Raw.data() + (size_t)Start * NEmbd, End - Start, NEmbd, Embeddings);
+                }
+                else
+                {
+                    Embeddings.assign(Raw.data() + (size_t)Seq * NEmbd, Raw.data() + (size_t)(Seq + 1) * NEmbd);
+                }
+                if (bCached && Cacheable[BatchTexts[Seq]])
+                {
+                    Cache.Add(CacheKeys[BatchTexts[Seq]], Embeddings);
+                }
+            }
+            if (OnEmbedding)
+            {
+                OnEmbedding(BatchTexts[Seq], Embeddings);
+            }
+        }
+
+        UE_LOG(LlamaLog, Verbose, TEXT("FLlamaInternal::GetPromptEmbeddingsBatch: %d texts in one decode (pooling=%d, tokens=%d)"),
+            NSeq, static_cast<int32>(PoolingType), SeqBatch.n_tokens);
+
+        SeqBatch.n_tokens = 0;
+        BatchTexts.clear();
+        SeqTokenStarts.clear();
+    };
+
+    //Tokenize everything up front so texts can be scheduled by length, cache hits skip tokenizing and decoding
+    std::vector<std::vector<llama_token>> Inputs(Texts.size());
+    std::vector<int32> Order;
+    Order.reserve(Texts.size());
+    int32 CacheHits = 0;
+    for (int32 i = 0; i < (int32)Texts.size(); i++)
+    {
+        if (bCached)
+        {
+            CacheKeys[i] = FLlamaEmbeddingCache::MakeKey(EmbeddingCacheModelKey, Texts[i]);
+            if (Cache.Find(CacheKeys[i], OutEmbeddings[i]) && (int32)OutEmbeddings[i].size() == NEmbd)
+            {
+                CacheHits++;
+                if (OnEmbedding)
+                {
+                    OnEmbedding(i, OutEmbeddings[i]);
+                }
+                continue;
+            }
+            OutEmbeddings[i].clear();
+            Cacheable[i] = true;
+        }
+
+        Inputs[i] = SafeTokenize(Vocab, Texts[i], /*add_special*/ true, /*parse_special*/ true);
+        if (Inputs[i].empty())
+        {
+            UE_LOG(LlamaLog, Error, TEXT("GetPromptEmbeddings: tokenize produced 0 tokens (text bytes=%d)"),
+                (int32)Texts[i].size());
+            if (OnEmbedding)
+            {
+                OnEmbedding(i, OutEmbeddings[i]);
+            }
+            continue;
+        }
+        if ((int32)Inputs[i].size() > SeqBatchCapacity)
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("GetPromptEmbeddings: text of %d tokens truncated to MaxBatchLength %d"),
+                (int32)Inputs[i].size(), SeqBatchCapacity);
+            Inputs[i].resize(SeqBatchCapacity);
+
+            //The vector depends on MaxBatchLength now, keep it out of the cache
+            if (bCached)
+            {
+                Cacheable[i] = false;
+            }
+        }
+        Order.push_back(i);
+    }
+
+    //Decode order: by power of two length bucket, then length. Order maps back to the input index.
+    const bool bBucketed = LastLoadedParams.Advanced.bBucketEmbeddingsByLength;
+    auto BucketOf = [&Inputs](int32 Index)
+    {
+        return (int32)FMath::CeilLogTwo((uint32)Inputs[Index].size());
+    };
+    if (bBucketed)
+    {
+        std::stable_sort(Order.begin(), Order.end(), [&Inputs](int32 A, int32 B)
+        {
+            return Inputs[A].size() < Inputs[B].size();
+        });
+    }
+
+    //Pack texts until n_batch tokens, n_seq_max sequences or the end of their bucket, then decode them together
+    int32 PackedBucket = -1;
+    for (const int32 i : Order)
+    {
+        const std::vector<llama_token>& Input = Inputs[i];
+        const int32 Bucket = bBucketed ? BucketOf(i) : 0;
+
+        if (SeqBatch.n_tokens + (int32)Input.size() > SeqBatchCapacity || (int32)BatchTexts.size() >= NSeqMax || Bucket != PackedBucket)
+        {
+            DecodePacked();
+            PackedBucket = Bucket;
+        }
+
+        SeqTokenStarts.push_back(SeqBatch.n_tokens);
+        BatchAddSeq(SeqBatch, Input, BatchTexts.size());
+        BatchTexts.push_back(i);
+    }
+    DecodePacked();
+
+    if (bCached)
+    {
+        Cache.Flush();
+        if (CacheHits > 0)
+        {
+            UE_LOG(LlamaLog, Verbose, TEXT("FLlamaInternal::GetPromptEmbeddingsBatch: %d of %d texts from the embedding cache"),
+                CacheHits, (int32)Texts.size());
+        }
+    }
+}
+
+int32 FLlamaInternal::GetEmbeddingDimension() const
+{
+    return LlamaModel ? llama_model_n_embd(LlamaModel) : 0;
+}
+
+int32 FLlamaInternal::ProcessPrompt(const std::string& Prompt, EChatTemplateRole Role)
+{
+    //Grab vocab
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+    const bool IsFirst = llama_memory_seq_pos_max(llama_get_memory(Context), ActiveSlotId) == 0;
+
+    // tokenize the prompt
+    const std::vector<llama_token> PromptTokens = SafeTokenize(Vocab, Prompt, IsFirst, true);
+    if (PromptTokens.empty() && !Prompt.empty())
+    {
+        EmitErrorMessage(TEXT("failed to tokenize the prompt"), 21, __func__);
+        return 0;
+    }
+
+    return ProcessPromptTokens(PromptTokens, Role);
+}
+
+int32 FLlamaInternal::ProcessPromptTokens(const std::vector<llama_token>& PromptTokens, EChatTemplateRole Role)
+{
+    const auto StartTime = ggml_time_us();
+
+    const llama_seq_id SeqId = ActiveSlotId;
+    const int32 NPromptTokens = PromptTokens.size();
+    bPrefillCancelled = false;
+
+    //check sizing before running prompt decode
+    const int32 NContext = llama_n_ctx_seq(Context);
+    int32 NContextUsed = llama_memory_seq_pos_max(llama_get_memory(Context), SeqId);
+
+    if (NContextUsed + NPromptTokens > NContext && ShiftSlotContext(SeqId, NPromptTokens) > 0)
+    {
+        NContextUsed = llama_memory_seq_pos_max(llama_get_memory(Context), SeqId);
+    }
+
+    if (NContextUsed + NPromptTokens > NContext)
+    {
+        EmitErrorMessage(FString::Printf(
+            TEXT("Failed to insert, tried to insert %d tokens to currently used %d tokens which is more than the max %d context size. Try increasing the context size and re-run prompt."),
+            NPromptTokens, NContextUsed, NContext
+        ), 22, __func__);
+        return 0;
+    }
+
+    //n_batch sized chunks so progress can be reported and StopGeneration lands between them.
+    //Pacing splits the prompt further into PromptProcessingPacingSplitN pieces with a sleep after each.
+    const FLLMOutputParams& Output = LastLoadedParams.Advanced.Output;
+    const bool bPacing = Output.PromptProcessingPacingSleep > 0.f;
+    int32 ChunkSize = SeqBatchCapacity;
+    if (bPacing)
+    {
+        const int32 SplitN = FMath::Max(Output.PromptProcessingPacingSplitN, 1);
+        ChunkSize = FMath::Clamp((NPromptTokens + SplitN - 1) / SplitN, 1, SeqBatchCapacity);
+    }
+
+    //A prompt prefilled ahead of Generate keeps its stop request, otherwise the flag only covers the prefill
+    const bool bWasGenerationActive = bGenerationActive;
+    bGenerationActive = true;
+
+    const llama_pos StartPos = NContextUsed + 1;
+    int32 NDone = 0;
+    while (NDone < NPromptTokens)
+    {
+        const int32 NChunk = FMath::Min(ChunkSize, NPromptTokens - NDone);
+        if (DecodeTokensForSeq(PromptTokens.data() + NDone, NChunk, StartPos + NDone, SeqId))
+        {
+            EmitErrorMessage(TEXT("Failed to decode, could not find a KV slot for the batch (try reducing the size of the batch or increase the context)."), 23, __func__);
+            bGenerationActive = bWasGenerationActive;
+
+            //Same as a cancel: drop the chunks that did land, callers take the message back out of history
+            TruncateSlotKV(SeqId, StartPos);
+            bPrefillCancelled = true;
+            return 0;
+        }
+        NDone += NChunk;
+
+        if (OnPromptProgress)
+        {
+            OnPromptProgress(NDone, NPromptTokens);
+        }
+
+        if (NDone < NPromptTokens)
+        {
+            if (bPacing)
+            {
+                FPlatformProcess::Sleep(Output.PromptProcessingPacingSleep);
+            }
+
+            //Cancelled: drop the partial prompt so KV ends where it did before this call
+            if (!bGenerationActive)
+            {
+                TruncateSlotKV(SeqId, StartPos);
+                bPrefillCancelled = true;
+                UE_LOG(LlamaLog, Log, TEXT("Prompt prefill cancelled on slot %d after %d/%d tokens."), SeqId, NDone, NPromptTokens);
+                return 0;
+            }
+        }
+    }
+    bGenerationActive = bWasGenerationActive;
+
+    const auto StopTime = ggml_time_us();
+    const float Duration = (StopTime - StartTime) / 1000000.0f;
+
+    if (OnPromptProcessed)
+    {
+        float Speed = NPromptTokens / Duration;
+        OnPromptProcessed(NPromptTokens, Role, Speed);
+    }
+
+    return NPromptTokens;
+}
+
+std::string FLlamaInternal::Generate(const std::string& Prompt, bool bAppendToMessageHistory, const std::string& AssistantPrefill)
+{
+    const auto StartTime = ggml_time_us();
+
+    bGenerationActive = true;
+
+    if (!Prompt.empty())
+    {
+        int32 TokensProcessed = ProcessPrompt(Prompt);
+    }
+
+    //Seed response accumulator with prefill so it shows up in the final response and in the
+    //assistant message history. The prefill bytes are assumed to already be in the KV cache
+    //(InsertTemplatedPrompt injects them into the prompt-eval batch). We also emit through
+    //OnTokenGenerated as a single piece so subscribers see one continuous stream.
+    //The accumulator is reused, so appending tokens doesn't allocate once it has grown.
+    std::string& Response = ResponseBuffer;
+    Response.assign(AssistantPrefill);
+    if (!AssistantPrefill.empty() && OnTokenGenerated)
+    {
+        OnTokenGenerated(AssistantPrefill);
+    }
+
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+
+    llama_token NewTokenId;
+    int32 NDecoded = 0;
+
+    // check if we have enough space in the context to evaluate this batch - might need to be inside loop
+    int NContext = llama_n_ctx_seq(Context);
+    bool bEOGExit = false;
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    const llama_seq_id SeqId = ActiveSlotId;
+
+    // For M-RoPE models (e.g. Qwen2VL), seq_pos_max reflects the max 2D spatial position of
+    // image tokens and is NOT the correct next text position. Use NextGenerationNPast when it has
+    // been set by ProcessMultimodalPrompt; otherwise fall back to seq_pos_max+1 (text-only path).
+    llama_pos SeqPosMaxAtGenStart = llama_memory_seq_pos_max(llama_get_memory(Context), SeqId);
+    llama_pos NPast = (Slot.NextGenerationNPast > 0)
+        ? Slot.NextGenerationNPast
+        : SeqPosMaxAtGenStart + 1;
+    Slot.NextGenerationNPast = 0; // consumed
+
+    //Reply tokens start here in the mirror, prefill bytes belong to the prompt
+    Slot.ReplyTokenStart = Slot.KVTokens.size();
+    Slot.ReplyPrefill = AssistantPrefill;
+
+    UE_LOG(LlamaLog, Log, TEXT("[Generate] slot=%d NPast=%d seq_pos_max=%d (from_mtmd=%s)"),
+        (int32)SeqId, (int32)NPast, (int32)SeqPosMaxAtGenStart,
+        (NPast != SeqPosMaxAtGenStart + 1) ? TEXT("yes") : TEXT("no"));
+
+    //Speculation needs the draft to see exactly what the main sequence holds. Grammar forced tokens don't,
+    //and have their own bound since they are always accepted.
+    const FLLMSpeculativeParams& SpecParams = LastLoadedParams.Advanced.Speculative;
+    const bool bCanSpeculate = (DraftContext || SpecParams.bPromptLookup) && Slot.bKVTokensValid && NPast == (llama_pos)Slot.KVTokens.size();
+    const int32 MaxDraft = bCanSpeculate ? FMath::Clamp(SpecParams.DraftTokens, 0, SeqBatchCapacity - 1) : 0;
+    const int32 MaxForced = Slot.GrammarSampler ? FMath::Min(MaxForcedTokens, SeqBatchCapacity - 1) : 0;
+    std::vector<llama_token> Draft;
+    int32 NDraftProposed = 0;
+    int32 NDraftAccepted = 0;
+
+    //Stop sequences hold back the ambiguous tail, only released text reaches Response/OnTokenGenerated
+    FLlamaStopSequenceMatcher& StopMatcher = Slot.StopMatcher;
+    StopMatcher.Reset();
+    bool bStopMatched = false;
+
+    //Common sampler is a bit faster
+    NewTokenId = SampleSlotToken(Slot, -1);
+    UE_LOG(LlamaLog, Verbose, TEXT("[Generate] first token id=%d"), (int32)NewTokenId);
+
+    //Nothing below allocates per token: pieces are table views, the stop matcher, response and batch reuse their buffers
+    while (bGenerationActive) //processing can be aborted by flipping the boolean
+    {
+        // is it an end of generation?
+        if (llama_vocab_is_eog(Vocab, NewTokenId))
+        {
+            bEOGExit = true;
+            break;
+        }
+
+        // look up the token's text, a view into the piece table built at load
+        const std::string_view Piece = PieceTable.Get(NewTokenId);
+
+        NDecoded += 1;
+
+        if (NPast + 1 > NContext)
+        {
+            const int32 NDiscarded = ShiftSlotContext(SeqId, 1);
+            if (NDiscarded > 0)
+            {
+                NPast -= NDiscarded;
+            }
+            else
+            {
+                FString ErrorMessage = FString::Printf(TEXT("Context size %d exceeded on generation. Try increasing the context size and re-run prompt"), NContext);
+
+                EmitErrorMessage(ErrorMessage, 31, __func__);
+
+                //End like a normal stop, this token was never decoded and the partial reply is committed
+                bGenerationActive = false;
+                break;
+            }
+        }
+
+        //A completed stop sequence ends the reply before this token is decoded
+        bStopMatched = StopMatcher.Feed(Piece, NPast);
+        const std::string& Emitted = StopMatcher.GetEmitted();
+        Response += Emitted;
+
+        if (OnTokenGenerated && !Emitted.empty())
+        {
+            OnTokenGenerated(Emitted);
+        }
+        if (bStopMatched)
+        {
+            break;
+        }
+
+        //Draft a continuation of this token, the main model verifies it in the same decode
+        Draft.clear();
+        const int32 ContextRoom = NContext - (int32)NPast - 1;
+        if (MaxForced > 0)
+        {
+            ProposeForcedTokens(FMath::Min(MaxForced, ContextRoom), Draft);
+        }
+        if (Draft.empty() && MaxDraft > 0)
+        {
+            const int32 DraftRoom = FMath::Min(MaxDraft, ContextRoom);
+            if (SpecParams.bPromptLookup)
+            {
+                ProposeLookupTokens(NewTokenId, DraftRoom, Draft);
+            }
+            if (Draft.empty() && DraftContext)
+            {
+                ProposeDraftTokens(NewTokenId, DraftRoom, Draft);
+            }
+        }
+
+        // Use explicit n_past position (mirrors mtmd-cli reference implementation).
+        // This is critical for M-RoPE models where seq_pos_max != true next text position.
+        SeqBatch.n_tokens = 0;
+        BatchAddToken(SeqBatch, NewTokenId, NPast, SeqId, true);
+        for (int32 i = 0; i < (int32)Draft.size(); i++)
+        {
+            BatchAddToken(SeqBatch, Draft[i], NPast + 1 + i, SeqId, true);
+        }
+
+        if (llama_decode(Context, SeqBatch))
+        {
+            bGenerationActive = false;
+            FString ErrorMessage = TEXT("Failed to decode. Could not find a KV slot for the batch (try reducing the size of the batch or increase the context)");
+            EmitErrorMessage(ErrorMessage, 32, __func__);
+            //Return partial response
+            return Response;
+        }
+
+        AppendToTokenMirror(SeqId, &NewTokenId, 1, NPast);
+        NPast++;
+
+        //The main model samples every drafted position, drafts are kept for as long as they agree.
+        //Each sample is conditioned on the accepted prefix only, so output matches normal decoding.
+        int32 Accepted = 0;
+        NewTokenId = SampleSlotToken(Slot, 0);
+        while (Accepted < (int32)Draft.size() && NewTokenId == Draft[Accepted] &&
+            !llama_vocab_is_eog(Vocab, NewTokenId) && bGenerationActive)
+        {
+            NDecoded += 1;
+
+            bStopMatched = StopMatcher.Feed(PieceTable.Get(NewTokenId), NPast);
+            const std::string& DraftEmitted = StopMatcher.GetEmitted();
+            Response += DraftEmitted;
+
+            if (OnTokenGenerated && !DraftEmitted.empty())
+            {
+                OnTokenGenerated(DraftEmitted);
+            }
+
+            AppendToTokenMirror(SeqId, &NewTokenId, 1, NPast);
+            NPast++;
+            Accepted++;
+            if (bStopMatched)
+            {
+                break;
+            }
+            NewTokenId = SampleSlotToken(Slot, Accepted);
+        }
+
+        //Rejected drafts leave KV, the mismatching sample carries over as the next token
+        if (Accepted < (int32)Draft.size())
+        {
+            llama_memory_seq_rm(llama_get_memory(Context), SeqId, NPast, -1);
+        }
+        NDraftProposed += Draft.size();
+        NDraftAccepted += Accepted;
+
+        if (bStopMatched)
+        {
+            break;
+        }
+
+        //sleep pacing
+        if (LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep > 0.f)
+        {
+            FPlatformProcess::Sleep(LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep);
+        }
+    }
+
+    bGenerationActive = false;
+
+    if (bStopMatched)
+    {
+        //Cut tokens holding only stop sequence bytes back out of KV so history and cache agree. The
+        //matched token is still undecoded when its text was partly released, it lands with the reply.
+        const int32 KeepTag = StopMatcher.GetKeepTag();
+        if (KeepTag > NPast)
+        {
+            DecodeTokensForSeq(&NewTokenId, 1, NPast, SeqId);
+        }
+        else
+        {
+            TruncateSlotKV(SeqId, KeepTag);
+        }
+    }
+    else
+    {
+        //No stop sequence followed, release the held back tail
+        const std::string& Tail = StopMatcher.Flush();
+        Response += Tail;
+        if (OnTokenGenerated && !Tail.empty())
+        {
+            OnTokenGenerated(Tail);
+        }
+    }
+
+    const auto StopTime = ggml_time_us();
+    const float Duration = (StopTime - StartTime) / 1000000.0f;
+
+    std::string EmittedResponse = CommitResponse(Response, bAppendToMessageHistory);
+
+    LastRunTimings = FLlamaRunTimings();
+    LastRunTimings.TotalTime = Duration;
+    LastRunTimings.TokensPerSecond = NDecoded / Duration;
+    LastRunTimings.DraftTokensProposed = NDraftProposed;
+    LastRunTimings.DraftTokensAccepted = NDraftAccepted;
+    LastRunTimings.DraftAcceptanceRate = NDraftProposed > 0 ? (float)NDraftAccepted / NDraftProposed : 0.f;
+
+    if (OnGenerationComplete)
+    {
+        OnGenerationComplete(EmittedResponse, Duration, NDecoded, NDecoded / Duration);
+    }
+
+    return EmittedResponse;
+}
+
+llama_token FLlamaInternal::SampleSlotToken(FLlamaConversationSlot& Slot, int32 LogitIndex)
+{
+    if (Slot.GrammarSampler)
+    {
+        return SampleConstrainedSlotToken(Slot, LogitIndex);
+    }
+
+    //Common sampler is a bit faster
+    if (Slot.CommonSampler)
+    {
+        const llama_token Token = common_sampler_sample(Slot.CommonSampler, Context, LogitIndex); //sample using common sampler
+        common_sampler_accept(Slot.CommonSampler, Token, true);
+        return Token;
+    }
+    return llama_sampler_sample(Slot.Sampler, Context, LogitIndex);
+}
+
+// ---- Sampling overrides -----------------------------------------------------
+
+namespace
+{
+    static uint32 HashSamplingParams(const FLLMSamplingParams& Params)
+    {
+        uint32 Hash = GetTypeHash(Params.Temp);
+        Hash = HashCombine(Hash, GetTypeHash(Params.MinP));
+        Hash = HashCombine(Hash, GetTypeHash(Params.TopK));
+        Hash = HashCombine(Hash, GetTypeHash(Params.TopP));
+        Hash = HashCombine(Hash, GetTypeHash(Params.TypicalP));
+        Hash = HashCombine(Hash, GetTypeHash(Params.PenaltyLastN));
+        Hash = HashCombine(Hash, GetTypeHash(Params.PenaltyRepeat));
+        Hash = HashCombine(Hash, GetTypeHash(Params.PenaltyFrequency));
+        Hash = HashCombine(Hash, GetTypeHash(Params.PenaltyPresence));
+        Hash = HashCombine(Hash, GetTypeHash(Params.Mirostat));
+        Hash = HashCombine(Hash, GetTypeHash(Params.MirostatTau));
+        Hash = HashCombine(Hash, GetTypeHash(Params.MirostatEta));
+        Hash = HashCombine(Hash, GetTypeHash(Params.bUseCommonSampler));
+
+        //0 is reserved for the load-time set
+        return Hash == 0 ? 1 : Hash;
+    }
+
+    static bool SamplingParamsEqual(const FLLMSamplingParams& A, const FLLMSamplingParams& B)
+    {
+        return A.Temp == B.Temp &&
+            A.MinP == B.MinP &&
+            A.TopK == B.TopK &&
+            A.TopP == B.TopP &&
+            A.TypicalP == B.TypicalP &&
+            A.PenaltyLastN == B.PenaltyLastN &&
+            A.PenaltyRepeat == B.PenaltyRepeat &&
+            A.PenaltyFrequency == B.PenaltyFrequency &&
+            A.PenaltyPresence == B.PenaltyPresence &&
+            A.Mirostat == B.Mirostat &&
+            A.MirostatTau == B.MirostatTau &&
+            A.MirostatEta == B.MirostatEta &&
+            A.bUseCommonSampler == B.bUseCommonSampler;
+    }
+}
+
+void FLlamaInternal::SetSlotSampling(const FLLMSamplingParams* Override, int32 SlotId)
+{
+    if (!IsValidSlot(SlotId))
+    {
+        return;
+    }
+
+    //An override equal to the load-time params is the load-time set
+    if (Override && SamplingParamsEqual(*Override, LastLoadedParams.Advanced.Sampling))
+    {
+        Override = nullptr;
+    }
+
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    const uint32 Hash = Override ? HashSamplingParams(*Override) : 0;
+
+    //Hash is only a pre-check, a match must also have the same params
+    auto Matches = [Hash, Override](uint32 SetHash, const FLLMSamplingParams& SetParams)
+    {
+        return SetHash == Hash && (!Override || SamplingParamsEqual(SetParams, *Override));
+    };
+    if (Matches(Slot.ActiveSamplingHash, Slot.ActiveSampling))
+    {
+        return;
+    }
+
+    //Park the active set, then take the wanted one out of the pool or build it
+    Slot.SamplerPool.push_back({ Slot.ActiveSamplingHash, Slot.ActiveSampling, Slot.Sampler, Slot.CommonSampler, ++SamplerPoolClock });
+    Slot.Sampler = nullptr;
+    Slot.CommonSampler = nullptr;
+
+    for (int32 i = 0; i < (int32)Slot.SamplerPool.size(); i++)
+    {
+        if (Matches(Slot.SamplerPool[i].ParamsHash, Slot.SamplerPool[i].Params))
+        {
+            Slot.Sampler = Slot.SamplerPool[i].Sampler;
+            Slot.CommonSampler = Slot.SamplerPool[i].CommonSampler;
+            Slot.SamplerPool.erase(Slot.SamplerPool.begin() + i);
+            break;
+        }
+    }
+    if (!Slot.Sampler && !Slot.CommonSampler && Override)
+    {
+        BuildSamplers(*Override, LastLoadedParams.Seed, Slot.Sampler, Slot.CommonSampler);
+    }
+    Slot.ActiveSamplingHash = Hash;
+    Slot.ActiveSampling = Override ? *Override : LastLoadedParams.Advanced.Sampling;
+
+    //Evict the least recently used override beyond the cap
+    if ((int32)Slot.SamplerPool.size() > MaxPooledSamplerSets)
+    {
+        int32 Oldest = -1;
+        for (int32 i = 0; i < (int32)Slot.SamplerPool.size(); i++)
+        {
+            if (Slot.SamplerPool[i].ParamsHash != 0 && (Oldest < 0 || Slot.SamplerPool[i].LastUsed < Slot.SamplerPool[Oldest].LastUsed))
+            {
+                Oldest = i;
+            }
+        }
+        if (Oldest >= 0)
+        {
+            FLlamaSamplerSet& Set = Slot.SamplerPool[Oldest];
+            if (Set.Sampler)
+            {
+                llama_sampler_free(Set.Sampler);
+            }
+            if (Set.CommonSampler)
+            {
+                common_sampler_free(Set.CommonSampler);
+            }
+            Slot.SamplerPool.erase(Slot.SamplerPool.begin() + Oldest);
+        }
+    }
+
+    //Fresh and pooled override sets have no or a stale view of the replies, bring penalties up to date.
+    //The load-time set keeps its own state, it saw every reply sampled without an override.
+    if (Override)
+    {
+        ReplaySamplerHistory(Slot, Override->PenaltyLastN);
+    }
+}
+
+// ---- LoRA adapters ------------------------------------------------------------
+
+void FLlamaInternal::LoadLoraAdapters(const TArray<FLlamaLoraAdapter>& Adapters)
+{
+    FreeLoraAdapters();
+
+    for (const FLlamaLoraAdapter& Adapter : Adapters)
+    {
+        const FString FullPath = FLlamaPaths::ParsePathIntoFullPath(Adapter.Path);
+        llama_adapter_lora* Lora = FLlamaModelRegistry::Get().AcquireLora(LlamaModel, TCHAR_TO_UTF8(*FullPath));
+        if (!Lora)
+        {
+            EmitErrorMessage(FString::Printf(TEXT("Unable to load LoRA adapter at <%s>, continuing without it."), *FullPath), 13, __func__);
+            continue;
+        }
+
+        const FString Name = Adapter.Name.IsEmpty() ? FPaths::GetBaseFilename(FullPath) : Adapter.Name;
+        LoraAdapters.push_back(Lora);
+        LoraAdapterNames.push_back(FLlamaString::ToStd(Name));
+        DefaultLoraScales.push_back(Adapter.Scale);
+        UE_LOG(LlamaLog, Log, TEXT("Loaded LoRA adapter %s (scale %.2f)"), *Name, Adapter.Scale);
+    }
+
+    //Context starts without adapters
+    AppliedLoraScales.assign(LoraAdapters.size(), 0.f);
+    ApplyLoraScales(DefaultLoraScales);
+}
+
+void FLlamaInternal::FreeLoraAdapters()
+{
+    for (llama_adapter_lora* Lora : LoraAdapters)
+    {
+        FLlamaModelRegistry::Get().ReleaseLora(LlamaModel, Lora);
+    }
+    LoraAdapters.clear();
+    LoraAdapterNames.clear();
+    DefaultLoraScales.clear();
+    AppliedLoraScales.clear();
+}
+
+void FLlamaInternal::ResolveLoraScales(const TArray<FLlamaLoraAdapterScale>& Adapters, std::vector<float>& OutScales) const
+{
+    OutScales.assign(LoraAdapters.size(), 0.f);
+    for (const FLlamaLoraAdapterScale& Adapter : Adapters)
+    {
+        const std::string Name = FLlamaString::ToStd(Adapter.Name);
+        int32 Index = 0;
+        while (Index < (int32)LoraAdapterNames.size() && LoraAdapterNames[Index] != Name)
+        {
+            Index++;
+        }
+        if (Index == (int32)LoraAdapterNames.size())
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("No LoRA adapter named %s was loaded, check ModelParams.LoraAdapters."), *Adapter.Name);
+            continue;
+        }
+        OutScales[Index] = Adapter.Scale;
     }
-
-    return Response;
 }
 
-void FLlamaInternal::RebuildContextFromHistory(const TArray<FStructuredChatMessage>& InMessages)
+void FLlamaInternal::ApplyLoraScales(const std::vector<float>& Scales)
 {
-    if (!bIsModelLoaded)
+    if (!Context || Scales == AppliedLoraScales)
     {
-        UE_LOG(LlamaLog, Warning, TEXT("RebuildContextFromHistory: model not loaded, skipping."));
         return;
     }
 
-    if (IsGenerating())
+    //Only active adapters go into the graph
+    std::vector<llama_adapter_lora*> Active;
+    std::vector<float> ActiveScales;
+    for (int32 i = 0; i < (int32)Scales.size() && i < (int32)LoraAdapters.size(); i++)
     {
-        StopGeneration();
+        if (Scales[i] != 0.f)
+        {
+            Active.push_back(LoraAdapters[i]);
+            ActiveScales.push_back(Scales[i]);
+        }
     }
 
-    //Cheap KV+state wipe (mirrors ResetContextHistory full-reset path)
-    ContextHistory.clear();
-    Messages.clear();
-    llama_memory_clear(llama_get_memory(Context), false);
-    FilledContextCharLength = 0;
-
-    //Replay each message through the existing template+decode pipeline without generating
-    for (const FStructuredChatMessage& Msg : InMessages)
+    if (llama_set_adapters_lora(Context, Active.data(), Active.size(), ActiveScales.data()) != 0)
     {
-        const std::string Content = TCHAR_TO_UTF8(*Msg.Content);
-        InsertTemplatedPrompt(Content, Msg.Role, /*bAddAssistantBoS=*/false, /*bGenerateReply=*/false);
+        UE_LOG(LlamaLog, Warning, TEXT("Failed to set %d LoRA adapter(s) on the context."), (int32)Active.size());
+        return;
     }
+    AppliedLoraScales = Scales;
 }
 
-std::string FLlamaInternal::ResumeGeneration()
+void FLlamaInternal::SetSlotLoraAdapters(const TArray<FLlamaLoraAdapterScale>* Adapters, int32 SlotId)
 {
-    //Todo: erase last assistant message to merge the two messages if the last message was the assistant one.
+    if (!IsValidSlot(SlotId))
+    {
+        return;
+    }
 
-    //run an empty user prompt
-    return Generate();
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    if (Adapters)
+    {
+        ResolveLoraScales(*Adapters, Slot.LoraScales);
+    }
+    else
+    {
+        Slot.LoraScales = DefaultLoraScales;
+    }
 }
 
-void FLlamaInternal::GetPromptEmbeddings(const std::string& Text, std::vector<float>& Embeddings)
+void FLlamaInternal::SetSlotLoraOverride(const TArray<FLlamaLoraAdapterScale>* Adapters, int32 SlotId)
 {
-    //apply https://github.com/ggml-org/llama.cpp/blob/master/examples/embedding/embedding.cpp wrapping logic
-
-    if (!Context)
+    if (!IsValidSlot(SlotId))
     {
-        EmitErrorMessage(TEXT("Context invalid, did you load the model?"), 43, __func__);
         return;
     }
 
-    //Tokenize prompt - we're crashing out here... 
-    //Check if our sampling/etc params are wrong or vocab is wrong.
-    //Try tokenizing using normal method?
-    //CONTINUE HERE:
-
-    // SafeTokenize replaces `common_tokenize` to keep the result vector's
-    // backing storage on our side of the static-lib boundary. See helper
-    // definition at the top of this file for the cross-allocator background.
-    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
-    std::vector<llama_token> Input = SafeTokenize(Vocab, Text, /*add_special*/ true, /*parse_special*/ true);
-    if (Input.empty())
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    Slot.bLoraOverride = Adapters != nullptr;
+    if (Adapters)
     {
-        UE_LOG(LlamaLog, Error, TEXT("GetPromptEmbeddings: tokenize produced 0 tokens (text bytes=%d)"),
-            (int32)Text.size());
-        return;
+        ResolveLoraScales(*Adapters, Slot.LoraOverrideScales);
     }
+    else
+    {
+        Slot.LoraOverrideScales.clear();
+    }
+}
 
-    //int32 NBatch = llama_n_ctx(Context);    //todo: get this from our params
-    int32 NBatch = Input.size();    //todo: get this from our params
-
-    llama_batch Batch = llama_batch_init(NBatch, 0, 1);
-    //llama_batch Batch = llama_batch_get_one(Input.data(), Input.size());
+// ---- Grammar constrained sampling -------------------------------------------
 
-    //add single batch
-    BatchAddSeq(Batch, Input, 0);
+bool FLlamaInternal::SetSlotGrammar(const std::string& InGrammar, const std::string& InJsonSchema, int32 SlotId)
+{
+    if (!IsValidSlot(SlotId))
+    {
+        return false;
+    }
 
-    enum llama_pooling_type PoolingType = llama_pooling_type(Context);
+    FLlamaConversationSlot& Slot = Slots[SlotId];
+    if (Slot.GrammarSampler)
+    {
+        llama_sampler_free(Slot.GrammarSampler);
+        Slot.GrammarSampler = nullptr;
+    }
+    if (InGrammar.empty() && InJsonSchema.empty())
+    {
+        return true;
+    }
 
-    //Count number of embeddings
-    int32 EmbeddingCount = 0;
+    std::string Gbnf = InGrammar;
+    if (Gbnf.empty())
+    {
+        FString SchemaGrammar;
+        FString SchemaError;
+        if (!FLlamaGrammar::JsonSchemaToGbnf(UTF8_TO_TCHAR(InJsonSchema.c_str()), SchemaGrammar, SchemaError))
+        {
+            EmitErrorMessage(FString::Printf(TEXT("JsonSchema can't be used as a constraint: %s. Reply is unconstrained."), *SchemaError), 24, __func__);
+            return false;
+        }
+        Gbnf = TCHAR_TO_UTF8(*SchemaGrammar);
+    }
 
-    if (PoolingType == llama_pooling_type::LLAMA_POOLING_TYPE_NONE)
+    Slot.GrammarSampler = llama_sampler_init_grammar(llama_model_get_vocab(LlamaModel), Gbnf.c_str(), "root");
+    if (!Slot.GrammarSampler)
     {
-        EmbeddingCount = Input.size();
+        EmitErrorMessage(TEXT("Grammar failed to parse (see log for the GBNF error). Reply is unconstrained."), 24, __func__);
+        return false;
     }
-    else
+    return true;
+}
+
+int32 FLlamaInternal::CountAllowedCandidates(const llama_token_data_array& Candidates, llama_token& OutToken)
+{
+    int32 Allowed = 0;
+    for (size_t i = 0; i < Candidates.size && Allowed < 2; i++)
     {
-        EmbeddingCount = 1;
+        if (Candidates.data[i].logit != -INFINITY)
+        {
+            OutToken = Candidates.data[i].id;
+            Allowed++;
+        }
     }
+    return Allowed;
+}
 
-    int32 NEmbd = llama_model_n_embd(LlamaModel);
+llama_token FLlamaInternal::SampleConstrainedSlotToken(FLlamaConversationSlot& Slot, int32 LogitIndex)
+{
+    const float* Logits = llama_get_logits_ith(Context, LogitIndex);
+    const int32 NVocab = llama_vocab_n_tokens(llama_model_get_vocab(LlamaModel));
 
-    //allocate raw output buffer
-    std::vector<float> Raw((size_t)EmbeddingCount * NEmbd, 0.f);
+    Slot.GrammarCandidates.resize(NVocab);
+    for (int32 i = 0; i < NVocab; i++)
+    {
+        Slot.GrammarCandidates[i] = { i, Logits[i], 0.f };
+    }
+    llama_token_data_array Candidates = { Slot.GrammarCandidates.data(), (size_t)NVocab, -1, false };
 
-    //decode
-    BatchDecodeEmbedding(Context, Batch, Raw.data(), 0, NEmbd, 2, EmbeddingCount);
+    //Grammar first, then the normal chain picks among what's left
+    llama_sampler_apply(Slot.GrammarSampler, &Candidates);
 
-    //Always return a single pooled vector. For NONE pooling, mean-pool per-token rows then re-normalize L2.
-    if (EmbeddingCount > 1)
+    llama_token Token = LLAMA_TOKEN_NULL;
+    if (CountAllowedCandidates(Candidates, Token) != 1)
     {
-        Embeddings.assign(NEmbd, 0.f);
-        for (int32 t = 0; t < EmbeddingCount; ++t)
+        llama_sampler* Chain = Slot.CommonSampler ? common_sampler_get(Slot.CommonSampler) : Slot.Sampler;
+        llama_sampler_apply(Chain, &Candidates);
+        if (Candidates.selected >= 0 && Candidates.selected < (int64_t)Candidates.size)
         {
-            const float* Row = Raw.data() + t * NEmbd;
-            for (int32 d = 0; d < NEmbd; ++d)
+            Token = Candidates.data[Candidates.selected].id;
+        }
+        else
+        {
+            //Chain without a final selector, take the most likely allowed token
+            float BestLogit = -INFINITY;
+            for (size_t i = 0; i < Candidates.size; i++)
             {
-                Embeddings[d] += Row[d];
+                if (Candidates.data[i].logit > BestLogit)
+                {
+                    BestLogit = Candidates.data[i].logit;
+                    Token = Candidates.data[i].id;
+                }
             }
         }
-        const float Inv = 1.f / static_cast<float>(EmbeddingCount);
-        for (int32 d = 0; d < NEmbd; ++d) { Embeddings[d] *= Inv; }
+    }
 
-        //L2 renormalize after pooling
-        double SumSq = 0.0;
-        for (int32 d = 0; d < NEmbd; ++d) { SumSq += static_cast<double>(Embeddings[d]) * Embeddings[d]; }
-        const float Norm = SumSq > 0.0 ? static_cast<float>(1.0 / sqrt(SumSq)) : 1.f;
-        for (int32 d = 0; d < NEmbd; ++d) { Embeddings[d] *= Norm; }
+    llama_sampler_accept(Slot.GrammarSampler, Token);
+    if (Slot.CommonSampler)
+    {
+        common_sampler_accept(Slot.CommonSampler, Token, true);
     }
     else
     {
-        Embeddings = std::move(Raw);
+        llama_sampler_accept(Slot.Sampler, Token);
     }
-
-    llama_batch_free(Batch);
-
-    UE_LOG(LlamaLog, Verbose, TEXT("FLlamaInternal::GetPromptEmbeddings: %d floats (pooling=%d, tokens=%d)"),
-           static_cast<int32>(Embeddings.size()),
-           static_cast<int32>(PoolingType),
-           static_cast<int32>(Input.size()));
-}
-
-int32 FLlamaInternal::GetEmbeddingDimension() const
-{
-    return LlamaModel ? llama_model_n_embd(LlamaModel) : 0;
+    return Token;
 }
 
-int32 FLlamaInternal::ProcessPrompt(const std::string& Prompt, EChatTemplateRole Role)
+void FLlamaInternal::ProposeForcedTokens(int32 MaxDraft, std::vector<llama_token>& OutDraft)
 {
-    const auto StartTime = ggml_time_us();
-
-    //Grab vocab
-    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
-    const bool IsFirst = llama_memory_seq_pos_max(llama_get_memory(Context), 0) == 0;
+    OutDraft.clear();
 
-    // tokenize the prompt
-    const int NPromptTokens = -llama_tokenize(Vocab, Prompt.c_str(), Prompt.size(), NULL, 0, IsFirst, true);
-    std::vector<llama_token> PromptTokens(NPromptTokens);
-    if (llama_tokenize(Vocab, Prompt.c_str(), Prompt.size(), PromptTokens.data(), PromptTokens.size(), IsFirst, true) < 0)
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    if (!Slot.GrammarSampler || MaxDraft <= 0)
     {
-        EmitErrorMessage(TEXT("failed to tokenize the prompt"), 21, __func__);
-        return NPromptTokens;
+        return;
     }
 
-    //All in one batch
-    if (LastLoadedParams.Advanced.Output.PromptProcessingPacingSleep == 0.f)
-    {
-        // prepare a batch for the prompt
-        llama_batch Batch = llama_batch_get_one(PromptTokens.data(), PromptTokens.size());
-
-        //check sizing before running prompt decode
-        int NContext = llama_n_ctx(Context);
-        int NContextUsed = llama_memory_seq_pos_max(llama_get_memory(Context), 0);
+    //Walk a copy of the grammar state, logits don't matter for which tokens it allows
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+    const int32 NVocab = llama_vocab_n_tokens(Vocab);
+    Slot.GrammarCandidates.resize(NVocab);
+    llama_sampler* Lookahead = llama_sampler_clone(Slot.GrammarSampler);
 
-        if (NContextUsed + NPromptTokens > NContext)
+    while ((int32)OutDraft.size() < MaxDraft)
+    {
+        for (int32 i = 0; i < NVocab; i++)
         {
-            EmitErrorMessage(FString::Printf(
-                TEXT("Failed to insert, tried to insert %d tokens to currently used %d tokens which is more than the max %d context size. Try increasing the context size and re-run prompt."),
-                NPromptTokens, NContextUsed, NContext
-            ), 22, __func__);
-            return 0;
+            Slot.GrammarCandidates[i] = { i, 0.f, 0.f };
         }
+        llama_token_data_array Candidates = { Slot.GrammarCandidates.data(), (size_t)NVocab, -1, false };
+        llama_sampler_apply(Lookahead, &Candidates);
 
-        // run it through the decode (input)
-        if (llama_decode(Context, Batch))
+        llama_token Forced = LLAMA_TOKEN_NULL;
+        if (CountAllowedCandidates(Candidates, Forced) != 1 || llama_vocab_is_eog(Vocab, Forced))
         {
-            EmitErrorMessage(TEXT("Failed to decode, could not find a KV slot for the batch (try reducing the size of the batch or increase the context)."), 23, __func__);
-            return NPromptTokens;
+            break;
         }
+        OutDraft.push_back(Forced);
+        llama_sampler_accept(Lookahead, Forced);
     }
-    //Split it and sleep between batches for pacing purposes
-    else
-    {
-        int32 BatchCount = LastLoadedParams.Advanced.Output.PromptProcessingPacingSplitN;
-
-        int32 TotalTokens = PromptTokens.size();
-        int32 TokensPerBatch = TotalTokens / BatchCount;
-        int32 Remainder = TotalTokens % BatchCount;
 
-        int32 StartIndex = 0;
-
-        for (int32 i = 0; i < BatchCount; i++)
-        {
-            // Calculate how many tokens to put in this batch
-            int32 CurrentBatchSize = TokensPerBatch + (i < Remainder ? 1 : 0);
+    llama_sampler_free(Lookahead);
+}
 
-            // Slice the relevant tokens for this batch
-            std::vector<llama_token> BatchTokens(
-                PromptTokens.begin() + StartIndex,
-                PromptTokens.begin() + StartIndex + CurrentBatchSize
-            );
+// ---- Speculative decoding --------------------------------------------------
 
-            // Prepare the batch
-            llama_batch Batch = llama_batch_get_one(BatchTokens.data(), BatchTokens.size());
+bool FLlamaInternal::InitDraftModel(const FString& DraftModelPath)
+{
+    FreeDraftModel();
 
-            // Check context before running decode
-            int NContext = llama_n_ctx(Context);
-            int NContextUsed = llama_memory_seq_pos_max(llama_get_memory(Context), 0);
+    const std::string Path = TCHAR_TO_UTF8(*FLlamaPaths::ParsePathIntoFullPath(DraftModelPath));
+    const FLLMSpeculativeParams& SpecParams = LastLoadedParams.Advanced.Speculative;
 
-            if (NContextUsed + BatchTokens.size() > NContext)
-            {
-                EmitErrorMessage(FString::Printf(
-                    TEXT("Failed to insert, tried to insert %d tokens to currently used %d tokens which is more than the max %d context size. Try increasing the context size and re-run prompt."),
-                    BatchTokens.size(), NContextUsed, NContext
-                ), 22, __func__);
-                return 0;
-            }
+    llama_model_params DraftModelParams = llama_model_default_params();
+    DraftModelParams.n_gpu_layers = SpecParams.DraftGPULayers >= 0 ? SpecParams.DraftGPULayers : LastLoadedParams.GPULayers;
+    DraftModelParams.use_mmap = LastLoadedParams.Advanced.Memory.bUseMmap;
+    DraftModelParams.use_mlock = LastLoadedParams.Advanced.Memory.bUseMlock;
 
-            // Decode this batch
-            if (llama_decode(Context, Batch))
-            {
-                EmitErrorMessage(TEXT("Failed to decode, could not find a KV slot for the batch (try reducing the size of the batch or increase the context)."), 23, __func__);
-                return BatchTokens.size();
-            }
+    DraftModel = FLlamaModelRegistry::Get().Acquire(Path, DraftModelParams);
+    if (!DraftModel)
+    {
+        EmitErrorMessage(FString::Printf(TEXT("Unable to load draft model at <%hs>, speculative decoding disabled."), Path.c_str()), 12, __func__);
+        return false;
+    }
 
-            StartIndex += CurrentBatchSize;
-            FPlatformProcess::Sleep(LastLoadedParams.Advanced.Output.PromptProcessingPacingSleep);
-        }
+    //Drafted ids are fed straight to the main model, so the vocabs must line up (same tolerance as llama.cpp's speculative example)
+    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+    const llama_vocab* DraftVocab = llama_model_get_vocab(DraftModel);
+    const bool bCompatible =
+        llama_vocab_type(Vocab) == llama_vocab_type(DraftVocab) &&
+        FMath::Abs(llama_vocab_n_tokens(Vocab) - llama_vocab_n_tokens(DraftVocab)) <= 128 &&
+        llama_vocab_bos(Vocab) == llama_vocab_bos(DraftVocab) &&
+        llama_vocab_eos(Vocab) == llama_vocab_eos(DraftVocab);
+    if (!bCompatible)
+    {
+        EmitErrorMessage(TEXT("Draft model vocab doesn't match the main model, speculative decoding disabled."), 12, __func__);
+        FreeDraftModel();
+        return false;
     }
 
-    const auto StopTime = ggml_time_us();
-    const float Duration = (StopTime - StartTime) / 1000000.0f;
+    llama_context_params DraftContextParams = llama_context_default_params();
+    DraftContextParams.n_ctx = llama_n_ctx_seq(Context);
+    DraftContextParams.n_batch = llama_n_batch(Context);
+    DraftContextParams.n_threads = Threadpools.GetDecodeThreads();
+    DraftContextParams.n_threads_batch = Threadpools.GetPrefillThreads();
+    ApplyMemoryParams(LastLoadedParams.Advanced.Memory, DraftContextParams);
 
-    if (OnPromptProcessed)
+    DraftContext = llama_init_from_model(DraftModel, DraftContextParams);
+    if (!DraftContext)
     {
-        float Speed = NPromptTokens / Duration;
-        OnPromptProcessed(NPromptTokens, Role, Speed);
+        EmitErrorMessage(TEXT("Unable to initialize the draft model context, speculative decoding disabled."), 12, __func__);
+        FreeDraftModel();
+        return false;
     }
+    Threadpools.Attach(DraftContext);
 
-    return NPromptTokens;
+    DraftBatchCapacity = FMath::Max(1, (int32)llama_n_batch(DraftContext));
+    DraftBatch = llama_batch_init(DraftBatchCapacity, 0, 1);
+    DraftKVTokens.clear();
+
+    UE_LOG(LlamaLog, Log, TEXT("Speculative decoding enabled, drafting up to %d tokens with <%hs>"), SpecParams.DraftTokens, Path.c_str());
+    return true;
 }
 
-std::string FLlamaInternal::Generate(const std::string& Prompt, bool bAppendToMessageHistory, const std::string& AssistantPrefill)
+void FLlamaInternal::FreeDraftModel()
 {
-    const auto StartTime = ggml_time_us();
-
-    bGenerationActive = true;
-
-    if (!Prompt.empty())
+    if (DraftBatchCapacity > 0)
     {
-        int32 TokensProcessed = ProcessPrompt(Prompt);
+        llama_batch_free(DraftBatch);
+        DraftBatch = {};
+        DraftBatchCapacity = 0;
     }
-
-    //Seed response accumulator with prefill so it shows up in the final response and in the
-    //assistant message history. The prefill bytes are assumed to already be in the KV cache
-    //(InsertTemplatedPrompt injects them into the prompt-eval batch). We also emit through
-    //OnTokenGenerated as a single piece so subscribers see one continuous stream.
-    std::string Response = AssistantPrefill;
-    if (!AssistantPrefill.empty() && OnTokenGenerated)
+    if (DraftContext)
     {
-        OnTokenGenerated(AssistantPrefill);
+        llama_free(DraftContext);
+        DraftContext = nullptr;
+    }
+    if (DraftModel)
+    {
+        FLlamaModelRegistry::Get().Release(DraftModel);
+        DraftModel = nullptr;
     }
+    DraftKVTokens.clear();
+}
 
-    const llama_vocab* Vocab = llama_model_get_vocab(LlamaModel);
+void FLlamaInternal::ProposeDraftTokens(llama_token LastToken, int32 MaxDraft, std::vector<llama_token>& OutDraft)
+{
+    OutDraft.clear();
 
-    llama_token NewTokenId;
-    int32 NDecoded = 0;
+    const FLlamaConversationSlot& Slot = ActiveSlot();
+    if (!DraftContext || MaxDraft <= 0 || !Slot.bKVTokensValid ||
+        (int32)Slot.KVTokens.size() + 1 + MaxDraft > (int32)llama_n_ctx(DraftContext))
+    {
+        return;
+    }
 
-    // check if we have enough space in the context to evaluate this batch - might need to be inside loop
-    int NContext = llama_n_ctx(Context);
-    bool bEOGExit = false;
+    //The draft sequence mirrors the last slot it drafted for. Keep the shared prefix (drops rejected drafts,
+    //or everything when another slot drafted last) and catch up on the rest plus LastToken.
+    llama_memory_t DraftMemory = llama_get_memory(DraftContext);
+    const int32 MirrorSize = Slot.KVTokens.size();
+    int32 Common = 0;
+    const int32 MaxCommon = FMath::Min((int32)DraftKVTokens.size(), MirrorSize);
+    while (Common < MaxCommon && DraftKVTokens[Common] == Slot.KVTokens[Common])
+    {
+        Common++;
+    }
+    llama_memory_seq_rm(DraftMemory, 0, Common, -1);
+    DraftKVTokens.resize(Common);
 
-    // For M-RoPE models (e.g. Qwen2VL), seq_pos_max reflects the max 2D spatial position of
-    // image tokens and is NOT the correct next text position. Use NextGenerationNPast when it has
-    // been set by ProcessMultimodalPrompt; otherwise fall back to seq_pos_max+1 (text-only path).
-    llama_pos SeqPosMaxAtGenStart = llama_memory_seq_pos_max(llama_get_memory(Context), 0);
-    llama_pos NPast = (NextGenerationNPast > 0)
-        ? NextGenerationNPast
-        : SeqPosMaxAtGenStart + 1;
-    NextGenerationNPast = 0; // consumed
+    int32 Pos = Common;
+    while (Pos <= MirrorSize)
+    {
+        DraftBatch.n_tokens = 0;
+        while (Pos <= MirrorSize && DraftBatch.n_tokens < DraftBatchCapacity)
+        {
+            const llama_token Token = Pos < MirrorSize ? Slot.KVTokens[Pos] : LastToken;
+            BatchAddToken(DraftBatch, Token, Pos, 0, Pos == MirrorSize);
+            DraftKVTokens.push_back(Token);
+            Pos++;
+        }
+        if (llama_decode(DraftContext, DraftBatch))
+        {
+            llama_memory_seq_rm(DraftMemory, 0, -1, -1);
+            DraftKVTokens.clear();
+            return;
+        }
+    }
 
-    UE_LOG(LlamaLog, Log, TEXT("[Generate] NPast=%d seq_pos_max=%d (from_mtmd=%s)"),
-        (int32)NPast, (int32)SeqPosMaxAtGenStart,
-        (NPast != SeqPosMaxAtGenStart + 1) ? TEXT("yes") : TEXT("no"));
+    //Greedy draft, stop at the first low confidence token
+    const llama_vocab* DraftVocab = llama_model_get_vocab(DraftModel);
+    const int32 NVocab = llama_vocab_n_tokens(DraftVocab);
+    const int32 MainVocabSize = llama_vocab_n_tokens(llama_model_get_vocab(LlamaModel));
+    const float MinProbability = LastLoadedParams.Advanced.Speculative.DraftMinProbability;
 
-    bool bFirstToken = true;
-    while (bGenerationActive) //processing can be aborted by flipping the boolean
+    while ((int32)OutDraft.size() < MaxDraft)
     {
-        //Common sampler is a bit faster
-        if (CommonSampler)
+        const float* Logits = llama_get_logits_ith(DraftContext, -1);
+        if (!Logits)
         {
-            NewTokenId = common_sampler_sample(CommonSampler, Context, -1); //sample using common sampler
-            common_sampler_accept(CommonSampler, NewTokenId, true);
+            break;
         }
-        else
+
+        llama_token Best = 0;
+        for (int32 i = 1; i < NVocab; i++)
         {
-            NewTokenId = llama_sampler_sample(Sampler, Context, -1);
+            if (Logits[i] > Logits[Best])
+            {
+                Best = i;
+            }
         }
-
-        if (bFirstToken)
+        double Sum = 0.0;
+        for (int32 i = 0; i < NVocab; i++)
         {
-            bFirstToken = false;
-            const std::string FirstPiece = SafeTokenToPiece(Vocab, NewTokenId, true);
-            UE_LOG(LlamaLog, Log, TEXT("[Generate] first token id=%d piece='%hs'"),
-                (int32)NewTokenId, FirstPiece.c_str());
+            Sum += FMath::Exp(Logits[i] - Logits[Best]);
         }
+        const float Probability = (float)(1.0 / Sum);
 
-        // is it an end of generation?
-        if (llama_vocab_is_eog(Vocab, NewTokenId))
+        if (Probability < MinProbability || Best >= MainVocabSize)
         {
-            bEOGExit = true;
             break;
         }
 
-        // convert the token to a string, print it and add it to the response.
-        // SafeTokenToPiece keeps the string allocation on our side of the static-lib
-        // boundary; see helper definition for the cross-allocator background.
-        std::string Piece = SafeTokenToPiece(Vocab, NewTokenId, true);
-
-        Response += Piece;
-        NDecoded += 1;
-
-        if (NPast + NDecoded > NContext)
+        OutDraft.push_back(Best);
+        if ((int32)OutDraft.size() == MaxDraft || llama_vocab_is_eog(DraftVocab, Best))
         {
-            FString ErrorMessage = FString::Printf(TEXT("Context size %d exceeded on generation. Try increasing the context size and re-run prompt"), NContext);
-
-            EmitErrorMessage(ErrorMessage, 31, __func__);
-            return Response;
+            break;
         }
 
-        if (OnTokenGenerated)
+        DraftBatch.n_tokens = 0;
+        BatchAddToken(DraftBatch, Best, DraftKVTokens.size(), 0, true);
+        if (llama_decode(DraftContext, DraftBatch))
         {
-            OnTokenGenerated(Piece);
+            break;
         }
+        DraftKVTokens.push_back(Best);
+    }
+}
 
-        // Use explicit n_past position (mirrors mtmd-cli reference implementation).
-        // This is critical for M-RoPE models where seq_pos_max != true next text position.
-        llama_batch SingleBatch = llama_batch_get_one(&NewTokenId, 1);
-        SingleBatch.pos = &NPast;  // override auto-position with tracked n_past
+void FLlamaInternal::ProposeLookupTokens(llama_token LastToken, int32 MaxDraft, std::vector<llama_token>& OutDraft)
+{
+    OutDraft.clear();
+
+    const FLlamaConversationSlot& Slot = ActiveSlot();
+    const int32 NGram = FMath::Clamp(LastLoadedParams.Advanced.Speculative.PromptLookupNGram, 1, 8);
+    const int32 MirrorSize = Slot.KVTokens.size();
+    if (MaxDraft <= 0 || !Slot.bKVTokensValid || MirrorSize < NGram)
+    {
+        return;
+    }
 
-        if (llama_decode(Context, SingleBatch))
+    auto HashNGram = [NGram](const llama_token* Tokens)
+    {
+        uint64 Hash = 14695981039346656037ull;
+        for (int32 i = 0; i < NGram; i++)
         {
-            bGenerationActive = false;
-            FString ErrorMessage = TEXT("Failed to decode. Could not find a KV slot for the batch (try reducing the size of the batch or increase the context)");
-            EmitErrorMessage(ErrorMessage, 32, __func__);
-            //Return partial response
-            return Response;
+            Hash = (Hash ^ (uint32)Tokens[i]) * 1099511628211ull;
         }
+        return Hash;
+    };
 
-        NPast++;
+    //Positions only hold while the mirror grows in place, start over after a rollback, shift or slot change
+    if (LookupSlotId != ActiveSlotId || LookupShiftCount != Slot.ShiftedTokenCount || LookupIndexedTokens > MirrorSize)
+    {
+        LookupTable.Reset();
+        LookupIndexedTokens = 0;
+        LookupSlotId = ActiveSlotId;
+        LookupShiftCount = Slot.ShiftedTokenCount;
+    }
 
-        //sleep pacing
-        if (LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep > 0.f)
-        {
-            FPlatformProcess::Sleep(LastLoadedParams.Advanced.Output.TokenGenerationPacingSleep);
-        }
+    //Index every n-gram ending in a token added since the last call, later occurrences overwrite earlier ones
+    for (int32 End = FMath::Max(LookupIndexedTokens, NGram - 1); End < MirrorSize; End++)
+    {
+        LookupTable.Add(HashNGram(Slot.KVTokens.data() + End - NGram + 1), End);
     }
+    LookupIndexedTokens = MirrorSize;
 
-    bGenerationActive = false;
+    //Query n-gram is the mirror tail + LastToken, which isn't indexed yet so it can't match itself
+    llama_token Query[8];
+    for (int32 i = 0; i < NGram - 1; i++)
+    {
+        Query[i] = Slot.KVTokens[MirrorSize - NGram + 1 + i];
+    }
+    Query[NGram - 1] = LastToken;
 
-    const auto StopTime = ggml_time_us();
-    const float Duration = (StopTime - StartTime) / 1000000.0f;
+    const int32* Found = LookupTable.Find(HashNGram(Query));
+    if (!Found)
+    {
+        return;
+    }
+
+    //Hash hit may be a collision or stale, confirm the tokens
+    const int32 MatchEnd = *Found;
+    if (MatchEnd >= MirrorSize || memcmp(Slot.KVTokens.data() + MatchEnd - NGram + 1, Query, NGram * sizeof(llama_token)) != 0)
+    {
+        return;
+    }
+
+    //Continuation runs up to the end of the mirror, followed by LastToken itself
+    for (int32 Pos = MatchEnd + 1; Pos <= MirrorSize && (int32)OutDraft.size() < MaxDraft; Pos++)
+    {
+        OutDraft.push_back(Pos < MirrorSize ? Slot.KVTokens[Pos] : LastToken);
+    }
+}
+
+std::string FLlamaInternal::CommitResponse(const std::string& Response, bool bAppendToMessageHistory)
+{
+    FLlamaConversationSlot& Slot = ActiveSlot();
 
     if (bAppendToMessageHistory)
     {
         //Add the raw response (with thinking) to our templated messages for context preservation
-        Messages.push_back({ RoleForEnum(EChatTemplateRole::Assistant), LLAMA_STRDUP(Response.c_str()) });
+        Slot.Messages.push_back({ RoleForEnum(EChatTemplateRole::Assistant), LLAMA_STRDUP(Response.c_str()) });
+        RecordMessageTokenSpan(FMath::Min(Slot.ReplyTokenStart, (int32)Slot.KVTokens.size()), Slot.KVTokens.size());
 
         //Sync ContextHistory
-        FilledContextCharLength = ApplyTemplateToContextHistory(false);
+        Slot.FilledContextCharLength = ApplyTemplateToContextHistory(false);
     }
 
     //Strip thinking content from emitted response if requested
@@ -1016,11 +4173,6 @@ std::string FLlamaInternal::Generate(const std::string& Prompt, bool bAppendToMe
         }
     }
 
-    if (OnGenerationComplete)
-    {
-        OnGenerationComplete(EmittedResponse, Duration, NDecoded, NDecoded / Duration);
-    }
-
     return EmittedResponse;
 }
 
@@ -1036,40 +4188,29 @@ void FLlamaInternal::EmitErrorMessage(const FString& ErrorMessage, int32 ErrorCo
 //NB: this function will apply out of range errors in log, this is normal behavior due to how templates are applied
 int32 FLlamaInternal::ApplyTemplateToContextHistory(bool bAddAssistantBOS)
 {
-    return ApplyTemplateFromMessagesToBuffer(Template, Messages, ContextHistory, bAddAssistantBOS);
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    const int32 NewLen = Slot.Renderer.Render(Slot.Messages, bAddAssistantBOS, Slot.ContextHistory);
+    if (NewLen < 0)
+    {
+        EmitErrorMessage(TEXT("Failed to apply the chat template ApplyTemplateToContextHistory, negative length"), 101, __func__);
+    }
+    return NewLen;
 }
 
 int32 FLlamaInternal::ApplyTemplateFromMessagesToBuffer(const std::string& InTemplate, std::vector<llama_chat_message>& FromMessages, std::vector<char>& ToBuffer, bool bAddAssistantBoS)
 {
-    //Handle empty template case
-    char* templatePtr = (char*)InTemplate.c_str();
-    if (InTemplate.length() == 0)
-    {
-        templatePtr = nullptr;
-    }
+    //Full render, resizes ToBuffer if it can't hold it. Empty template uses the llama.cpp default.
+    int32 NewLen = FLlamaChatTemplateRenderer::RenderFull(InTemplate, FromMessages.data(), FromMessages.size(), bAddAssistantBoS, ToBuffer);
 
-    int32 NewLen = llama_chat_apply_template(templatePtr, FromMessages.data(), FromMessages.size(),
-            bAddAssistantBoS, ToBuffer.data(), ToBuffer.size());
-
-    //Resize if ToBuffer can't hold it
-    if (NewLen > ToBuffer.size())
+    if (NewLen < 0)
     {
-        ToBuffer.resize(NewLen);
-        NewLen = llama_chat_apply_template(InTemplate.c_str(), FromMessages.data(), FromMessages.size(),
-            bAddAssistantBoS, ToBuffer.data(), ToBuffer.size());
+        EmitErrorMessage(TEXT("Failed to apply the chat template ApplyTemplateFromMessagesToBuffer, negative length"), 101, __func__);
     }
-    else 
+    else if (NewLen == 0)
     {
-        if (NewLen < 0)
-        {
-            EmitErrorMessage(TEXT("Failed to apply the chat template ApplyTemplateFromMessagesToBuffer, negative length"), 101, __func__);
-        }
-        else if (NewLen == 0)
-        {
-            //This isn't an error but needs to be handled by downstream
-            
-            //EmitErrorMessage(TEXT("Failed to apply the chat template ApplyTemplateFromMessagesToBuffer, length is 0."), 102, __func__);
-        }
+        //This isn't an error but needs to be handled by downstream
+        
+        //EmitErrorMessage(TEXT("Failed to apply the chat template ApplyTemplateFromMessagesToBuffer, length is 0."), 102, __func__);
     }
     
     return NewLen;
@@ -1095,7 +4236,7 @@ const char* FLlamaInternal::RoleForEnum(EChatTemplateRole Role)
 }
 
 //from https://github.com/ggml-org/llama.cpp/blob/master/examples/embedding/embedding.cpp
-void FLlamaInternal::BatchDecodeEmbedding(llama_context* InContext, llama_batch& Batch, float* Output, int NSeq, int NEmbd, int EmbdNorm, int MaxRows)
+bool FLlamaInternal::BatchDecodeEmbedding(llama_context* InContext, llama_batch& Batch, float* Output, int NSeq, int NEmbd, int EmbdNorm, int MaxRows)
 {
     const enum llama_pooling_type pooling_type = llama_pooling_type(InContext);
     const struct llama_model* model = llama_get_model(InContext);
@@ -1110,7 +4251,7 @@ void FLlamaInternal::BatchDecodeEmbedding(llama_context* InContext, llama_batch&
         if (llama_encode(InContext, Batch) < 0)
         {
             UE_LOG(LlamaLog, Error, TEXT("%hs : failed to encode"), __func__);
-            return;
+            return false;
         }
     }
     else if (!llama_model_has_encoder(model) && llama_model_has_decoder(model))
@@ -1119,7 +4260,7 @@ void FLlamaInternal::BatchDecodeEmbedding(llama_context* InContext, llama_batch&
         if (llama_decode(InContext, Batch) < 0)
         {
             UE_LOG(LlamaLog, Log, TEXT("%hs : failed to decode"), __func__);
-            return;
+            return false;
         }
     }
 
@@ -1143,6 +4284,12 @@ void FLlamaInternal::BatchDecodeEmbedding(llama_context* InContext, llama_batch&
         {
             // try to get sequence embeddings - supported only when pooling_type is not NONE
             const llama_seq_id SeqId = Batch.seq_id[i] ? Batch.seq_id[i][0] : 0;
+
+            //one pooled vector per sequence, read it at the sequence's last token
+            if (i + 1 < Batch.n_tokens && Batch.seq_id[i + 1] && Batch.seq_id[i + 1][0] == SeqId)
+            {
+                continue;
+            }
             Embd = llama_get_embeddings_seq(InContext, SeqId);
             EmbdPos = SeqId;
         }
@@ -1169,6 +4316,7 @@ void FLlamaInternal::BatchDecodeEmbedding(llama_context* InContext, llama_batch&
         float* Out = Output + (size_t)EmbdPos * NEmbd;
         common_embd_normalize(Embd, Out, NEmbd, EmbdNorm);
     }
+    return true;
 }
 
 void FLlamaInternal::BatchAddSeq(llama_batch& batch, const std::vector<int32_t>& tokens, llama_seq_id seq_id)
@@ -1176,7 +4324,7 @@ void FLlamaInternal::BatchAddSeq(llama_batch& batch, const std::vector<int32_t>&
     size_t n_tokens = tokens.size();
     for (size_t i = 0; i < n_tokens; i++) 
     {
-        common_batch_add(batch, tokens[i], i, { seq_id }, true);
+        BatchAddToken(batch, tokens[i], i, seq_id, true);
     }
 }
 
@@ -1196,7 +4344,7 @@ bool FLlamaInternal::InitMultimodal(const FString& MmprojPath)
 
     mtmd_context_params Params = mtmd_context_params_default();
     Params.use_gpu = true;
-    Params.n_threads = LastLoadedParams.Threads;
+    Params.n_threads = Threadpools.GetPrefillThreads();
     Params.flash_attn_type = SavedFlashAttnType;
 
     MtmdContext = mtmd_init_from_file(Path.c_str(), LlamaModel, Params);
@@ -1306,7 +4454,8 @@ int32 FLlamaInternal::ProcessMultimodalPrompt(const std::string& FormattedPrompt
     // 2. Tokenize with mtmd
     mtmd_input_chunks* Chunks = mtmd_input_chunks_init();
     // seq_pos_max returns -1 when the KV cache is empty; only add BOS on the very first prompt
-    const llama_pos SeqPosMax = llama_memory_seq_pos_max(llama_get_memory(Context), 0);
+    const llama_seq_id SeqId = ActiveSlotId;
+    const llama_pos SeqPosMax = llama_memory_seq_pos_max(llama_get_memory(Context), SeqId);
     const bool IsFirst = (SeqPosMax < 0);
 
     mtmd_input_text InputText;
@@ -1333,7 +4482,7 @@ int32 FLlamaInternal::ProcessMultimodalPrompt(const std::string& FormattedPrompt
     // For an empty cache (seq_pos_max == -1), -1 + 1 = 0 which is correct.
     llama_pos NPast = SeqPosMax + 1;
     llama_pos NewNPast = NPast;
-    const int32 NCtx = llama_n_ctx(Context);
+    const int32 NCtx = llama_n_ctx_seq(Context);
     const size_t NChunks = mtmd_input_chunks_size(Chunks);
     const size_t NTokensInChunks = mtmd_helper_get_n_tokens(Chunks);
 
@@ -1352,7 +4501,7 @@ int32 FLlamaInternal::ProcessMultimodalPrompt(const std::string& FormattedPrompt
 
     int32_t EvalResult = mtmd_helper_eval_chunks(
         MtmdContext, Context, Chunks,
-        NPast, 0,
+        NPast, SeqId,
         LastLoadedParams.MaxBatchLength,
         bLogitsLast, &NewNPast);
 
@@ -1371,10 +4520,10 @@ int32 FLlamaInternal::ProcessMultimodalPrompt(const std::string& FormattedPrompt
 
     // Record the correct next KV position from mtmd (NOT seq_pos_max, which is wrong for M-RoPE
     // because 2D spatial positions from image tokens inflate seq_pos_max beyond the true text position).
-    NextGenerationNPast = NewNPast;
+    ActiveSlot().NextGenerationNPast = NewNPast;
     UE_LOG(LlamaLog, Log, TEXT("[ProcessMultimodalPrompt] eval complete: NewNPast=%d seq_pos_max=%d"),
         (int32)NewNPast,
-        (int32)llama_memory_seq_pos_max(llama_get_memory(Context), 0));
+        (int32)llama_memory_seq_pos_max(llama_get_memory(Context), SeqId));
 
     const auto StopTime = ggml_time_us();
     const float Duration = (StopTime - StartTime) / 1000000.0f;
@@ -1388,7 +4537,7 @@ int32 FLlamaInternal::ProcessMultimodalPrompt(const std::string& FormattedPrompt
     return TokensProcessed;
 }
 
-std::string FLlamaInternal::InsertMultimodalPrompt(const std::string& TextWithMarkers, const TArray<FLlamaMediaEntry>& MediaEntries, EChatTemplateRole Role, bool bAddAssistantBoS, bool bGenerateReply)
+std::string FLlamaInternal::InsertMultimodalPrompt(const std::string& TextWithMarkers, const TArray<FLlamaMediaEntry>& MediaEntries, EChatTemplateRole Role, bool bAddAssistantBoS, bool bGenerateReply, int32 SlotId)
 {
     if (!bIsModelLoaded)
     {
@@ -1402,11 +4551,20 @@ std::string FLlamaInternal::InsertMultimodalPrompt(const std::string& TextWithMa
         return std::string();
     }
 
-    int32 NewLen = FilledContextCharLength;
+    if (!SelectSlot(SlotId, __func__))
+    {
+        return std::string();
+    }
+    DrainScheduledSlot(SlotId);
+
+    FLlamaConversationSlot& Slot = ActiveSlot();
+    std::vector<char>& ContextHistory = Slot.ContextHistory;
+
+    int32 NewLen = Slot.FilledContextCharLength;
 
     if (!TextWithMarkers.empty())
     {
-        Messages.push_back({ RoleForEnum(Role), LLAMA_STRDUP(TextWithMarkers.c_str()) });
+        Slot.Messages.push_back({ RoleForEnum(Role), LLAMA_STRDUP(TextWithMarkers.c_str()) });
         // When generating a reply, always add the assistant BOS so the model responds immediately
         // rather than generating the <|im_start|>assistant token itself (which causes loops on vision models)
         const bool bActualAddAssistantBoS = bAddAssistantBoS || bGenerateReply;
@@ -1435,11 +4593,14 @@ std::string FLlamaInternal::InsertMultimodalPrompt(const std::string& TextWithMa
 
     if (NewLen > 0)
     {
-        std::string FormattedPrompt(ContextHistory.data() + FilledContextCharLength, ContextHistory.data() + NewLen);
+        std::string FormattedPrompt(ContextHistory.data() + Slot.FilledContextCharLength, ContextHistory.data() + NewLen);
         int32 TokensProcessed = ProcessMultimodalPrompt(FormattedPrompt, MediaEntries, Role, bGenerateReply);
+
+        //Media embeddings aren't vocab tokens, rollback uses the re-tokenizing path from here on
+        Slot.bKVTokensValid = false;
     }
 
-    FilledContextCharLength = NewLen;
+    Slot.FilledContextCharLength = NewLen;
 
     std::string Response;
     if (bGenerateReply)
@@ -1459,5 +4620,6 @@ FLlamaInternal::~FLlamaInternal()
 {
     OnTokenGenerated = nullptr;
     UnloadModel();
+    Threadpools.Reset();
     llama_backend_free();
 }
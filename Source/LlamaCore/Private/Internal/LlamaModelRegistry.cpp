@@ -0,0 +1,201 @@
+// Copyright 2025-current Getnamo.
+
+#include "Internal/LlamaModelRegistry.h"
+#include "LlamaUtility.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+FLlamaModelRegistry& FLlamaModelRegistry::Get()
+{
+    static FLlamaModelRegistry Registry;
+    return Registry;
+}
+
+FString FLlamaModelRegistry::MakeKey(const std::string& Path, const llama_model_params& Params)
+{
+    FString FullPath = FPaths::ConvertRelativePathToFull(UTF8_TO_TCHAR(Path.c_str()));
+    FPaths::NormalizeFilename(FullPath);
+    return FString::Printf(TEXT("%s|gpu=%d|mmap=%d|mlock=%d"), *FullPath.ToLower(), Params.n_gpu_layers, Params.use_mmap, Params.use_mlock);
+}
+
+llama_model* FLlamaModelRegistry::Acquire(const std::string& Path, const llama_model_params& Params)
+{
+    const FString Key = MakeKey(Path, Params);
+    {
+        FScopeLock Lock(&Mutex);
+        for (FEntry& Entry : Entries)
+        {
+            if (Entry.Key == Key)
+            {
+                Entry.RefCount++;
+                UE_LOG(LlamaLog, Log, TEXT("Sharing loaded weights of <%hs> (%d users)"), Path.c_str(), Entry.RefCount);
+                return Entry.Model;
+            }
+        }
+    }
+
+    //Loads run unlocked so unrelated models load in parallel
+    llama_model* Model = llama_model_load_from_file(Path.c_str(), Params);
+    if (!Model)
+    {
+        return nullptr;
+    }
+
+    FScopeLock Lock(&Mutex);
+
+    //Another instance finished loading the same model meanwhile, keep theirs
+    for (FEntry& Entry : Entries)
+    {
+        if (Entry.Key == Key)
+        {
+            llama_model_free(Model);
+            Entry.RefCount++;
+            return Entry.Model;
+        }
+    }
+
+    FEntry& Entry = Entries.AddDefaulted_GetRef();
+    Entry.Key = Key;
+    Entry.Model = Model;
+    Entry.RefCount = 1;
+    return Model;
+}
+
+void FLlamaModelRegistry::Release(llama_model* Model)
+{
+    if (!Model)
+    {
+        return;
+    }
+
+    FScopeLock Lock(&Mutex);
+    for (int32 i = 0; i < Entries.Num(); i++)
+    {
+        if (Entries[i].Model == Model)
+        {
+            if (--Entries[i].RefCount <= 0)
+            {
+                llama_model_free(Model);
+                Entries.RemoveAtSwap(i);
+            }
+            return;
+        }
+    }
+
+    //Not handed out by the registry
+    llama_model_free(Model);
+}
+
+int32 FLlamaModelRegistry::GetRefCount(const llama_model* Model) const
+{
+    FScopeLock Lock(&Mutex);
+    for (const FEntry& Entry : Entries)
+    {
+        if (Entry.Model == Model)
+        {
+            return Entry.RefCount;
+        }
+    }
+    return 0;
+}
+
+int32 FLlamaModelRegistry::Num() const
+{
+    FScopeLock Lock(&Mutex);
+    return Entries.Num();
+}
+
+FLlamaModelRegistry::FEntry* FLlamaModelRegistry::FindEntry(const llama_model* Model)
+{
+    for (FEntry& Entry : Entries)
+    {
+        if (Entry.Model == Model)
+        {
+            return &Entry;
+        }
+    }
+    return nullptr;
+}
+
+llama_adapter_lora* FLlamaModelRegistry::AcquireLora(llama_model* Model, const std::string& Path)
+{
+    if (!Model)
+    {
+        return nullptr;
+    }
+
+    FString Key = FPaths::ConvertRelativePathToFull(UTF8_TO_TCHAR(Path.c_str()));
+    FPaths::NormalizeFilename(Key);
+    Key = Key.ToLower();
+    {
+        FScopeLock Lock(&Mutex);
+        if (FEntry* Entry = FindEntry(Model))
+        {
+            for (FLoraEntry& Lora : Entry->Adapters)
+            {
+                if (Lora.Key == Key)
+                {
+                    Lora.RefCount++;
+                    return Lora.Adapter;
+                }
+            }
+        }
+    }
+
+    llama_adapter_lora* Adapter = llama_adapter_lora_init(Model, Path.c_str());
+    if (!Adapter)
+    {
+        return nullptr;
+    }
+
+    FScopeLock Lock(&Mutex);
+    FEntry* Entry = FindEntry(Model);
+    if (!Entry)
+    {
+        //Model isn't registry owned, the caller owns the adapter too
+        return Adapter;
+    }
+    for (FLoraEntry& Lora : Entry->Adapters)
+    {
+        if (Lora.Key == Key)
+        {
+            llama_adapter_lora_free(Adapter);
+            Lora.RefCount++;
+            return Lora.Adapter;
+        }
+    }
+
+    FLoraEntry& Lora = Entry->Adapters.AddDefaulted_GetRef();
+    Lora.Key = Key;
+    Lora.Adapter = Adapter;
+    Lora.RefCount = 1;
+    return Adapter;
+}
+
+void FLlamaModelRegistry::ReleaseLora(llama_model* Model, llama_adapter_lora* Adapter)
+{
+    if (!Adapter)
+    {
+        return;
+    }
+
+    FScopeLock Lock(&Mutex);
+    if (FEntry* Entry = FindEntry(Model))
+    {
+        for (int32 i = 0; i < Entry->Adapters.Num(); i++)
+        {
+            if (Entry->Adapters[i].Adapter == Adapter)
+            {
+                if (--Entry->Adapters[i].RefCount <= 0)
+                {
+                    llama_adapter_lora_free(Adapter);
+                    Entry->Adapters.RemoveAtSwap(i);
+                }
+                return;
+            }
+        }
+    }
+
+    //Not handed out by the registry
+    llama_adapter_lora_free(Adapter);
+}
@@ -0,0 +1,185 @@
+// Copyright 2025-current Getnamo.
+
+#include "Internal/LlamaStopMatcher.h"
+
+void FLlamaStopSequenceMatcher::SetPatterns(const std::vector<std::string>& Patterns)
+{
+    //Trie: node 0 is the root, -1 marks a missing edge until the DFA fill below
+    Transitions.assign(256, -1);
+    Depth.assign(1, 0);
+    MatchLength.assign(1, 0);
+    bHasPatterns = false;
+
+    for (const std::string& Pattern : Patterns)
+    {
+        if (Pattern.empty())
+        {
+            continue;
+        }
+        bHasPatterns = true;
+
+        int32 Node = 0;
+        for (const char Char : Pattern)
+        {
+            const uint8 Byte = (uint8)Char;
+            if (Transitions[Node * 256 + Byte] < 0)
+            {
+                Transitions[Node * 256 + Byte] = Depth.size();
+                Transitions.resize(Transitions.size() + 256, -1);
+                Depth.push_back(Depth[Node] + 1);
+                MatchLength.push_back(0);
+            }
+            Node = Transitions[Node * 256 + Byte];
+        }
+        MatchLength[Node] = Pattern.size();
+    }
+
+    //BFS over the trie: fill missing edges from the failure node so every byte is one lookup, and inherit
+    //the longest match ending at the failure node (a pattern that is a suffix of this node's string)
+    const int32 NodeCount = Depth.size();
+    std::vector<int32> Fail(NodeCount, 0);
+    std::vector<int32> Queue;
+    Queue.reserve(NodeCount);
+
+    for (int32 Byte = 0; Byte < 256; Byte++)
+    {
+        int32& Next = Transitions[Byte];
+        if (Next < 0)
+        {
+            Next = 0;
+        }
+        else
+        {
+            Queue.push_back(Next);
+        }
+    }
+
+    for (int32 Head = 0; Head < (int32)Queue.size(); Head++)
+    {
+        const int32 Node = Queue[Head];
+        if (MatchLength[Node] == 0)
+        {
+            MatchLength[Node] = MatchLength[Fail[Node]];
+        }
+
+        for (int32 Byte = 0; Byte < 256; Byte++)
+        {
+            int32& Next = Transitions[Node * 256 + Byte];
+            const int32 FailNext = Transitions[Fail[Node] * 256 + Byte];
+            if (Next < 0)
+            {
+                Next = FailNext;
+            }
+            else
+            {
+                Fail[Next] = FailNext;
+                Queue.push_back(Next);
+            }
+        }
+    }
+
+    Reset();
+}
+
+void FLlamaStopSequenceMatcher::Reset()
+{
+    State = 0;
+    StreamOffset = 0;
+    Pending.clear();
+    Emitted.clear();
+    Marks.clear();
+    MatchTag = -1;
+    KeepTag = -1;
+}
+
+bool FLlamaStopSequenceMatcher::Feed(std::string_view Piece, int32 Tag)
+{
+    if (!bHasPatterns)
+    {
+        Emitted.assign(Piece.data(), Piece.size());
+        return false;
+    }
+
+    Emitted.clear();
+    Marks.push_back({ StreamOffset + (int64)Pending.size(), Tag });
+
+    for (const char Char : Piece)
+    {
+        Pending.push_back(Char);
+        State = Transitions[State * 256 + (uint8)Char];
+
+        if (MatchLength[State] > 0)
+        {
+            //Release everything before the match, the piece holding its first byte is where KV gets cut
+            const int32 MatchStart = Pending.size() - MatchLength[State];
+            const int64 MatchOffset = StreamOffset + MatchStart;
+            Emitted.assign(Pending, 0, MatchStart);
+
+            MatchTag = Marks[0].Tag;
+            for (const FPieceMark& Mark : Marks)
+            {
+                if (Mark.Offset > MatchOffset)
+                {
+                    break;
+                }
+                MatchTag = Mark.Tag;
+            }
+
+            //Pieces with released bytes before the match stay, a piece split by the match start included
+            KeepTag = Marks.back().Tag + 1;
+            for (const FPieceMark& Mark : Marks)
+            {
+                if (Mark.Offset >= MatchOffset)
+                {
+                    KeepTag = Mark.Tag;
+                    break;
+                }
+            }
+
+            StreamOffset = MatchOffset;
+            Pending.clear();
+            Marks.clear();
+            State = 0;
+            return true;
+        }
+    }
+
+    //Only the suffix that is still a pattern prefix (the node depth) needs holding back
+    const int32 Release = Pending.size() - Depth[State];
+    if (Release > 0)
+    {
+        Emitted.assign(Pending, 0, Release);
+        Pending.erase(0, Release);
+        StreamOffset += Release;
+    }
+
+    //Drop marks of pieces that were fully released, keeping the one Pending starts in
+    int32 FirstKept = 0;
+    while (FirstKept + 1 < (int32)Marks.size() && Marks[FirstKept + 1].Offset <= StreamOffset)
+    {
+        FirstKept++;
+    }
+    if (FirstKept > 0)
+    {
+        Marks.erase(Marks.begin(), Marks.begin() + FirstKept);
+    }
+    return false;
+}
+
+const std::string& FLlamaStopSequenceMatcher::Flush()
+{
+    Emitted.swap(Pending);
+    Pending.clear();
+    StreamOffset += Emitted.size();
+    Marks.clear();
+    State = 0;
+    return Emitted;
+}
+
+void FLlamaStopSequenceMatcher::OffsetTags(int32 Delta)
+{
+    for (FPieceMark& Mark : Marks)
+    {
+        Mark.Tag += Delta;
+    }
+}
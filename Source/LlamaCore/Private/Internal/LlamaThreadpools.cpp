@@ -0,0 +1,136 @@
+// Copyright 2025-current Getnamo.
+
+#include "Internal/LlamaThreadpools.h"
+#include "LlamaDataTypes.h"
+#include "LlamaUtility.h"
+#include "llama.h"
+#include "ggml-backend.h"
+
+#include <cstring>
+
+namespace
+{
+    typedef ggml_threadpool_t (*FThreadpoolNewFn)(ggml_threadpool_params*);
+    typedef void (*FThreadpoolFreeFn)(ggml_threadpool_t);
+
+    //Looked up through the CPU backend registry like llama.cpp's tools do, so dynamically loaded backends work too
+    static void* GetCpuProc(const char* Name)
+    {
+        ggml_backend_dev_t CpuDevice = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+        if (!CpuDevice)
+        {
+            return nullptr;
+        }
+        return ggml_backend_reg_get_proc_address(ggml_backend_dev_backend_reg(CpuDevice), Name);
+    }
+
+    static ggml_threadpool_params MakePoolParams(const FLLMThreadingParams& Params, int32 NThreads)
+    {
+        ggml_threadpool_params PoolParams = ggml_threadpool_params_default(NThreads);
+        for (const int32 Core : Params.CPUAffinityCores)
+        {
+            if (Core >= 0 && Core < GGML_MAX_N_THREADS)
+            {
+                PoolParams.cpumask[Core] = true;
+            }
+        }
+        PoolParams.strict_cpu = Params.bStrictCPUPlacement && Params.CPUAffinityCores.Num() > 0;
+        PoolParams.poll = (uint32_t)FMath::Clamp(Params.PollLevel, 0, 100);
+        return PoolParams;
+    }
+}
+
+FLlamaThreadpools::~FLlamaThreadpools()
+{
+    Reset();
+}
+
+bool FLlamaThreadpools::Configure(const FLLMThreadingParams& Params, int32 DefaultThreads)
+{
+    DefaultThreads = FMath::Max(DefaultThreads, 1);
+    const int32 NewDecodeThreads = Params.DecodeThreads > 0 ? Params.DecodeThreads : DefaultThreads;
+    const int32 NewPrefillThreads = Params.PrefillThreads > 0 ? Params.PrefillThreads : DefaultThreads;
+
+    const ggml_threadpool_params NewDecodeParams = MakePoolParams(Params, NewDecodeThreads);
+    const ggml_threadpool_params NewPrefillParams = MakePoolParams(Params, NewPrefillThreads);
+
+    //Same settings as the last load, keep the running threads
+    if (DecodePool && ggml_threadpool_params_match(&NewDecodeParams, &DecodePoolParams) &&
+        ggml_threadpool_params_match(&NewPrefillParams, &PrefillPoolParams))
+    {
+        return true;
+    }
+
+    Reset();
+    DecodeThreads = NewDecodeThreads;
+    PrefillThreads = NewPrefillThreads;
+
+    FThreadpoolNewFn ThreadpoolNew = (FThreadpoolNewFn)GetCpuProc("ggml_threadpool_new");
+    if (!ThreadpoolNew)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("CPU backend doesn't export ggml_threadpool_new, using default threading."));
+        return false;
+    }
+
+    DecodePoolParams = NewDecodeParams;
+    PrefillPoolParams = NewPrefillParams;
+
+    DecodePool = ThreadpoolNew(&DecodePoolParams);
+    if (!DecodePool)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Failed to create a %d thread decode threadpool, using default threading."), DecodeThreads);
+        return false;
+    }
+
+    if (ggml_threadpool_params_match(&DecodePoolParams, &PrefillPoolParams))
+    {
+        PrefillPool = DecodePool;
+    }
+    else
+    {
+        //Starts paused, ggml resumes a pool when a graph is computed on it
+        PrefillPoolParams.paused = true;
+        PrefillPool = ThreadpoolNew(&PrefillPoolParams);
+        PrefillPoolParams.paused = false;
+        if (!PrefillPool)
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("Failed to create a %d thread prefill threadpool, prefill uses the decode pool."), PrefillThreads);
+            PrefillPool = DecodePool;
+            PrefillThreads = DecodeThreads;
+        }
+    }
+
+    UE_LOG(LlamaLog, Log, TEXT("Threadpools: %d decode / %d prefill threads, %d affinity cores%s, poll %d"),
+        DecodeThreads, PrefillThreads, Params.CPUAffinityCores.Num(), DecodePoolParams.strict_cpu ? TEXT(" (strict)") : TEXT(""), (int32)DecodePoolParams.poll);
+    return true;
+}
+
+void FLlamaThreadpools::Attach(llama_context* Context) const
+{
+    if (Context && DecodePool)
+    {
+        llama_attach_threadpool(Context, DecodePool, PrefillPool);
+    }
+}
+
+void FLlamaThreadpools::Reset()
+{
+    FThreadpoolFreeFn ThreadpoolFree = (DecodePool || PrefillPool) ? (FThreadpoolFreeFn)GetCpuProc("ggml_threadpool_free") : nullptr;
+    if (ThreadpoolFree)
+    {
+        if (PrefillPool && PrefillPool != DecodePool)
+        {
+            ThreadpoolFree(PrefillPool);
+        }
+        if (DecodePool)
+        {
+            ThreadpoolFree(DecodePool);
+        }
+    }
+    DecodePool = nullptr;
+    PrefillPool = nullptr;
+    FMemory::Memzero(DecodePoolParams);
+    FMemory::Memzero(PrefillPoolParams);
+    DecodeThreads = 0;
+    PrefillThreads = 0;
+}
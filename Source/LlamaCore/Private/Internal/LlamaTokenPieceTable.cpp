@@ -0,0 +1,56 @@
+// Copyright 2025-current Getnamo.
+
+#include "Internal/LlamaTokenPieceTable.h"
+#include "llama.h"
+
+void FLlamaTokenPieceTable::Build(const llama_vocab* Vocab)
+{
+    Reset();
+    if (!Vocab)
+    {
+        return;
+    }
+
+    const int32 NVocab = llama_vocab_n_tokens(Vocab);
+    Offsets.reserve(NVocab + 1);
+    Bytes.reserve(NVocab * 8);
+
+    //Most pieces fit the stack buffer, longer ones report their size and are written in place
+    char StackBuf[128];
+    Offsets.push_back(0);
+    for (int32 Token = 0; Token < NVocab; Token++)
+    {
+        const int32 Wrote = llama_token_to_piece(Vocab, Token, StackBuf, (int32)sizeof(StackBuf), /*lstrip*/ 0, /*special*/ true);
+        if (Wrote >= 0)
+        {
+            Bytes.insert(Bytes.end(), StackBuf, StackBuf + Wrote);
+        }
+        else
+        {
+            const size_t Start = Bytes.size();
+            Bytes.resize(Start - Wrote);
+            const int32 Wrote2 = llama_token_to_piece(Vocab, Token, Bytes.data() + Start, -Wrote, 0, true);
+            Bytes.resize(Start + FMath::Clamp(Wrote2, 0, -Wrote));
+        }
+        Offsets.push_back(Bytes.size());
+    }
+    Bytes.shrink_to_fit();
+}
+
+void FLlamaTokenPieceTable::BuildFromPieces(const std::vector<std::string>& Pieces)
+{
+    Reset();
+    Offsets.reserve(Pieces.size() + 1);
+    Offsets.push_back(0);
+    for (const std::string& Piece : Pieces)
+    {
+        Bytes.insert(Bytes.end(), Piece.begin(), Piece.end());
+        Offsets.push_back(Bytes.size());
+    }
+}
+
+void FLlamaTokenPieceTable::Reset()
+{
+    Bytes.clear();
+    Offsets.clear();
+}
@@ -71,6 +71,10 @@ void ULlamaComponent::WireBackendCallbacks()
     {
         OnPromptProcessed.Broadcast(Tokens, Role, Speed);
     };
+    Backend->OnPromptProgress = [this](int32 Done, int32 Total)
+    {
+        OnPromptProgress.Broadcast(Done, Total);
+    };
     Backend->OnEndOfStream = [this](bool bStopSeq, float Tps)
     {
         OnEndOfStream.Broadcast(bStopSeq, Tps);
@@ -83,6 +87,10 @@ void ULlamaComponent::WireBackendCallbacks()
     {
         OnModelLoaded.Broadcast(ModelName);
     };
+    Backend->OnModelLoadProgress = [this](float Progress)
+    {
+        OnModelLoadProgress.Broadcast(Progress);
+    };
     Backend->OnError = [this](const FString& Err, int32 Code)
     {
         OnError.Broadcast(Err, Code);
@@ -162,6 +170,11 @@ void ULlamaComponent::UnloadModel()
     if (Backend) Backend->UnloadModel();
 }
 
+void ULlamaComponent::CancelLoadModel()
+{
+    if (Backend) Backend->CancelLoadModel();
+}
+
 bool ULlamaComponent::IsModelLoaded() const
 {
     return Backend && Backend->IsModelLoaded();
@@ -114,6 +114,14 @@ void FLlamaDualBackend::HookNativeCallbacks()
     {
         if (OnPromptProcessed) OnPromptProcessed(Tokens, Role, Speed);
     };
+    LlamaNative->OnPromptProgress = [this](int32 Done, int32 Total)
+    {
+        if (OnPromptProgress) OnPromptProgress(Done, Total);
+    };
+    LlamaNative->OnModelLoadProgress = [this](float Progress)
+    {
+        if (OnModelLoadProgress) OnModelLoadProgress(Progress);
+    };
     LlamaNative->OnError = [this](const FString& Err, int32 Code)
     {
         if (OnError) OnError(Err, Code);
@@ -347,6 +355,11 @@ void FLlamaDualBackend::LoadModel(bool bForceReload)
     }
 }
 
+void FLlamaDualBackend::CancelLoadModel()
+{
+    if (LlamaNative) LlamaNative->CancelLoadModel();
+}
+
 void FLlamaDualBackend::UnloadModel()
 {
     if (!bUseRemote)
@@ -394,8 +407,18 @@ void FLlamaDualBackend::InsertTemplatedPrompt(const FLlamaChatPrompt& Prompt)
         //TODO: support OpenAI-compatible assistant-turn continuation for prefill in remote mode.
         UE_LOG(LlamaLog, Warning, TEXT("AssistantPrefill is currently only honored in local mode; ignored for remote backend."));
     }
+    if (Prompt.bOverrideLoraAdapters)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("LoraAdapters are only honored in local mode; ignored for remote backend."));
+    }
     AppendUserMessage(Prompt.Prompt, Prompt.Role);
+    PendingGrammar = Prompt.Grammar;
+    PendingJsonSchema = Prompt.JsonSchema;
+    if (Prompt.bOverrideSampling) PendingSampling = Prompt.SamplingOverride;
     if (Prompt.bGenerateReply) BeginStreamFromHistory(true);
+    PendingGrammar.Reset();
+    PendingJsonSchema.Reset();
+    PendingSampling.Reset();
 }
 
 void FLlamaDualBackend::InsertRawPrompt(const FString& Text, bool bGenerateReply)
@@ -1010,6 +1033,12 @@ void FLlamaDualBackend::BeginStreamFromHistory(bool bAttachPendingMedia)
         Req.UserMedia = MoveTemp(PendingUserMedia);
         PendingUserMedia.Reset();
     }
+    Req.Grammar = PendingGrammar;
+    Req.JsonSchema = PendingJsonSchema;
+    if (PendingSampling.IsSet())
+    {
+        Req.Params.Advanced.Sampling = PendingSampling.GetValue();
+    }
 
     // Pre-append empty Assistant message for live streaming append.
     FStructuredChatMessage Assistant;
@@ -7,15 +7,32 @@
 #include "Async/TaskGraphInterfaces.h"
 #include "Async/Async.h"
 #include "Tickable.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 
 FLlamaNative::FLlamaNative()
 {
     Internal = new FLlamaInternal();
 
     //Hookup internal listeners - these get called on BG thread
-    Internal->OnTokenGenerated = [this](const std::string& TokenPiece)
+    Internal->OnTokenGenerated = [this](std::string_view TokenPiece)
     {
         const FString Token = FLlamaString::ToUE(TokenPiece);
+        const int32 SlotId = Internal->ActiveSlotId;
+
+        //Non-default slots only stream through the slot callbacks; partial/markdown state belongs to slot 0
+        if (SlotId != 0)
+        {
+            EnqueueGTTask([this, SlotId, Token]()
+            {
+                if (OnSlotTokenGenerated)
+                {
+                    OnSlotTokenGenerated(SlotId, Token);
+                }
+            });
+            return;
+        }
 
         //Accumulate
         CombinedPieceText += Token;
@@ -76,6 +93,10 @@ FLlamaNative::FLlamaNative()
             {
                 OnTokenGenerated(Token);
             }
+            if (OnSlotTokenGenerated)
+            {
+                OnSlotTokenGenerated(0, Token);
+            }
             if (OnPartialGenerated && !Partial.IsEmpty())
             {
                 OnPartialGenerated(Partial);
@@ -93,11 +114,46 @@ FLlamaNative::FLlamaNative()
         });
     };
 
+    Internal->OnCandidateTokenGenerated = [this](int32 CandidateIndex, std::string_view TokenPiece)
+    {
+        const FString Token = FLlamaString::ToUE(TokenPiece);
+        EnqueueGTTask([this, CandidateIndex, Token]()
+        {
+            if (OnCandidateTokenGenerated)
+            {
+                OnCandidateTokenGenerated(CandidateIndex, Token);
+            }
+        });
+    };
+
     Internal->OnGenerationComplete = [this](const std::string& Response, float Duration, int32 TokensGenerated, float SpeedTps)
     {
+        const int32 SlotId = Internal->ActiveSlotId;
+
         if (ModelParams.Advanced.Output.bLogGenerationStats)
         {
-            UE_LOG(LlamaLog, Log, TEXT("TGS - Generated %d tokens in %1.2fs (%1.2ftps)"), TokensGenerated, Duration, SpeedTps);
+            UE_LOG(LlamaLog, Log, TEXT("TGS - Slot %d generated %d tokens in %1.2fs (%1.2ftps)"), SlotId, TokensGenerated, Duration, SpeedTps);
+
+            const FLlamaRunTimings& RunTimings = Internal->LastRunTimings;
+            if (RunTimings.DraftTokensProposed > 0)
+            {
+                UE_LOG(LlamaLog, Log, TEXT("TGS - Slot %d draft accepted %d/%d tokens (%1.0f%%)"), SlotId,
+                    RunTimings.DraftTokensAccepted, RunTimings.DraftTokensProposed, RunTimings.DraftAcceptanceRate * 100.f);
+            }
+        }
+
+        //GT ModelState mirrors slot 0 only, other slots just get their response forwarded
+        if (SlotId != 0)
+        {
+            const FString SlotResponse = FLlamaString::ToUE(Response);
+            EnqueueGTTask([this, SlotId, SlotResponse]
+            {
+                if (OnSlotResponseGenerated)
+                {
+                    OnSlotResponseGenerated(SlotId, SlotResponse);
+                }
+            });
+            return;
         }
 
         int32 UsedContext = UsedContextLength();
@@ -131,7 +187,8 @@ FLlamaNative::FLlamaNative()
 
         //Emit response generated to general listeners
         FString ResponseString = FLlamaString::ToUE(Response);
-        EnqueueGTTask([this, ResponseString, Partial, MdFinalPartials]
+        const FLlamaRunTimings Timings = Internal->LastRunTimings;
+        EnqueueGTTask([this, ResponseString, Partial, MdFinalPartials, Timings]
         {
             //ensure partials are fully emitted too
             if (OnPartialGenerated && !Partial.IsEmpty())
@@ -152,6 +209,14 @@ FLlamaNative::FLlamaNative()
             {
                 OnResponseGenerated(ResponseString);
             }
+            if (OnSlotResponseGenerated)
+            {
+                OnSlotResponseGenerated(0, ResponseString);
+            }
+            if (OnGenerationFinished)
+            {
+                OnGenerationFinished(Timings);
+            }
         });
     };
 
@@ -162,6 +227,12 @@ FLlamaNative::FLlamaNative()
             UE_LOG(LlamaLog, Log, TEXT("PPS - Processed %d tokens at %1.2ftps"), TokensProcessed, SpeedTps);
         }
 
+        //Slot prompts don't touch the slot 0 GT model state
+        if (Internal->ActiveSlotId != 0)
+        {
+            return;
+        }
+
         int32 UsedContext = UsedContextLength();
 
         //Sync history data with additional state updates
@@ -181,6 +252,34 @@ FLlamaNative::FLlamaNative()
         });
     };
 
+    Internal->OnLoadProgress = [this](float Progress)
+    {
+        EnqueueGTTask([this, Progress]
+        {
+            if (OnModelLoadProgress)
+            {
+                OnModelLoadProgress(Progress);
+            }
+        });
+    };
+
+    Internal->OnPromptProgress = [this](int32 TokensDone, int32 TokensTotal)
+    {
+        //Slot prompts don't report on the slot 0 GT listeners, same as OnPromptProcessed
+        if (Internal->ActiveSlotId != 0)
+        {
+            return;
+        }
+
+        EnqueueGTTask([this, TokensDone, TokensTotal]
+        {
+            if (OnPromptProgress)
+            {
+                OnPromptProgress(TokensDone, TokensTotal);
+            }
+        });
+    };
+
     Internal->OnError = [this](const FString& ErrorMessage, int32 ErrorCode)
     {
         const FString ErrorMessageGTSafe = ErrorMessage;
@@ -279,6 +378,13 @@ void FLlamaNative::StartLLMThread()
                 }
             }
 
+            //Continuous batching: one decode for all active slots per loop, tasks get checked in between steps
+            if (Internal->HasScheduledWork())
+            {
+                Internal->StepScheduledSlots();
+                continue;
+            }
+
             FPlatformProcess::Sleep(ThreadIdleSleepDuration);
         }
 
@@ -341,6 +447,7 @@ void FLlamaNative::LoadModel(bool bForceReload, TFunction<void(const FString&, i
         return ModelLoadedCallback(ModelParams.PathToModel, 0);
     }
     bModelLoadInitiated = true;
+    Internal->bLoadCancelRequested = false;
 
     //Copy so these dont get modified during enqueue op
     const FLLMModelParams ParamsAtLoad = ModelParams;
@@ -358,16 +465,24 @@ void FLlamaNative::LoadModel(bool bForceReload, TFunction<void(const FString&, i
         {
             const FString TemplateString = FLlamaString::ToUE(Internal->Template);
             const FString TemplateSource = FLlamaString::ToUE(Internal->TemplateSource);
+            FLlamaLoadTimings LoadTimings = Internal->LastLoadTimings;
 
             //Before we release the BG thread, ensure we enqueue the system prompt
             //If we do it later, other queued calls will frontrun it. This enables startup chaining correctly
             if (ParamsAtLoad.bAutoInsertSystemPromptOnLoad)
             {
-                Internal->InsertTemplatedPrompt(FLlamaString::ToStd(ParamsAtLoad.SystemPrompt), EChatTemplateRole::System, false, false);
+                const double SystemPromptStart = FPlatformTime::Seconds();
+                const std::string SystemPrompt = FLlamaString::ToStd(ParamsAtLoad.SystemPrompt);
+                for (int32 SlotId = 0; SlotId < Internal->NumSlots(); SlotId++)
+                {
+                    Internal->InsertTemplatedPrompt(SystemPrompt, EChatTemplateRole::System, false, false, std::string(), SlotId);
+                }
+                LoadTimings.SystemPromptTime = FPlatformTime::Seconds() - SystemPromptStart;
+                LoadTimings.TotalTime += LoadTimings.SystemPromptTime;
             }
 
             //Callback on game thread for data sync
-            EnqueueGTTask([this, TemplateString, TemplateSource, ModelLoadedCallback]
+            EnqueueGTTask([this, TemplateString, TemplateSource, LoadTimings, ModelLoadedCallback]
             {
                 FJinjaChatTemplate ChatTemplate;
                 ChatTemplate.TemplateSource = TemplateSource;
@@ -375,6 +490,7 @@ void FLlamaNative::LoadModel(bool bForceReload, TFunction<void(const FString&, i
 
                 ModelState.ChatTemplateInUse = ChatTemplate;
                 ModelState.bModelIsLoaded = true;
+                ModelState.LastLoadTimings = LoadTimings;
 
                 bModelLoadInitiated = false;
 
@@ -391,24 +507,34 @@ void FLlamaNative::LoadModel(bool bForceReload, TFunction<void(const FString&, i
         }
         else
         {
-            EnqueueGTTask([this, ModelLoadedCallback]
+            //Cancelled loads don't raise OnError, they only report their own status
+            const int32 StatusCode = Internal->bLastLoadCancelled ? 16 : 15;
+            EnqueueGTTask([this, ModelLoadedCallback, StatusCode]
             {
                 bModelLoadInitiated = false;
 
                 //On error will be triggered earlier in the chain, but forward our model loading error status here
                 if (ModelLoadedCallback)
                 {
-                    ModelLoadedCallback(ModelParams.PathToModel, 15);
+                    ModelLoadedCallback(ModelParams.PathToModel, StatusCode);
                 }
             }, TaskId);
         }
     });
 }
 
+void FLlamaNative::CancelLoadModel()
+{
+    Internal->bLoadCancelRequested = true;
+}
+
 void FLlamaNative::UnloadModel(TFunction<void(int32 StatusCode)> ModelUnloadedCallback)
 {
     bModelLoadInitiated = false;
 
+    //A load still queued or running would only be unloaded again
+    Internal->bLoadCancelRequested = true;
+
     EnqueueBGTask([this, ModelUnloadedCallback](int64 TaskId)
     {
         if (IsModelLoaded())
@@ -453,13 +579,48 @@ void FLlamaNative::InsertTemplatedPrompt(const FLlamaChatPrompt& Prompt, TFuncti
     //run prompt insert on a background thread
     EnqueueBGTask([this, ThreadSafePrompt, OnResponseFinished](int64 TaskId)
     {
+        //With several slots loaded slot 0 joins the shared batch instead of blocking the other conversations
+        if (Internal->NumSlots() > 1)
+        {
+            SchedulePromptInSlot(0, ThreadSafePrompt, OnResponseFinished);
+            return;
+        }
+
         const std::string UserStdString = FLlamaString::ToStd(ThreadSafePrompt.Prompt);
         const std::string PrefillStdString = FLlamaString::ToStd(ThreadSafePrompt.AssistantPrefill);
 
         if (ThreadSafePrompt.bGenerateReply)
         {
+            //Grammar constrains this reply only
+            const bool bConstrained = !ThreadSafePrompt.Grammar.IsEmpty() || !ThreadSafePrompt.JsonSchema.IsEmpty();
+            if (bConstrained)
+            {
+                Internal->SetSlotGrammar(FLlamaString::ToStd(ThreadSafePrompt.Grammar), FLlamaString::ToStd(ThreadSafePrompt.JsonSchema));
+            }
+            if (ThreadSafePrompt.bOverrideSampling)
+            {
+                Internal->SetSlotSampling(&ThreadSafePrompt.SamplingOverride);
+            }
+            if (ThreadSafePrompt.bOverrideLoraAdapters)
+            {
+                Internal->SetSlotLoraOverride(&ThreadSafePrompt.LoraAdapters);
+            }
+
             FString Response = FLlamaString::ToUE(Internal->InsertTemplatedPrompt(UserStdString, ThreadSafePrompt.Role, ThreadSafePrompt.bAddAssistantBOS, true, PrefillStdString));
 
+            if (bConstrained)
+            {
+                Internal->SetSlotGrammar("");
+            }
+            if (ThreadSafePrompt.bOverrideSampling)
+            {
+                Internal->SetSlotSampling(nullptr);
+            }
+            if (ThreadSafePrompt.bOverrideLoraAdapters)
+            {
+                Internal->SetSlotLoraOverride(nullptr);
+            }
+
             //NB: OnResponseGenerated will also be called separately from this
             EnqueueGTTask([this, Response, OnResponseFinished]()
             {
@@ -472,11 +633,114 @@ void FLlamaNative::InsertTemplatedPrompt(const FLlamaChatPrompt& Prompt, TFuncti
         else
         {
             //We don't want to generate a reply, just append a prompt. (last param = false turns it off)
+            if (ThreadSafePrompt.bOverrideLoraAdapters)
+            {
+                Internal->SetSlotLoraOverride(&ThreadSafePrompt.LoraAdapters);
+            }
             Internal->InsertTemplatedPrompt(UserStdString, ThreadSafePrompt.Role, ThreadSafePrompt.bAddAssistantBOS, false, PrefillStdString);
+            if (ThreadSafePrompt.bOverrideLoraAdapters)
+            {
+                Internal->SetSlotLoraOverride(nullptr);
+            }
+        }
+    });
+}
+
+void FLlamaNative::InsertTemplatedPromptInSlot(int32 SlotId, const FLlamaChatPrompt& Prompt, TFunction<void(const FString& Response)> OnResponseFinished)
+{
+    if (!IsModelLoaded() && !bModelLoadInitiated)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded, can't run prompt."));
+        return;
+    }
+
+    FLlamaChatPrompt ThreadSafePrompt = Prompt;
+
+    EnqueueBGTask([this, SlotId, ThreadSafePrompt, OnResponseFinished](int64 TaskId)
+    {
+        SchedulePromptInSlot(SlotId, ThreadSafePrompt, OnResponseFinished);
+    });
+}
+
+void FLlamaNative::SchedulePromptInSlot(int32 SlotId, const FLlamaChatPrompt& Prompt, TFunction<void(const FString& Response)> OnResponseFinished)
+{
+    FLlamaScheduledPrompt ScheduledPrompt;
+    ScheduledPrompt.Prompt = FLlamaString::ToStd(Prompt.Prompt);
+    ScheduledPrompt.Role = Prompt.Role;
+    ScheduledPrompt.bAddAssistantBoS = Prompt.bAddAssistantBOS;
+    ScheduledPrompt.bGenerateReply = Prompt.bGenerateReply;
+    ScheduledPrompt.AssistantPrefill = FLlamaString::ToStd(Prompt.AssistantPrefill);
+    ScheduledPrompt.Grammar = FLlamaString::ToStd(Prompt.Grammar);
+    ScheduledPrompt.JsonSchema = FLlamaString::ToStd(Prompt.JsonSchema);
+    ScheduledPrompt.bOverrideSampling = Prompt.bOverrideSampling;
+    ScheduledPrompt.SamplingOverride = Prompt.SamplingOverride;
+    ScheduledPrompt.bOverrideLoraAdapters = Prompt.bOverrideLoraAdapters;
+    ScheduledPrompt.LoraAdapters = Prompt.LoraAdapters;
+
+    if (OnResponseFinished)
+    {
+        //Fires on BT when the scheduler finishes this reply
+        ScheduledPrompt.OnReplyFinished = [this, OnResponseFinished](const std::string& Response)
+        {
+            const FString ResponseString = FLlamaString::ToUE(Response);
+            EnqueueGTTask([ResponseString, OnResponseFinished]()
+            {
+                OnResponseFinished(ResponseString);
+            });
+        };
+    }
+
+    Internal->ScheduleTemplatedPrompt(ScheduledPrompt, SlotId);
+}
+
+void FLlamaNative::ResetSlotContextHistory(int32 SlotId, bool bKeepSystemPrompt)
+{
+    EnqueueBGTask([this, SlotId, bKeepSystemPrompt](int64 TaskId)
+    {
+        Internal->ResetContextHistory(bKeepSystemPrompt, SlotId);
+
+        if (SlotId == 0)
+        {
+            SyncModelStateToInternal();
         }
     });
 }
 
+void FLlamaNative::RemoveLastNMessagesInSlot(int32 SlotId, int32 MessageCount)
+{
+    EnqueueBGTask([this, SlotId, MessageCount](int64 TaskId)
+    {
+        Internal->RollbackContextHistoryByMessages(MessageCount, SlotId);
+
+        if (SlotId == 0)
+        {
+            SyncModelStateToInternal();
+        }
+    });
+}
+
+void FLlamaNative::GetSlotChatHistory(int32 SlotId, TFunction<void(const FStructuredChatHistory& History)> OnHistory)
+{
+    EnqueueBGTask([this, SlotId, OnHistory](int64 TaskId)
+    {
+        FStructuredChatHistory History;
+        GetStructuredChatHistory(History, SlotId);
+
+        EnqueueGTTask([History, OnHistory]
+        {
+            if (OnHistory)
+            {
+                OnHistory(History);
+            }
+        }, TaskId);
+    });
+}
+
+int32 FLlamaNative::GetConversationSlotCount() const
+{
+    return Internal->NumSlots();
+}
+
 void FLlamaNative::InsertMultimodalPrompt(const FLlamaMultimodalPrompt& Prompt, TFunction<void(const FString& Response)> OnResponseFinished)
 {
     if (!IsModelLoaded() && !bModelLoadInitiated)
@@ -584,6 +848,218 @@ void FLlamaNative::RebuildContextFromHistory(const FStructuredChatHistory& Histo
     });
 }
 
+void FLlamaNative::SaveSessionState(const FString& FilePath, bool bCompress, TFunction<void(bool bSuccess)> OnDone, int32 SlotId)
+{
+    if (!IsModelLoaded())
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("SaveSessionState: model not loaded, ignoring."));
+        return;
+    }
+
+    const FString FullPath = FLlamaPaths::ParsePathIntoFullPath(FilePath);
+
+    EnqueueBGTask([this, FullPath, bCompress, OnDone, SlotId](int64 TaskId)
+    {
+        TArray<uint8> Data;
+        bool bSuccess = Internal->SaveSlotState(Data, bCompress, SlotId);
+        if (bSuccess)
+        {
+            const FString DirOnly = FPaths::GetPath(FullPath);
+            if (!DirOnly.IsEmpty())
+            {
+                IFileManager::Get().MakeDirectory(*DirOnly, /*Tree*/ true);
+            }
+            bSuccess = FFileHelper::SaveArrayToFile(Data, *FullPath);
+            if (!bSuccess)
+            {
+                UE_LOG(LlamaLog, Warning, TEXT("SaveSessionState: could not write %s"), *FullPath);
+            }
+        }
+
+        EnqueueGTTask([OnDone, bSuccess]
+        {
+            if (OnDone)
+            {
+                OnDone(bSuccess);
+            }
+        });
+    });
+}
+
+void FLlamaNative::LoadSessionState(const FString& FilePath, TFunction<void(bool bSuccess)> OnDone, int32 SlotId)
+{
+    if (!IsModelLoaded() && !bModelLoadInitiated)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("LoadSessionState: model not loaded, ignoring."));
+        return;
+    }
+
+    const FString FullPath = FLlamaPaths::ParsePathIntoFullPath(FilePath);
+
+    EnqueueBGTask([this, FullPath, OnDone, SlotId](int64 TaskId)
+    {
+        TArray<uint8> Data;
+        bool bSuccess = FFileHelper::LoadFileToArray(Data, *FullPath);
+        if (!bSuccess)
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("LoadSessionState: could not read %s"), *FullPath);
+        }
+        else
+        {
+            bSuccess = Internal->LoadSlotState(Data, SlotId);
+        }
+
+        //Sync GT model state, then dispatch user callback
+        SyncModelStateToInternal([OnDone, bSuccess]
+        {
+            if (OnDone)
+            {
+                OnDone(bSuccess);
+            }
+        });
+    });
+}
+
+int32 FLlamaNative::SnapshotState(int32 SlotId)
+{
+    if (!IsModelLoaded() && !bModelLoadInitiated)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("SnapshotState: model not loaded, ignoring."));
+        return -1;
+    }
+
+    const int32 Handle = SnapshotHandleCounter.Increment();
+
+    EnqueueBGTask([this, Handle, SlotId](int64 TaskId)
+    {
+        Internal->SnapshotSlot(Handle, SlotId);
+    });
+    return Handle;
+}
+
+void FLlamaNative::RestoreSnapshot(int32 Handle, TFunction<void(bool bSuccess)> OnDone, int32 SlotId)
+{
+    EnqueueBGTask([this, Handle, OnDone, SlotId](int64 TaskId)
+    {
+        const bool bSuccess = Internal->RestoreSnapshot(Handle, SlotId);
+
+        //Sync GT model state, then dispatch user callback
+        SyncModelStateToInternal([OnDone, bSuccess]
+        {
+            if (OnDone)
+            {
+                OnDone(bSuccess);
+            }
+        });
+    });
+}
+
+void FLlamaNative::ReleaseSnapshot(int32 Handle)
+{
+    EnqueueBGTask([this, Handle](int64 TaskId)
+    {
+        Internal->ReleaseSnapshot(Handle);
+    });
+}
+
+void FLlamaNative::SetLoraAdapters(const TArray<FLlamaLoraAdapterScale>& Adapters, int32 SlotId)
+{
+    EnqueueBGTask([this, Adapters, SlotId](int64 TaskId)
+    {
+        Internal->SetSlotLoraAdapters(&Adapters, SlotId);
+    });
+}
+
+void FLlamaNative::ResetLoraAdapters(int32 SlotId)
+{
+    EnqueueBGTask([this, SlotId](int64 TaskId)
+    {
+        Internal->SetSlotLoraAdapters(nullptr, SlotId);
+    });
+}
+
+void FLlamaNative::InsertTemplatedPromptCandidates(const FLlamaChatPrompt& Prompt, int32 NumCandidates, TFunction<void(const TArray<FString>& Candidates)> OnCandidatesFinished, int32 SlotId)
+{
+    if (!IsModelLoaded() && !bModelLoadInitiated)
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded, can't run prompt."));
+        return;
+    }
+
+    FLlamaChatPrompt ThreadSafePrompt = Prompt;
+
+    EnqueueBGTask([this, ThreadSafePrompt, NumCandidates, OnCandidatesFinished, SlotId](int64 TaskId)
+    {
+        if (!Internal->IsModelLoaded())
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded, can't run prompt."));
+            return;
+        }
+
+        //Grammar, sampling and LoRA overrides apply to every candidate of this prompt
+        const bool bConstrained = !ThreadSafePrompt.Grammar.IsEmpty() || !ThreadSafePrompt.JsonSchema.IsEmpty();
+        if (bConstrained)
+        {
+            Internal->SetSlotGrammar(FLlamaString::ToStd(ThreadSafePrompt.Grammar), FLlamaString::ToStd(ThreadSafePrompt.JsonSchema), SlotId);
+        }
+        if (ThreadSafePrompt.bOverrideSampling)
+        {
+            Internal->SetSlotSampling(&ThreadSafePrompt.SamplingOverride, SlotId);
+        }
+        if (ThreadSafePrompt.bOverrideLoraAdapters)
+        {
+            Internal->SetSlotLoraOverride(&ThreadSafePrompt.LoraAdapters, SlotId);
+        }
+
+        const std::vector<std::string> Responses = Internal->InsertTemplatedPromptCandidates(
+            FLlamaString::ToStd(ThreadSafePrompt.Prompt), ThreadSafePrompt.Role, NumCandidates, FLlamaString::ToStd(ThreadSafePrompt.AssistantPrefill), SlotId);
+
+        if (bConstrained)
+        {
+            Internal->SetSlotGrammar("", "", SlotId);
+        }
+        if (ThreadSafePrompt.bOverrideSampling)
+        {
+            Internal->SetSlotSampling(nullptr, SlotId);
+        }
+        if (ThreadSafePrompt.bOverrideLoraAdapters)
+        {
+            Internal->SetSlotLoraOverride(nullptr, SlotId);
+        }
+
+        TArray<FString> Candidates;
+        for (const std::string& Response : Responses)
+        {
+            Candidates.Add(FLlamaString::ToUE(Response));
+        }
+
+        EnqueueGTTask([Candidates, OnCandidatesFinished]()
+        {
+            if (OnCandidatesFinished)
+            {
+                OnCandidatesFinished(Candidates);
+            }
+        });
+    });
+}
+
+void FLlamaNative::SelectReplyCandidate(int32 CandidateIndex, TFunction<void(bool bSuccess)> OnDone, int32 SlotId)
+{
+    EnqueueBGTask([this, CandidateIndex, OnDone, SlotId](int64 TaskId)
+    {
+        const bool bSuccess = Internal->SelectReplyCandidate(CandidateIndex, SlotId);
+
+        //Sync GT model state, then dispatch user callback
+        SyncModelStateToInternal([OnDone, bSuccess]
+        {
+            if (OnDone)
+            {
+                OnDone(bSuccess);
+            }
+        });
+    });
+}
+
 void FLlamaNative::ImpersonateTemplatedPrompt(const FLlamaChatPrompt& Prompt)
 {
     //modify model state
@@ -740,7 +1216,7 @@ void FLlamaNative::RemoveLastNTokens(int32 TokensCount)
 bool FLlamaNative::IsGenerating()
 {
     //this is threadsafe
-    return Internal->IsGenerating();
+    return Internal->IsGenerating() || Internal->HasScheduledWork();
 }
 
 void FLlamaNative::StopGeneration()
@@ -844,30 +1320,49 @@ void FLlamaNative::RemoveLastReply()
 
 void FLlamaNative::RegenerateLastReply()
 {
-    RemoveLastReply();
-    //Change seed?
-    ResumeGeneration();
+    if (!IsModelLoaded())
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("Model isn't loaded, can't RegenerateLastReply."));
+        return;
+    }
+
+    EnqueueBGTask([this](int64 TaskId)
+    {
+        //Cuts KV back to the reply start via the token mirror, no re-tokenization
+        Internal->RegenerateLastReply();
+
+        //Sync state
+        SyncModelStateToInternal();
+    });
 }
 
-int32 FLlamaNative::RawContextHistory(FString& OutContextString)
+int32 FLlamaNative::RawContextHistory(FString& OutContextString, int32 SlotId)
 {
-    if (IsGenerating())
+    //Only the synchronous loop matters here, scheduled slots are idle between BG steps
+    if (Internal->IsGenerating())
     {
         //Todo: handle this case gracefully
         UE_LOG(LlamaLog, Warning, TEXT("RawContextString cannot be called yet during generation."));
         return -1;
     }
 
-    if (Internal->ContextHistory.size() == 0)
+    if (!Internal->IsValidSlot(SlotId))
+    {
+        return 0;
+    }
+
+    const std::vector<char>& ContextHistory = Internal->GetSlot(SlotId).ContextHistory;
+
+    if (ContextHistory.size() == 0)
     {
         return 0;
     }
 
     // Find the first null terminator (0) in the buffer
-    int32 ValidLength = Internal->ContextHistory.size();
-    for (int32 i = 0; i < Internal->ContextHistory.size(); i++)
+    int32 ValidLength = ContextHistory.size();
+    for (int32 i = 0; i < ContextHistory.size(); i++)
     {
-        if (Internal->ContextHistory[i] == '\0')
+        if (ContextHistory[i] == '\0')
         {
             ValidLength = i;
             break;
@@ -877,14 +1372,14 @@ int32 FLlamaNative::RawContextHistory(FString& OutContextString)
     // ContextHistory is a UTF-8 byte stream. Convert via UTF8_TO_TCHAR (was ANSI_TO_TCHAR,
     // which double-encoded non-ASCII into mojibake). Return value is byte count (callers
     // use it for raw-buffer accounting, not char count).
-    const std::string Trimmed(Internal->ContextHistory.data(), ValidLength);
+    const std::string Trimmed(ContextHistory.data(), ValidLength);
     OutContextString = FLlamaString::ToUE(Trimmed);
     return ValidLength;
 }
 
-void FLlamaNative::GetStructuredChatHistory(FStructuredChatHistory& OutChatHistory)
+void FLlamaNative::GetStructuredChatHistory(FStructuredChatHistory& OutChatHistory, int32 SlotId)
 {
-    if (IsGenerating())
+    if (Internal->IsGenerating())
     {
         //Todo: handle this case gracefully
         UE_LOG(LlamaLog, Warning, TEXT("GetStructuredChatHistory cannot be called yet during generation."));
@@ -893,7 +1388,12 @@ void FLlamaNative::GetStructuredChatHistory(FStructuredChatHistory& OutChatHisto
 
     OutChatHistory.History.Empty();
 
-    for (const llama_chat_message& Msg : Internal->Messages)
+    if (!Internal->IsValidSlot(SlotId))
+    {
+        return;
+    }
+
+    for (const llama_chat_message& Msg : Internal->GetSlot(SlotId).Messages)
     {
         FStructuredChatMessage StructuredMsg;
 
@@ -1007,24 +1507,36 @@ void FLlamaNative::GetPromptEmbeddingsBatch(const TArray<FString>& Texts,
 
     EnqueueBGTask([this, SourceTexts = MoveTemp(SourceTexts), OnEmbeddings, OnAllEmbeddings](int64 TaskId)
     {
-        TArray<TArray<float>> AllEmbeddings;
-        AllEmbeddings.Reserve(SourceTexts.Num());
-
+        std::vector<std::string> TextsStd;
+        TextsStd.reserve(SourceTexts.Num());
         for (const FString& Text : SourceTexts)
         {
-            std::string TextStd = FLlamaString::ToStd(Text);
-            std::vector<float> Vec;
-            Internal->GetPromptEmbeddings(TextStd, Vec);
+            TextsStd.push_back(FLlamaString::ToStd(Text));
+        }
 
-            TArray<float> Emb;
-            Emb.Append(Vec.data(), Vec.size());
-            AllEmbeddings.Add(Emb);
+        TArray<TArray<float>> AllEmbeddings;
+        AllEmbeddings.SetNum(SourceTexts.Num());
 
-            if (OnEmbeddings)
+        //Texts finish a decode at a time, per text callbacks are still emitted in input order
+        TArray<bool> Done;
+        Done.SetNumZeroed(SourceTexts.Num());
+        int32 NextToEmit = 0;
+
+        std::vector<std::vector<float>> Vectors;
+        Internal->GetPromptEmbeddingsBatch(TextsStd, Vectors, [&](int32 Index, const std::vector<float>& Vec)
+        {
+            AllEmbeddings[Index].Append(Vec.data(), Vec.size());
+            Done[Index] = true;
+
+            while (NextToEmit < Done.Num() && Done[NextToEmit])
             {
-                EnqueueGTTask([OnEmbeddings, Emb, Text] { OnEmbeddings(Emb, Text); });
+                if (OnEmbeddings)
+                {
+                    EnqueueGTTask([OnEmbeddings, Emb = AllEmbeddings[NextToEmit], Text = SourceTexts[NextToEmit]] { OnEmbeddings(Emb, Text); });
+                }
+                NextToEmit++;
             }
-        }
+        });
 
         if (OnAllEmbeddings)
         {
@@ -86,6 +86,10 @@ void ULlamaSubsystem::WireBackendCallbacks()
     {
         OnPromptProcessed.Broadcast(Tokens, Role, Speed);
     };
+    Backend->OnPromptProgress = [this](int32 Done, int32 Total)
+    {
+        OnPromptProgress.Broadcast(Done, Total);
+    };
     Backend->OnEndOfStream = [this](bool bStopSeq, float Tps)
     {
         OnEndOfStream.Broadcast(bStopSeq, Tps);
@@ -98,6 +102,10 @@ void ULlamaSubsystem::WireBackendCallbacks()
     {
         OnModelLoaded.Broadcast(ModelName);
     };
+    Backend->OnModelLoadProgress = [this](float Progress)
+    {
+        OnModelLoadProgress.Broadcast(Progress);
+    };
     Backend->OnError = [this](const FString& Err, int32 Code)
     {
         OnError.Broadcast(Err, Code);
@@ -130,6 +138,11 @@ void ULlamaSubsystem::UnloadModel()
     if (Backend) Backend->UnloadModel();
 }
 
+void ULlamaSubsystem::CancelLoadModel()
+{
+    if (Backend) Backend->CancelLoadModel();
+}
+
 bool ULlamaSubsystem::IsModelLoaded() const
 {
     return Backend && Backend->IsModelLoaded();
@@ -3,6 +3,9 @@
 #include "LlamaUtility.h"
 #include "Misc/Paths.h"
 #include "HAL/FileManager.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
 
 DEFINE_LOG_CATEGORY(LlamaLog);
 
@@ -130,6 +133,12 @@ FString FLlamaString::ToUE(const std::string& String)
     return FString(UTF8_TO_TCHAR(String.c_str()));
 }
 
+FString FLlamaString::ToUE(std::string_view String)
+{
+    const FUTF8ToTCHAR Converted(String.data(), String.size());
+    return FString(Converted.Length(), Converted.Get());
+}
+
 std::string FLlamaString::ToStd(const FString& String)
 {
     return std::string(TCHAR_TO_UTF8(*String));
@@ -181,4 +190,426 @@ void FLlamaString::AppendToCharVector(std::vector<char>& VectorHistory, const st
     VectorHistory.insert(VectorHistory.end(), Text.begin(), Text.end());
 }
 
+//FLlamaGrammar
+namespace
+{
+    //JSON string escaping for keys and string constants
+    static FString JsonQuote(const FString& Text)
+    {
+        FString Out = TEXT("\"");
+        for (const TCHAR Char : Text)
+        {
+            switch (Char)
+            {
+            case TEXT('"'):  Out += TEXT("\\\""); break;
+            case TEXT('\\'): Out += TEXT("\\\\"); break;
+            case TEXT('\n'): Out += TEXT("\\n"); break;
+            case TEXT('\r'): Out += TEXT("\\r"); break;
+            case TEXT('\t'): Out += TEXT("\\t"); break;
+            default:
+                if (Char < 0x20)
+                {
+                    Out += FString::Printf(TEXT("\\u%04x"), (int32)Char);
+                }
+                else
+                {
+                    Out.AppendChar(Char);
+                }
+            }
+        }
+        Out += TEXT("\"");
+        return Out;
+    }
+
+    //GBNF string literal matching Text exactly
+    static FString GbnfLiteral(const FString& Text)
+    {
+        FString Out = TEXT("\"");
+        for (const TCHAR Char : Text)
+        {
+            switch (Char)
+            {
+            case TEXT('"'):  Out += TEXT("\\\""); break;
+            case TEXT('\\'): Out += TEXT("\\\\"); break;
+            case TEXT('\n'): Out += TEXT("\\n"); break;
+            case TEXT('\r'): Out += TEXT("\\r"); break;
+            case TEXT('\t'): Out += TEXT("\\t"); break;
+            default: Out.AppendChar(Char);
+            }
+        }
+        Out += TEXT("\"");
+        return Out;
+    }
+
+    /**
+    * Walks a JSON schema and emits one GBNF rule per schema node, named after its path (root-action-target).
+    * Whitespace between tokens is limited to the shared 'space' rule so the model can't pad output forever.
+    */
+    class FJsonSchemaGbnfBuilder
+    {
+    public:
+        bool Build(const TSharedPtr<FJsonObject>& Schema, FString& OutGrammar, FString& OutError)
+        {
+            //Root is a rule of its own unless the schema mapped straight onto a shared primitive
+            const FString Root = Visit(Schema, TEXT("root"), 0);
+            if (Root != TEXT("root"))
+            {
+                AddRule(TEXT("root"), Root);
+            }
+            if (!Error.IsEmpty())
+            {
+                OutError = Error;
+                return false;
+            }
+
+            OutGrammar.Reset();
+            for (const FString& Rule : Rules)
+            {
+                OutGrammar += Rule;
+                OutGrammar += TEXT("\n");
+            }
+            return true;
+        }
+
+    private:
+        TArray<FString> Rules;
+        TSet<FString> RuleNames;
+        FString Error;
+
+        static constexpr int32 MaxDepth = 32;
+
+        FString AddRule(const FString& NameHint, const FString& Body)
+        {
+            //GBNF rule names are [a-zA-Z0-9-]
+            FString Name;
+            for (const TCHAR Char : NameHint)
+            {
+                Name.AppendChar(FChar::IsAlnum(Char) && Char < 128 ? Char : TEXT('-'));
+            }
+            FString Unique = Name;
+            for (int32 Suffix = 1; RuleNames.Contains(Unique); Suffix++)
+            {
+                Unique = FString::Printf(TEXT("%s%d"), *Name, Suffix);
+            }
+            RuleNames.Add(Unique);
+            Rules.Add(Unique + TEXT(" ::= ") + Body);
+            return Unique;
+        }
+
+        //Shared JSON primitives, added once on first use together with what they reference
+        FString Primitive(const FString& Name)
+        {
+            if (RuleNames.Contains(Name))
+            {
+                return Name;
+            }
+
+            if (Name == TEXT("space"))
+            {
+                AddRule(Name, TEXT("| \" \" | \"\\n\" [ \\t]{0,20}"));
+            }
+            else if (Name == TEXT("char"))
+            {
+                AddRule(Name, TEXT("[^\"\\\\\\x7F\\x00-\\x1F] | [\\\\] ([\"\\\\bfnrt] | \"u\" [0-9a-fA-F]{4})"));
+            }
+            else if (Name == TEXT("string"))
+            {
+                Primitive(TEXT("char"));
+                Primitive(TEXT("space"));
+                AddRule(Name, TEXT("\"\\\"\" char* \"\\\"\" space"));
+            }
+            else if (Name == TEXT("number"))
+            {
+                Primitive(TEXT("space"));
+                AddRule(Name, TEXT("\"-\"? ([0-9] | [1-9] [0-9]{0,15}) (\".\" [0-9]{1,16})? ([eE] [-+]? [0-9]{1,3})? space"));
+            }
+            else if (Name == TEXT("integer"))
+            {
+                Primitive(TEXT("space"));
+                AddRule(Name, TEXT("\"-\"? ([0-9] | [1-9] [0-9]{0,15}) space"));
+            }
+            else if (Name == TEXT("boolean"))
+            {
+                Primitive(TEXT("space"));
+                AddRule(Name, TEXT("(\"true\" | \"false\") space"));
+            }
+            else if (Name == TEXT("null"))
+            {
+                Primitive(TEXT("space"));
+                AddRule(Name, TEXT("\"null\" space"));
+            }
+            else if (Name == TEXT("value"))
+            {
+                //Untyped schema: any JSON value. Registered before its members since they reference it.
+                RuleNames.Add(Name);
+                Rules.Add(TEXT("value ::= object | array | string | number | boolean | null"));
+                Primitive(TEXT("object"));
+                Primitive(TEXT("array"));
+                Primitive(TEXT("number"));
+                Primitive(TEXT("boolean"));
+                Primitive(TEXT("null"));
+            }
+            else if (Name == TEXT("object"))
+            {
+                Primitive(TEXT("string"));
+                RuleNames.Add(Name);
+                Rules.Add(TEXT("object ::= \"{\" space ( string \":\" space value (\",\" space string \":\" space value)* )? \"}\" space"));
+                Primitive(TEXT("value"));
+            }
+            else if (Name == TEXT("array"))
+            {
+                Primitive(TEXT("space"));
+                RuleNames.Add(Name);
+                Rules.Add(TEXT("array ::= \"[\" space ( value (\",\" space value)* )? \"]\" space"));
+                Primitive(TEXT("value"));
+            }
+            return Name;
+        }
+
+        //Serialized JSON literal for const/enum values (scalars only)
+        bool ValueLiteral(const TSharedPtr<FJsonValue>& Value, FString& OutLiteral)
+        {
+            switch (Value->Type)
+            {
+            case EJson::String:
+                OutLiteral = GbnfLiteral(JsonQuote(Value->AsString()));
+                return true;
+            case EJson::Number:
+            {
+                const double Number = Value->AsNumber();
+                const bool bIntegral = FMath::IsFinite(Number) && FMath::Abs(Number) < 1e15 && FMath::FloorToDouble(Number) == Number;
+                OutLiteral = GbnfLiteral(bIntegral ? FString::Printf(TEXT("%lld"), (int64)Number) : FString::SanitizeFloat(Number));
+                return true;
+            }
+            case EJson::Boolean:
+                OutLiteral = Value->AsBool() ? TEXT("\"true\"") : TEXT("\"false\"");
+                return true;
+            case EJson::Null:
+                OutLiteral = TEXT("\"null\"");
+                return true;
+            default:
+                Error = TEXT("enum/const only support string, number, boolean and null values");
+                return false;
+            }
+        }
+
+        //Returns the rule name (or primitive) that matches Schema
+        FString Visit(const TSharedPtr<FJsonObject>& Schema, const FString& Name, int32 Depth)
+        {
+            if (!Error.IsEmpty())
+            {
+                return Name;
+            }
+            if (Depth > MaxDepth)
+            {
+                Error = TEXT("schema nesting is too deep");
+                return Name;
+            }
+            if (!Schema.IsValid() || Schema->Values.Num() == 0)
+            {
+                return Primitive(TEXT("value"));
+            }
+            if (Schema->HasField(TEXT("$ref")))
+            {
+                Error = FString::Printf(TEXT("$ref is not supported (at '%s')"), *Name);
+                return Name;
+            }
+
+            if (const TSharedPtr<FJsonValue> Const = Schema->TryGetField(TEXT("const")))
+            {
+                FString Literal;
+                ValueLiteral(Const, Literal);
+                return AddRule(Name, Literal + TEXT(" ") + Primitive(TEXT("space")));
+            }
+
+            const TArray<TSharedPtr<FJsonValue>>* Enum = nullptr;
+            if (Schema->TryGetArrayField(TEXT("enum"), Enum))
+            {
+                //An empty group would match nothing, letting the model write a key with no value
+                if (Enum->Num() == 0)
+                {
+                    Error = FString::Printf(TEXT("enum must list at least one value (at '%s')"), *Name);
+                    return Name;
+                }
+
+                TArray<FString> Options;
+                for (const TSharedPtr<FJsonValue>& Value : *Enum)
+                {
+                    FString Literal;
+                    if (ValueLiteral(Value, Literal))
+                    {
+                        Options.Add(Literal);
+                    }
+                }
+                return AddRule(Name, TEXT("(") + FString::Join(Options, TEXT(" | ")) + TEXT(") ") + Primitive(TEXT("space")));
+            }
+
+            const TArray<TSharedPtr<FJsonValue>>* Alternatives = nullptr;
+            if (Schema->TryGetArrayField(TEXT("anyOf"), Alternatives) || Schema->TryGetArrayField(TEXT("oneOf"), Alternatives))
+            {
+                TArray<FString> Options;
+                for (int32 i = 0; i < Alternatives->Num(); i++)
+                {
+                    Options.Add(Visit((*Alternatives)[i]->AsObject(), FString::Printf(TEXT("%s-%d"), *Name, i), Depth + 1));
+                }
+                return AddRule(Name, FString::Join(Options, TEXT(" | ")));
+            }
+
+            //Type may be a list, e.g. ["string", "null"]
+            const TArray<TSharedPtr<FJsonValue>>* TypeList = nullptr;
+            if (Schema->TryGetArrayField(TEXT("type"), TypeList))
+            {
+                TArray<FString> Options;
+                for (const TSharedPtr<FJsonValue>& Type : *TypeList)
+                {
+                    Options.Add(VisitType(Schema, Type->AsString(), Name + TEXT("-") + Type->AsString(), Depth));
+                }
+                return AddRule(Name, FString::Join(Options, TEXT(" | ")));
+            }
+
+            FString Type;
+            if (!Schema->TryGetStringField(TEXT("type"), Type))
+            {
+                Type = Schema->HasField(TEXT("properties")) ? TEXT("object") : Schema->HasField(TEXT("items")) ? TEXT("array") : FString();
+            }
+            if (Type.IsEmpty())
+            {
+                return Primitive(TEXT("value"));
+            }
+            return VisitType(Schema, Type, Name, Depth);
+        }
+
+        FString VisitType(const TSharedPtr<FJsonObject>& Schema, const FString& Type, const FString& Name, int32 Depth)
+        {
+            if (Type == TEXT("object"))
+            {
+                const TSharedPtr<FJsonObject>* Properties = nullptr;
+                if (!Schema->TryGetObjectField(TEXT("properties"), Properties) || (*Properties)->Values.Num() == 0)
+                {
+                    return Primitive(TEXT("object"));
+                }
+
+                TSet<FString> Required;
+                const TArray<TSharedPtr<FJsonValue>>* RequiredList = nullptr;
+                if (Schema->TryGetArrayField(TEXT("required"), RequiredList))
+                {
+                    for (const TSharedPtr<FJsonValue>& Key : *RequiredList)
+                    {
+                        Required.Add(Key->AsString());
+                    }
+                }
+
+                //Properties are emitted in schema order, required ones first so the commas stay fixed
+                const FString Space = Primitive(TEXT("space"));
+                TArray<FString> RequiredKVs;
+                TArray<FString> OptionalKVs;
+                for (const TPair<FString, TSharedPtr<FJsonValue>>& Property : (*Properties)->Values)
+                {
+                    const FString PropertyName = Name + TEXT("-") + Property.Key;
+                    const TSharedPtr<FJsonObject> PropertySchema = Property.Value.IsValid() ? Property.Value->AsObject() : nullptr;
+                    const FString ValueRule = Visit(PropertySchema, PropertyName, Depth + 1);
+                    const FString KV = AddRule(PropertyName + TEXT("-kv"),
+                        GbnfLiteral(JsonQuote(Property.Key)) + TEXT(" ") + Space + TEXT(" \":\" ") + Space + TEXT(" ") + ValueRule);
+                    (Required.Contains(Property.Key) ? RequiredKVs : OptionalKVs).Add(KV);
+                }
+
+                //Any in-order subset of the optional properties: rest_i ::= kv_i ("," rest_i+1)? | rest_i+1
+                FString OptionalRest;
+                for (int32 i = OptionalKVs.Num() - 1; i >= 0; i--)
+                {
+                    const FString Body = OptionalRest.IsEmpty() ? OptionalKVs[i] :
+                        FString::Printf(TEXT("%s ( \",\" %s %s )? | %s"), *OptionalKVs[i], *Space, *OptionalRest, *OptionalRest);
+                    OptionalRest = AddRule(Name + FString::Printf(TEXT("-rest-%d"), i), Body);
+                }
+
+                FString Body = TEXT("\"{\" ") + Space;
+                if (RequiredKVs.Num() > 0)
+                {
+                    Body += TEXT(" ") + FString::Join(RequiredKVs, *FString::Printf(TEXT(" \",\" %s "), *Space));
+                    if (!OptionalRest.IsEmpty())
+                    {
+                        Body += FString::Printf(TEXT(" ( \",\" %s %s )?"), *Space, *OptionalRest);
+                    }
+                }
+                else if (!OptionalRest.IsEmpty())
+                {
+                    Body += FString::Printf(TEXT(" ( %s )?"), *OptionalRest);
+                }
+                Body += TEXT(" \"}\" ") + Space;
+                return AddRule(Name, Body);
+            }
+
+            if (Type == TEXT("array"))
+            {
+                const TSharedPtr<FJsonObject>* Items = nullptr;
+                const FString Item = Schema->TryGetObjectField(TEXT("items"), Items) ?
+                    Visit(*Items, Name + TEXT("-item"), Depth + 1) : Primitive(TEXT("value"));
+                const FString Space = Primitive(TEXT("space"));
+
+                int32 MinItems = 0;
+                int32 MaxItems = -1;
+                Schema->TryGetNumberField(TEXT("minItems"), MinItems);
+                Schema->TryGetNumberField(TEXT("maxItems"), MaxItems);
+
+                //Remaining items after the first, as a bounded or open repetition
+                const int32 RestMin = FMath::Max(MinItems - 1, 0);
+                const FString RestCount = MaxItems < 0 ? FString::Printf(TEXT("{%d,}"), RestMin) : FString::Printf(TEXT("{%d,%d}"), RestMin, FMath::Max(MaxItems - 1, RestMin));
+                const FString Elements = FString::Printf(TEXT("%s ( \",\" %s %s )%s"), *Item, *Space, *Item, *RestCount);
+
+                FString Body;
+                if (MaxItems == 0)
+                {
+                    Body = FString::Printf(TEXT("\"[\" %s \"]\" %s"), *Space, *Space);
+                }
+                else if (MinItems > 0)
+                {
+                    Body = FString::Printf(TEXT("\"[\" %s %s \"]\" %s"), *Space, *Elements, *Space);
+                }
+                else
+                {
+                    Body = FString::Printf(TEXT("\"[\" %s ( %s )? \"]\" %s"), *Space, *Elements, *Space);
+                }
+                return AddRule(Name, Body);
+            }
+
+            if (Type == TEXT("string"))
+            {
+                int32 MinLength = -1;
+                int32 MaxLength = -1;
+                Schema->TryGetNumberField(TEXT("minLength"), MinLength);
+                Schema->TryGetNumberField(TEXT("maxLength"), MaxLength);
+                if (MinLength < 0 && MaxLength < 0)
+                {
+                    return Primitive(TEXT("string"));
+                }
+
+                Primitive(TEXT("char"));
+                const FString Count = MaxLength < 0 ? FString::Printf(TEXT("{%d,}"), FMath::Max(MinLength, 0)) :
+                    FString::Printf(TEXT("{%d,%d}"), FMath::Max(MinLength, 0), FMath::Max(MaxLength, MinLength));
+                return AddRule(Name, FString::Printf(TEXT("\"\\\"\" char%s \"\\\"\" %s"), *Count, *Primitive(TEXT("space"))));
+            }
+
+            if (Type == TEXT("number") || Type == TEXT("integer") || Type == TEXT("boolean") || Type == TEXT("null"))
+            {
+                return Primitive(Type);
+            }
+
+            Error = FString::Printf(TEXT("unsupported type '%s' (at '%s')"), *Type, *Name);
+            return Name;
+        }
+    };
+}
+
+bool FLlamaGrammar::JsonSchemaToGbnf(const FString& JsonSchema, FString& OutGrammar, FString& OutError)
+{
+    TSharedPtr<FJsonObject> Schema;
+    const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonSchema);
+    if (!FJsonSerializer::Deserialize(Reader, Schema) || !Schema.IsValid())
+    {
+        OutError = TEXT("JsonSchema is not a valid JSON object");
+        return false;
+    }
 
+    FJsonSchemaGbnfBuilder Builder;
+    return Builder.Build(Schema, OutGrammar, OutError);
+}
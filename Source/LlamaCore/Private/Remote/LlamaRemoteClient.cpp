@@ -151,6 +151,15 @@ namespace
             W->WriteValue(TEXT("reasoning_format"), TEXT("none"));
         }
 
+        if (!Req.Grammar.IsEmpty())
+        {
+            W->WriteValue(TEXT("grammar"), Req.Grammar);
+        }
+        else if (!Req.JsonSchema.IsEmpty())
+        {
+            W->WriteRawJSONValue(TEXT("json_schema"), Req.JsonSchema);
+        }
+
         if (Req.bUseRawCompletion)
         {
             W->WriteValue(TEXT("prompt"), Req.RawPrompt);
@@ -0,0 +1,117 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaChatRenderer.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * The incremental renderer must produce byte-identical output to a full llama_chat_apply_template
+ * render for every template bundled with llama.cpp, whether or not the template is prefix-stable
+ * (unstable ones take the full-render fallback). No model needed, the built-in templates are named.
+ */
+
+namespace
+{
+    static std::vector<std::string> BuiltinTemplateNames()
+    {
+        std::vector<std::string> Names;
+        const int32 Count = llama_chat_builtin_templates(nullptr, 0);
+        if (Count <= 0)
+        {
+            return Names;
+        }
+        std::vector<const char*> Raw(Count);
+        llama_chat_builtin_templates(Raw.data(), Raw.size());
+        for (const char* Name : Raw)
+        {
+            Names.push_back(Name);
+        }
+        return Names;
+    }
+
+    static std::string RenderFullString(const std::string& Template, const std::vector<llama_chat_message>& Messages, bool bAddAssistant)
+    {
+        std::vector<char> Buffer;
+        const int32 Length = FLlamaChatTemplateRenderer::RenderFull(Template, Messages.data(), Messages.size(), bAddAssistant, Buffer);
+        return Length < 0 ? std::string() : std::string(Buffer.data(), Length);
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaChatRendererMatchesFullRenderTest,
+    "LlamaCore.ChatTemplate.IncrementalMatchesFullRender",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLlamaChatRendererMatchesFullRenderTest::RunTest(const FString& /*Parameters*/)
+{
+    const std::vector<std::string> Templates = BuiltinTemplateNames();
+    TestTrue(TEXT("llama.cpp exposes built-in templates"), Templates.size() > 0);
+
+    //Turns with multi-byte text and markup-ish content, like a real NPC chat
+    static const char* Roles[] = { "system", "user", "assistant", "user", "assistant", "user", "assistant" };
+    static const char* Contents[] = {
+        "You are Brom, a dwarven smith. Stay in character.",
+        "Hello! Can you fix my sword?",
+        "Aye, hand it over. That'll be 20 gold.",
+        "Café prices, huh? 你好 — too expensive.",
+        "<think>haggle</think>Fine, 15 and not a coin less.",
+        "Deal.\nHere you go.",
+        "Pleasure doing business.",
+    };
+    const int32 TurnCount = UE_ARRAY_COUNT(Roles);
+
+    int32 StableCount = 0;
+    for (const std::string& Name : Templates)
+    {
+        FLlamaChatTemplateRenderer Renderer;
+        Renderer.SetTemplate(Name);
+        if (Renderer.IsPrefixStable())
+        {
+            StableCount++;
+        }
+
+        std::vector<llama_chat_message> Messages;
+        std::vector<char> Buffer;
+        const FString TemplateName = UTF8_TO_TCHAR(Name.c_str());
+
+        //Grow turn by turn, rendering the same way FLlamaInternal does (header for prompts, none for replies)
+        for (int32 i = 0; i < TurnCount; i++)
+        {
+            Messages.push_back({ Roles[i], Contents[i] });
+
+            for (const bool bAddAssistant : { true, false })
+            {
+                const std::string Expected = RenderFullString(Name, Messages, bAddAssistant);
+                const int32 Length = Renderer.Render(Messages, bAddAssistant, Buffer);
+                const std::string Actual = Length < 0 ? std::string() : std::string(Buffer.data(), Length);
+
+                if (Actual != Expected)
+                {
+                    AddError(FString::Printf(TEXT("Template '%s' diverged at turn %d (add_ass=%d)"), *TemplateName, i, bAddAssistant ? 1 : 0));
+                }
+            }
+        }
+
+        //Rollback by truncation must reuse the cached prefix and still match
+        Messages.resize(3);
+        const std::string ExpectedRollback = RenderFullString(Name, Messages, false);
+        const int32 RollbackLength = Renderer.Render(Messages, false, Buffer);
+        const std::string ActualRollback = RollbackLength < 0 ? std::string() : std::string(Buffer.data(), RollbackLength);
+        TestTrue(FString::Printf(TEXT("Template '%s' matches after rollback"), *TemplateName), ActualRollback == ExpectedRollback);
+
+        //Cleared buffer (full reset) must not reuse stale cached text
+        Buffer.clear();
+        const int32 ClearedLength = Renderer.Render(Messages, true, Buffer);
+        const std::string ActualCleared = ClearedLength < 0 ? std::string() : std::string(Buffer.data(), ClearedLength);
+        TestTrue(FString::Printf(TEXT("Template '%s' matches after buffer clear"), *TemplateName), ActualCleared == RenderFullString(Name, Messages, true));
+    }
+
+    AddInfo(FString::Printf(TEXT("%d of %d built-in templates render incrementally"), StableCount, (int32)Templates.size()));
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
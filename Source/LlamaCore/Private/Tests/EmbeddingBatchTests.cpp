@@ -0,0 +1,120 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaInternal.h"
+#include "LlamaDataTypes.h"
+#include "Misc/Paths.h"
+
+#include <string>
+#include <vector>
+
+/**
+* Texts packed into shared decodes by GetPromptEmbeddingsBatch embed the same as one at a time through
+* GetPromptEmbeddings, in input order, across more texts than fit in one decode. Skips when no embedding
+* model is in Saved/Models.
+*/
+
+namespace
+{
+    static FString FindEmbeddingTestModel()
+    {
+        const FString Root = FPaths::ProjectSavedDir() / TEXT("Models");
+        const TArray<FString> Candidates = {
+            TEXT("bge-small-en-v1.5-q4_k_m.gguf"),
+            TEXT("bge-small-en-v1.5-q8_0.gguf"),
+            TEXT("Qwen3-Embedding-0.6B-q8_0.gguf"),
+        };
+        for (const FString& F : Candidates)
+        {
+            const FString Full = Root / F;
+            if (FPaths::FileExists(Full)) { return FPaths::ConvertRelativePathToFull(Full); }
+        }
+        return FString();
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaEmbeddingBatchTest,
+    "LlamaCore.Embedding.BatchMatchesSingle",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLlamaEmbeddingBatchTest::RunTest(const FString& /*Parameters*/)
+{
+    const FString ModelPath = FindEmbeddingTestModel();
+    if (ModelPath.IsEmpty())
+    {
+        AddInfo(TEXT("Skipping: no embedding model found in Saved/Models"));
+        return true;
+    }
+
+    FLLMModelParams Params;
+    Params.PathToModel = ModelPath;
+    Params.MaxContextLength = 2048;
+    Params.MaxBatchLength = 512;
+    Params.GPULayers = 0;
+    Params.Advanced.bEmbeddingMode = true;
+    Params.Advanced.EmbeddingBatchSequences = 4;
+
+    FLlamaInternal Internal;
+    if (!TestTrue(TEXT("Embedding model loads"), Internal.LoadModelFromParams(Params)))
+    {
+        return false;
+    }
+
+    //More texts than EmbeddingBatchSequences so several decodes run, mixed lengths
+    std::vector<std::string> Texts = {
+        "The smith forges blades.",
+        "Rain falls over the northern village every autumn, filling the wells and the old mill pond.",
+        "Dragons.",
+        "The ledger lists every sword, its buyer and the price that was paid for it.",
+        "A quiet road.",
+        "Merchants arrive at dawn with salt, wool and news from the capital.",
+        "",
+        "The guard captain distrusts strangers.",
+        "Bread.",
+        "Nobody has climbed the eastern tower since the fire.",
+    };
+
+    std::vector<int32> CallbackOrder;
+    std::vector<std::vector<float>> Batched;
+    Internal.GetPromptEmbeddingsBatch(Texts, Batched, [&CallbackOrder](int32 Index, const std::vector<float>&)
+    {
+        CallbackOrder.push_back(Index);
+    });
+
+    TestEqual(TEXT("One result per text"), (int32)Batched.size(), (int32)Texts.size());
+    TestEqual(TEXT("One callback per text"), (int32)CallbackOrder.size(), (int32)Texts.size());
+
+    const int32 NEmbd = Internal.GetEmbeddingDimension();
+    for (int32 i = 0; i < (int32)Texts.size(); i++)
+    {
+        std::vector<float> Single;
+        Internal.GetPromptEmbeddings(Texts[i], Single);
+
+        if (Texts[i].empty() && Single.empty())
+        {
+            TestTrue(TEXT("Text that tokenizes to nothing has no embedding"), Batched[i].empty());
+            continue;
+        }
+        if (!TestEqual(FString::Printf(TEXT("Text %d has a full vector"), i), (int32)Batched[i].size(), NEmbd) ||
+            (int32)Single.size() != NEmbd)
+        {
+            continue;
+        }
+
+        //Normalized vectors, batching only changes float accumulation order
+        double Dot = 0.0;
+        for (int32 d = 0; d < NEmbd; d++)
+        {
+            Dot += (double)Batched[i][d] * Single[d];
+        }
+        TestTrue(FString::Printf(TEXT("Text %d batched matches single (cos %.5f)"), i, Dot), Dot > 0.999);
+    }
+
+    Internal.UnloadModel();
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
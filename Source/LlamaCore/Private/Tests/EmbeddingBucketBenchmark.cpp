@@ -0,0 +1,152 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaInternal.h"
+#include "LlamaDataTypes.h"
+#include "Math/RandomStream.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformTime.h"
+
+#include <string>
+#include <vector>
+
+/**
+* Embedding throughput over a mixed-length corpus shaped like RAG ingest (mostly short chunks, some long
+* paragraphs, in document order): one text per decode, packed in input order, and packed by length bucket.
+* Also checks that every packed run returns the same vectors in input order. Skips when no embedding model
+* is in Saved/Models. Timings are reported, not asserted.
+*/
+
+namespace
+{
+    static FString FindBucketBenchmarkModel()
+    {
+        const FString Root = FPaths::ProjectSavedDir() / TEXT("Models");
+        const TArray<FString> Candidates = {
+            TEXT("bge-small-en-v1.5-q4_k_m.gguf"),
+            TEXT("bge-small-en-v1.5-q8_0.gguf"),
+            TEXT("Qwen3-Embedding-0.6B-q8_0.gguf"),
+        };
+        for (const FString& F : Candidates)
+        {
+            const FString Full = Root / F;
+            if (FPaths::FileExists(Full)) { return FPaths::ConvertRelativePathToFull(Full); }
+        }
+        return FString();
+    }
+
+    struct FBucketBenchConfig
+    {
+        const TCHAR* Name;
+        int32 BatchSequences;
+        bool bBucketed;
+    };
+
+    static constexpr int32 BenchCorpusSize = 512;
+
+    static std::vector<std::string> MakeMixedCorpus(FRandomStream& Random)
+    {
+        static const char* Words[] = { "the", "smith", "forged", "a", "blade", "for", "northern", "guard", "ledger",
+            "village", "merchant", "salt", "tower", "fire", "road", "dawn", "wool", "captain", "river", "mill" };
+
+        std::vector<std::string> Corpus;
+        Corpus.reserve(BenchCorpusSize);
+        for (int32 i = 0; i < BenchCorpusSize; i++)
+        {
+            //70% headings/short lines, 20% sentences, 10% long paragraphs
+            const float Roll = Random.FRand();
+            const int32 WordCount = Roll < 0.7f ? Random.RandRange(3, 12) : (Roll < 0.9f ? Random.RandRange(20, 60) : Random.RandRange(150, 300));
+
+            std::string Text;
+            for (int32 w = 0; w < WordCount; w++)
+            {
+                Text += w == 0 ? "" : " ";
+                Text += Words[Random.RandRange(0, UE_ARRAY_COUNT(Words) - 1)];
+            }
+            Corpus.push_back(Text + ".");
+        }
+        return Corpus;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaEmbeddingBucketBenchmark,
+    "LlamaCore.Perf.EmbeddingLengthBuckets",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FLlamaEmbeddingBucketBenchmark::RunTest(const FString& /*Parameters*/)
+{
+    const FString ModelPath = FindBucketBenchmarkModel();
+    if (ModelPath.IsEmpty())
+    {
+        AddInfo(TEXT("Skipping: no embedding model found in Saved/Models"));
+        return true;
+    }
+
+    FRandomStream Random(4321);
+    const std::vector<std::string> Corpus = MakeMixedCorpus(Random);
+
+    const FBucketBenchConfig Configs[] = {
+        { TEXT("one per decode"),        1,  false },
+        { TEXT("packed, input order"),   32, false },
+        { TEXT("packed, length buckets"), 32, true },
+    };
+
+    AddInfo(FString::Printf(TEXT("Model: %s, %d texts"), *FPaths::GetCleanFilename(ModelPath), (int32)Corpus.size()));
+    AddInfo(TEXT("Config                  | seconds | texts/sec"));
+
+    std::vector<std::vector<float>> Reference;
+    for (const FBucketBenchConfig& Config : Configs)
+    {
+        FLLMModelParams Params;
+        Params.PathToModel = ModelPath;
+        Params.MaxContextLength = 4096;
+        Params.MaxBatchLength = 2048;
+        Params.GPULayers = 99;
+        Params.Advanced.bEmbeddingMode = true;
+        Params.Advanced.EmbeddingBatchSequences = Config.BatchSequences;
+        Params.Advanced.bBucketEmbeddingsByLength = Config.bBucketed;
+
+        FLlamaInternal Internal;
+        if (!Internal.LoadModelFromParams(Params))
+        {
+            AddWarning(FString::Printf(TEXT("%s: failed to load"), Config.Name));
+            continue;
+        }
+
+        std::vector<std::vector<float>> Embeddings;
+        const double Start = FPlatformTime::Seconds();
+        Internal.GetPromptEmbeddingsBatch(Corpus, Embeddings);
+        const double Seconds = FPlatformTime::Seconds() - Start;
+
+        AddInfo(FString::Printf(TEXT("%-23s | %7.3f | %9.1f"), Config.Name, Seconds, Corpus.size() / FMath::Max(Seconds, 1e-6)));
+
+        //Packing and bucketing must not change results or their order
+        if (Reference.empty())
+        {
+            Reference = MoveTemp(Embeddings);
+        }
+        else if (TestEqual(FString::Printf(TEXT("%s: one vector per text"), Config.Name), (int32)Embeddings.size(), (int32)Reference.size()))
+        {
+            double MinCos = 1.0;
+            for (int32 i = 0; i < (int32)Reference.size(); i++)
+            {
+                double Dot = 0.0;
+                for (int32 d = 0; d < (int32)Reference[i].size() && d < (int32)Embeddings[i].size(); d++)
+                {
+                    Dot += (double)Reference[i][d] * Embeddings[i][d];
+                }
+                MinCos = FMath::Min(MinCos, Dot);
+            }
+            TestTrue(FString::Printf(TEXT("%s: matches one per decode in input order (min cos %.5f)"), Config.Name, MinCos), MinCos > 0.999);
+        }
+
+        Internal.UnloadModel();
+    }
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,139 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaEmbeddingCache.h"
+#include "Internal/LlamaInternal.h"
+#include "LlamaDataTypes.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+
+#include <string>
+#include <vector>
+
+/**
+* Vectors served by the embedding cache, from memory and from the mapped file, are the ones first decoded for
+* that text, and match an uncached instance. Skips when no embedding model is in Saved/Models.
+*/
+
+namespace
+{
+    static FString FindCacheTestModel()
+    {
+        const FString Root = FPaths::ProjectSavedDir() / TEXT("Models");
+        const TArray<FString> Candidates = {
+            TEXT("bge-small-en-v1.5-q4_k_m.gguf"),
+            TEXT("bge-small-en-v1.5-q8_0.gguf"),
+            TEXT("Qwen3-Embedding-0.6B-q8_0.gguf"),
+        };
+        for (const FString& F : Candidates)
+        {
+            const FString Full = Root / F;
+            if (FPaths::FileExists(Full)) { return FPaths::ConvertRelativePathToFull(Full); }
+        }
+        return FString();
+    }
+
+    static double MinCosine(const std::vector<std::vector<float>>& A, const std::vector<std::vector<float>>& B)
+    {
+        double MinCos = 1.0;
+        for (size_t i = 0; i < A.size() && i < B.size(); i++)
+        {
+            double Dot = 0.0;
+            for (size_t d = 0; d < A[i].size() && d < B[i].size(); d++)
+            {
+                Dot += (double)A[i][d] * B[i][d];
+            }
+            MinCos = FMath::Min(MinCos, Dot);
+        }
+        return MinCos;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaEmbeddingCacheTest,
+    "LlamaCore.Embedding.Cache",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLlamaEmbeddingCacheTest::RunTest(const FString& /*Parameters*/)
+{
+    const FString ModelPath = FindCacheTestModel();
+    if (ModelPath.IsEmpty())
+    {
+        AddInfo(TEXT("Skipping: no embedding model found in Saved/Models"));
+        return true;
+    }
+
+    FLLMModelParams Params;
+    Params.PathToModel = ModelPath;
+    Params.MaxContextLength = 2048;
+    Params.MaxBatchLength = 512;
+    Params.GPULayers = 0;
+    Params.Advanced.bEmbeddingMode = true;
+    Params.Advanced.EmbeddingBatchSequences = 4;
+
+    //Unique per run so the first pass is guaranteed to decode
+    const std::string RunTag = TCHAR_TO_UTF8(*FGuid::NewGuid().ToString());
+    const std::vector<std::string> Texts = {
+        "The smith forges blades. " + RunTag,
+        "Rain falls over the northern village every autumn. " + RunTag,
+        "Merchants arrive at dawn with salt, wool and news from the capital. " + RunTag,
+    };
+
+    std::vector<std::vector<float>> Uncached;
+    {
+        FLLMModelParams UncachedParams = Params;
+        UncachedParams.Advanced.bEmbeddingCache = false;
+        FLlamaInternal Internal;
+        if (!TestTrue(TEXT("Uncached model loads"), Internal.LoadModelFromParams(UncachedParams)))
+        {
+            return false;
+        }
+        Internal.GetPromptEmbeddingsBatch(Texts, Uncached);
+        Internal.UnloadModel();
+    }
+
+    //Runs against its own file so the project's cache is left alone
+    FLlamaEmbeddingCache& Cache = FLlamaEmbeddingCache::Get();
+    const FString ProjectCachePath = Cache.GetFilePath();
+    const FString TestCachePath = FPaths::ProjectIntermediateDir() / TEXT("LlamaCoreTests") / TEXT("EmbeddingCacheTest.lec");
+    IFileManager::Get().Delete(*TestCachePath, false, true, true);
+    Cache.SetFilePath(TestCachePath);
+    ON_SCOPE_EXIT
+    {
+        Cache.SetFilePath(ProjectCachePath);
+        IFileManager::Get().Delete(*TestCachePath, false, true, true);
+    };
+
+    FLlamaInternal Internal;
+    if (!TestTrue(TEXT("Cached model loads"), Internal.LoadModelFromParams(Params)))
+    {
+        return false;
+    }
+
+    const int32 OnDiskBefore = Cache.NumOnDisk();
+
+    std::vector<std::vector<float>> First;
+    Internal.GetPromptEmbeddingsBatch(Texts, First);
+    TestEqual(TEXT("New texts are persisted"), Cache.NumOnDisk(), OnDiskBefore + (int32)Texts.size());
+    TestTrue(FString::Printf(TEXT("Cached instance matches uncached (min cos %.5f)"), MinCosine(First, Uncached)),
+        MinCosine(First, Uncached) > 0.999);
+
+    std::vector<std::vector<float>> FromMemory;
+    Internal.GetPromptEmbeddingsBatch(Texts, FromMemory);
+    TestTrue(TEXT("Repeat is served from memory unchanged"), FromMemory == First);
+
+    //Drop the memory tier so the next call reads the mapped file
+    Cache.Clear(/*bDeleteFile*/ false);
+    std::vector<std::vector<float>> FromDisk;
+    Internal.GetPromptEmbeddingsBatch(Texts, FromDisk);
+    TestTrue(TEXT("Repeat is served from the file unchanged"), FromDisk == First);
+    TestEqual(TEXT("Hits are not persisted twice"), Cache.NumOnDisk(), OnDiskBefore + (int32)Texts.size());
+
+    Internal.UnloadModel();
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,102 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "LlamaUtility.h"
+#include "llama.h"
+
+/**
+* JSON schema -> GBNF conversion used by FLlamaChatPrompt::JsonSchema. Checks the emitted rules for a typical
+* NPC action schema, that they parse as a grammar, and that unsupported schemas are rejected instead of
+* silently producing a loose grammar.
+*/
+
+namespace
+{
+    //Runs the GBNF through llama.cpp's grammar parser. No vocab is needed to parse, only to sample.
+    static bool ParsesAsGrammar(const FString& Grammar)
+    {
+        llama_sampler* Sampler = llama_sampler_init_grammar(nullptr, TCHAR_TO_UTF8(*Grammar), "root");
+        if (!Sampler)
+        {
+            return false;
+        }
+        llama_sampler_free(Sampler);
+        return true;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaJsonSchemaGrammarTest,
+    "LlamaCore.Grammar.JsonSchemaToGbnf",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLlamaJsonSchemaGrammarTest::RunTest(const FString& /*Parameters*/)
+{
+    const FString ActionSchema = TEXT(R"({
+        "type": "object",
+        "properties": {
+            "action": { "enum": ["attack", "flee", "trade"] },
+            "target": { "type": "string", "maxLength": 32 },
+            "amount": { "type": "integer" },
+            "say": { "type": ["string", "null"] },
+            "items": { "type": "array", "items": { "type": "string" }, "maxItems": 3 }
+        },
+        "required": ["action", "target"]
+    })");
+
+    FString Grammar;
+    FString Error;
+    TestTrue(TEXT("Action schema converts"), FLlamaGrammar::JsonSchemaToGbnf(ActionSchema, Grammar, Error));
+    TestTrue(TEXT("No error for a supported schema"), Error.IsEmpty());
+    TestTrue(TEXT("Action schema grammar parses"), ParsesAsGrammar(Grammar));
+
+    TestTrue(TEXT("Root rule emitted"), Grammar.Contains(TEXT("\nroot ::= \"{\" space root-action-kv \",\" space root-target-kv ( \",\" space root-rest-0 )? \"}\" space")));
+    TestTrue(TEXT("Enum values are quoted JSON literals"), Grammar.Contains(TEXT("root-action ::= (\"\\\"attack\\\"\" | \"\\\"flee\\\"\" | \"\\\"trade\\\"\") space")));
+    TestTrue(TEXT("Keys are quoted JSON literals"), Grammar.Contains(TEXT("root-action-kv ::= \"\\\"action\\\"\" space \":\" space root-action")));
+    TestTrue(TEXT("maxLength bounds the string"), Grammar.Contains(TEXT("char{0,32}")));
+    TestTrue(TEXT("Type lists become alternatives"), Grammar.Contains(TEXT("root-say ::= string | null")));
+    TestTrue(TEXT("maxItems bounds the array"), Grammar.Contains(TEXT("root-items ::= \"[\" space ( string ( \",\" space string ){0,2} )? \"]\" space")));
+    TestTrue(TEXT("Optional properties may be skipped in order"), Grammar.Contains(TEXT("root-rest-0 ::= root-amount-kv ( \",\" space root-rest-1 )? | root-rest-1")));
+    TestTrue(TEXT("Whitespace is bounded"), Grammar.Contains(TEXT("space ::= | \" \" | \"\\n\" [ \\t]{0,20}")));
+
+    //Each rule is defined exactly once
+    TArray<FString> Lines;
+    Grammar.ParseIntoArrayLines(Lines);
+    TSet<FString> RuleNames;
+    for (const FString& Line : Lines)
+    {
+        FString Name;
+        FString Body;
+        TestTrue(TEXT("Every line is a rule"), Line.Split(TEXT(" ::= "), &Name, &Body));
+        TestFalse(FString::Printf(TEXT("Rule '%s' is unique"), *Name), RuleNames.Contains(Name));
+        RuleNames.Add(Name);
+    }
+
+    //Empty schema accepts any JSON value
+    TestTrue(TEXT("Empty schema converts"), FLlamaGrammar::JsonSchemaToGbnf(TEXT("{}"), Grammar, Error));
+    TestTrue(TEXT("Empty schema allows any value"), Grammar.Contains(TEXT("value ::= object | array | string | number | boolean | null")));
+    TestTrue(TEXT("Empty schema grammar parses"), ParsesAsGrammar(Grammar));
+
+    //Escaping and nesting: quotes, backslashes and non-ASCII in enum values and keys, nested objects
+    const FString EscapingSchema = TEXT(R"({
+        "type": "object",
+        "properties": {
+            "line": { "enum": ["say \"hi\"", "back\\slash", "caf\u00e9", 42, true, null] },
+            "odd \"key\"": { "type": "object", "properties": { "depth": { "type": "number" } } }
+        }
+    })");
+    TestTrue(TEXT("Escaping schema converts"), FLlamaGrammar::JsonSchemaToGbnf(EscapingSchema, Grammar, Error));
+    TestTrue(TEXT("Escaping schema grammar parses"), ParsesAsGrammar(Grammar));
+
+    //Unsupported or malformed schemas fail loudly
+    TestFalse(TEXT("$ref is rejected"), FLlamaGrammar::JsonSchemaToGbnf(TEXT(R"({"$ref": "#/defs/a"})"), Grammar, Error));
+    TestFalse(TEXT("Unknown type is rejected"), FLlamaGrammar::JsonSchemaToGbnf(TEXT(R"({"type": "date"})"), Grammar, Error));
+    TestFalse(TEXT("Invalid JSON is rejected"), FLlamaGrammar::JsonSchemaToGbnf(TEXT("{ not json"), Grammar, Error));
+    TestFalse(TEXT("Empty enum is rejected"), FLlamaGrammar::JsonSchemaToGbnf(TEXT(R"({"type": "object", "properties": {"a": {"enum": []}}})"), Grammar, Error));
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,134 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaInternal.h"
+#include "LlamaDataTypes.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformTime.h"
+
+#include <string>
+
+/**
+* Memory vs speed map of the FLLMMemoryParams KV cache / flash attention combinations on a real chat model.
+* Each row loads the model, prefills a long prompt, generates a short reply and reports load time, prefill and
+* generation tokens/sec and KV bytes per token of the conversation. Skips when no model is in Saved/Models.
+* Timings are reported, not asserted.
+*/
+
+namespace
+{
+    static FString FindBenchmarkModel()
+    {
+        const FString Root = FPaths::ProjectSavedDir() / TEXT("Models");
+        const TArray<FString> Candidates = {
+            TEXT("google_gemma-3-4b-it-Q4_K_L.gguf"),
+            TEXT("gemma-4-E2B-it-Q6_K.gguf"),
+            TEXT("Qwen2.5-Omni-7B-Q4_K_M.gguf"),
+            TEXT("Qwen3.5-9B-Q4_K_M.gguf"),
+        };
+        for (const FString& F : Candidates)
+        {
+            const FString Full = Root / F;
+            if (FPaths::FileExists(Full)) { return FPaths::ConvertRelativePathToFull(Full); }
+        }
+        return FString();
+    }
+
+    struct FKVBenchConfig
+    {
+        const TCHAR* Name;
+        ELlamaKVCacheType K;
+        ELlamaKVCacheType V;
+        ELlamaFlashAttention FlashAttention;
+    };
+
+    static constexpr int32 BenchGenerateTokens = 64;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaKVCacheConfigBenchmark,
+    "LlamaCore.Perf.KVCacheConfigMap",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FLlamaKVCacheConfigBenchmark::RunTest(const FString& /*Parameters*/)
+{
+    const FString ModelPath = FindBenchmarkModel();
+    if (ModelPath.IsEmpty())
+    {
+        AddInfo(TEXT("Skipping: no chat model found in Saved/Models"));
+        return true;
+    }
+
+    const FKVBenchConfig Configs[] = {
+        { TEXT("f16/f16, FA off"),   ELlamaKVCacheType::F16,  ELlamaKVCacheType::F16,  ELlamaFlashAttention::Disabled },
+        { TEXT("f16/f16, FA auto"),  ELlamaKVCacheType::F16,  ELlamaKVCacheType::F16,  ELlamaFlashAttention::Auto },
+        { TEXT("q8_0/f16, FA off"),  ELlamaKVCacheType::Q8_0, ELlamaKVCacheType::F16,  ELlamaFlashAttention::Disabled },
+        { TEXT("q8_0/q8_0, FA auto"), ELlamaKVCacheType::Q8_0, ELlamaKVCacheType::Q8_0, ELlamaFlashAttention::Auto },
+        { TEXT("q8_0/q4_0, FA auto"), ELlamaKVCacheType::Q8_0, ELlamaKVCacheType::Q4_0, ELlamaFlashAttention::Auto },
+        { TEXT("q4_0/q4_0, FA auto"), ELlamaKVCacheType::Q4_0, ELlamaKVCacheType::Q4_0, ELlamaFlashAttention::Auto },
+    };
+
+    //Long enough to be prefill bound, short enough for a 4k context with the reply
+    std::string Prompt;
+    while (Prompt.size() < 6000)
+    {
+        Prompt += "The blacksmith of the northern village keeps a ledger of every blade she has forged, who paid for it and where it went. ";
+    }
+
+    AddInfo(FString::Printf(TEXT("Model: %s"), *FPaths::GetCleanFilename(ModelPath)));
+    AddInfo(TEXT("Config               | load s | prefill tps | gen tps | KV bytes/token | tokens"));
+
+    for (const FKVBenchConfig& Config : Configs)
+    {
+        FLLMModelParams Params;
+        Params.PathToModel = ModelPath;
+        Params.MaxContextLength = 4096;
+        Params.GPULayers = 99;
+        Params.Seed = 42;
+        Params.SystemPromptCacheEntries = 0;
+        Params.KVSnapshotSequences = 0;
+        Params.ReplyCandidateSequences = 0;
+        Params.Advanced.Output.bLogGenerationStats = false;
+        Params.Advanced.Memory.KCacheType = Config.K;
+        Params.Advanced.Memory.VCacheType = Config.V;
+        Params.Advanced.Memory.FlashAttention = Config.FlashAttention;
+
+        FLlamaInternal Internal;
+        float PrefillSpeed = 0.f;
+        int32 Generated = 0;
+        Internal.OnPromptProcessed = [&PrefillSpeed](int32, EChatTemplateRole, float Speed) { PrefillSpeed = Speed; };
+        Internal.OnTokenGenerated = [&Internal, &Generated](std::string_view)
+        {
+            if (++Generated >= BenchGenerateTokens)
+            {
+                Internal.StopGeneration();
+            }
+        };
+
+        const double LoadStart = FPlatformTime::Seconds();
+        if (!Internal.LoadModelFromParams(Params))
+        {
+            AddWarning(FString::Printf(TEXT("%s: failed to load, not supported by this backend"), Config.Name));
+            continue;
+        }
+        const double LoadSeconds = FPlatformTime::Seconds() - LoadStart;
+
+        Internal.InsertRawPrompt(Prompt, true);
+
+        const int32 UsedTokens = Internal.UsedContext();
+        const uint64 KVBytes = llama_state_seq_get_size(Internal.Context, 0);
+        TestTrue(FString::Printf(TEXT("%s: prompt and reply landed in KV"), Config.Name), UsedTokens > 0 && KVBytes > 0);
+
+        AddInfo(FString::Printf(TEXT("%-20s | %6.2f | %11.1f | %7.1f | %14llu | %d"),
+            Config.Name, LoadSeconds, PrefillSpeed, Internal.LastRunTimings.TokensPerSecond,
+            UsedTokens > 0 ? KVBytes / UsedTokens : 0, UsedTokens));
+
+        Internal.UnloadModel();
+    }
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
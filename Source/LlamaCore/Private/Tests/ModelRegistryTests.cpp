@@ -0,0 +1,77 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaInternal.h"
+#include "Internal/LlamaModelRegistry.h"
+#include "LlamaDataTypes.h"
+#include "Misc/Paths.h"
+
+/**
+* Two instances loading the same GGUF share one llama_model and each keep their own context. The weights
+* stay alive while either instance holds them. Skips when no model is in Saved/Models.
+*/
+
+namespace
+{
+    static FString FindRegistryTestModel()
+    {
+        const FString Root = FPaths::ProjectSavedDir() / TEXT("Models");
+        const TArray<FString> Candidates = {
+            TEXT("bge-small-en-v1.5-q4_k_m.gguf"),
+            TEXT("google_gemma-3-4b-it-Q4_K_L.gguf"),
+            TEXT("gemma-4-E2B-it-Q6_K.gguf"),
+        };
+        for (const FString& F : Candidates)
+        {
+            const FString Full = Root / F;
+            if (FPaths::FileExists(Full)) { return FPaths::ConvertRelativePathToFull(Full); }
+        }
+        return FString();
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaModelRegistryTest,
+    "LlamaCore.ModelRegistry.SharedWeights",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLlamaModelRegistryTest::RunTest(const FString& /*Parameters*/)
+{
+    const FString ModelPath = FindRegistryTestModel();
+    if (ModelPath.IsEmpty())
+    {
+        AddInfo(TEXT("Skipping: no model found in Saved/Models"));
+        return true;
+    }
+
+    FLLMModelParams Params;
+    Params.PathToModel = ModelPath;
+    Params.MaxContextLength = 512;
+    Params.GPULayers = 0;
+    Params.SystemPromptCacheEntries = 0;
+    Params.KVSnapshotSequences = 0;
+    Params.ReplyCandidateSequences = 0;
+    Params.Advanced.bEmbeddingMode = true;
+
+    FLlamaInternal First;
+    FLlamaInternal Second;
+    TestTrue(TEXT("First instance loads"), First.LoadModelFromParams(Params));
+    TestTrue(TEXT("Second instance loads"), Second.LoadModelFromParams(Params));
+
+    TestTrue(TEXT("Weights are shared"), First.LlamaModel != nullptr && First.LlamaModel == Second.LlamaModel);
+    TestTrue(TEXT("Contexts are separate"), First.Context != nullptr && First.Context != Second.Context);
+    TestEqual(TEXT("Both instances hold a reference"), FLlamaModelRegistry::Get().GetRefCount(First.LlamaModel), 2);
+
+    llama_model* Shared = Second.LlamaModel;
+    First.UnloadModel();
+    TestEqual(TEXT("Weights outlive the first unload"), FLlamaModelRegistry::Get().GetRefCount(Shared), 1);
+
+    Second.UnloadModel();
+    TestEqual(TEXT("Last unload frees the weights"), FLlamaModelRegistry::Get().GetRefCount(Shared), 0);
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
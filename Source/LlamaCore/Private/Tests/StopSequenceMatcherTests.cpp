@@ -0,0 +1,100 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaStopMatcher.h"
+
+#include <string>
+#include <vector>
+
+/**
+* Stop sequence matching over streamed pieces, split at awkward boundaries the way tokenizers do.
+* Everything released must be exactly the text before the first stop sequence, whatever the split.
+*/
+
+namespace
+{
+    struct FStreamResult
+    {
+        std::string Streamed;
+        bool bMatched = false;
+        int32 MatchTag = -1;
+        int32 KeepTag = -1;
+    };
+
+    //Feed pieces tagged by index, stopping at the first match like the generation loop does
+    static FStreamResult StreamPieces(FLlamaStopSequenceMatcher& Matcher, const std::vector<std::string>& Pieces)
+    {
+        FStreamResult Result;
+        Matcher.Reset();
+        for (int32 i = 0; i < (int32)Pieces.size(); i++)
+        {
+            Result.bMatched = Matcher.Feed(Pieces[i], i);
+            Result.Streamed += Matcher.GetEmitted();
+            if (Result.bMatched)
+            {
+                Result.MatchTag = Matcher.GetMatchTag();
+                Result.KeepTag = Matcher.GetKeepTag();
+                return Result;
+            }
+        }
+        Result.Streamed += Matcher.Flush();
+        return Result;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaStopSequenceMatcherTest,
+    "LlamaCore.StopSequences.StreamedMatching",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLlamaStopSequenceMatcherTest::RunTest(const FString& /*Parameters*/)
+{
+    FLlamaStopSequenceMatcher Matcher;
+    Matcher.SetPatterns({ "\nUser:", "</answer>", "END", "" });
+    TestTrue(TEXT("Non-empty patterns registered"), Matcher.HasPatterns());
+
+    //Stop split across pieces, match starts mid-piece
+    FStreamResult Split = StreamPieces(Matcher, { "Sure, the forge is", " hot.\nUs", "er", ": more" });
+    TestTrue(TEXT("Split stop sequence matches"), Split.bMatched);
+    TestEqual(TEXT("Text before the stop is released"), FString(UTF8_TO_TCHAR(Split.Streamed.c_str())), FString(TEXT("Sure, the forge is hot.")));
+    TestEqual(TEXT("Match starts in the piece holding the newline"), Split.MatchTag, 1);
+    TestEqual(TEXT("Piece with released text before the stop is kept"), Split.KeepTag, 2);
+
+    //Stop starting on a piece boundary, everything from that piece on can be cut
+    FStreamResult Boundary = StreamPieces(Matcher, { "Done.", "\nUser:", " next" });
+    TestTrue(TEXT("Stop on a piece boundary matches"), Boundary.bMatched);
+    TestTrue(TEXT("Only the text before the boundary is released"), Boundary.Streamed == "Done.");
+    TestEqual(TEXT("Match starts in the second piece"), Boundary.MatchTag, 1);
+    TestEqual(TEXT("Nothing released from the second piece, it is cut"), Boundary.KeepTag, 1);
+
+    //Near misses are released in full, nothing is lost or duplicated
+    FStreamResult NearMiss = StreamPieces(Matcher, { "</ans", "wer is EN", "D?" });
+    TestTrue(TEXT("Overlapping patterns still match the earliest completion"), NearMiss.bMatched);
+    TestEqual(TEXT("Prefix of another pattern is released once it can't match"), FString(UTF8_TO_TCHAR(NearMiss.Streamed.c_str())), FString(TEXT("</answer is ")));
+    TestEqual(TEXT("Match tag is the piece where END starts"), NearMiss.MatchTag, 1);
+    TestEqual(TEXT("Piece released up to END is kept"), NearMiss.KeepTag, 2);
+
+    //No stop: held tail comes back on flush, output equals input
+    const std::vector<std::string> Plain = { "Café ", "你好 ", "EN", "\nUse" };
+    FStreamResult NoMatch = StreamPieces(Matcher, Plain);
+    TestFalse(TEXT("No stop sequence in plain text"), NoMatch.bMatched);
+    TestTrue(TEXT("Flush releases the held tail"), NoMatch.Streamed == "Café 你好 EN\nUse");
+
+    //Held bytes never exceed the longest pattern
+    Matcher.Reset();
+    Matcher.Feed("Answer:\nUser", 0);
+    TestTrue(TEXT("Only the ambiguous suffix is held"), Matcher.GetEmitted() == "Answer:");
+
+    //Without patterns Feed is a passthrough
+    FLlamaStopSequenceMatcher Empty;
+    Empty.SetPatterns({});
+    FStreamResult Passthrough = StreamPieces(Empty, { "END", "\nUser:" });
+    TestFalse(TEXT("No patterns never matches"), Passthrough.bMatched);
+    TestTrue(TEXT("No patterns streams everything"), Passthrough.Streamed == "END\nUser:");
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,134 @@
+// Copyright 2025-current Getnamo.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Internal/LlamaStopMatcher.h"
+#include "Internal/LlamaTokenPieceTable.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformTime.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+* Per-token overhead of the generation loop around llama_decode: token -> text, stop sequence matching,
+* response accumulation and the streaming callback. Compares the piece table + reused buffers path with
+* the previous fresh-std::string-per-token path over a synthetic vocab. Timings are reported, not asserted.
+*/
+
+namespace
+{
+    static constexpr int32 BenchVocabSize = 32000;
+    static constexpr int32 BenchTokenCount = 200000;
+
+    //Word-like pieces with a leading space, some multi-byte, never containing a stop sequence byte
+    static std::vector<std::string> MakeBenchVocab(FRandomStream& Random)
+    {
+        static const char* MultiByte[] = { "é", "ß", "你", "ж", "🙂" };
+        std::vector<std::string> Pieces;
+        Pieces.reserve(BenchVocabSize);
+        for (int32 i = 0; i < BenchVocabSize; i++)
+        {
+            std::string Piece = (Random.FRand() < 0.7f) ? " " : "";
+            const int32 Length = Random.RandRange(1, 8);
+            for (int32 c = 0; c < Length; c++)
+            {
+                Piece += (Random.FRand() < 0.05f) ? MultiByte[Random.RandRange(0, 4)] : std::string(1, (char)('a' + Random.RandRange(0, 25)));
+            }
+            Pieces.push_back(Piece);
+        }
+        return Pieces;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaTokenLoopBenchmark,
+    "LlamaCore.Perf.TokenLoopOverhead",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FLlamaTokenLoopBenchmark::RunTest(const FString& /*Parameters*/)
+{
+    FRandomStream Random(1234);
+    const std::vector<std::string> Pieces = MakeBenchVocab(Random);
+
+    std::vector<int32> Tokens(BenchTokenCount);
+    for (int32& Token : Tokens)
+    {
+        Token = Random.RandRange(0, BenchVocabSize - 1);
+    }
+
+    std::string Expected;
+    for (const int32 Token : Tokens)
+    {
+        Expected += Pieces[Token];
+    }
+
+    FLlamaStopSequenceMatcher Matcher;
+    Matcher.SetPatterns({ "\nUser:", "</answer>" });
+    int64 CallbackBytes = 0;
+
+    //Previous path: a fresh std::string per token (what SafeTokenToPiece returned), response grown on demand
+    auto RunAllocating = [&](std::string& Response)
+    {
+        TFunction<void(const std::string&)> OnToken = [&CallbackBytes](const std::string& Piece) { CallbackBytes += Piece.size(); };
+        Response = std::string();
+        Matcher.Reset();
+        for (int32 i = 0; i < BenchTokenCount; i++)
+        {
+            const std::string Piece = Pieces[Tokens[i]];
+            Matcher.Feed(Piece, i);
+            const std::string Emitted = Matcher.GetEmitted();
+            Response += Emitted;
+            OnToken(Emitted);
+        }
+        Response += Matcher.Flush();
+    };
+
+    //Current path: piece table views into the matcher, reused response buffer, views to the callback
+    FLlamaTokenPieceTable Table;
+    Table.BuildFromPieces(Pieces);
+    auto RunTable = [&](std::string& Response)
+    {
+        TFunction<void(std::string_view)> OnToken = [&CallbackBytes](std::string_view Piece) { CallbackBytes += Piece.size(); };
+        Response.clear();
+        Matcher.Reset();
+        for (int32 i = 0; i < BenchTokenCount; i++)
+        {
+            Matcher.Feed(Table.Get(Tokens[i]), i);
+            const std::string& Emitted = Matcher.GetEmitted();
+            Response += Emitted;
+            OnToken(Emitted);
+        }
+        Response += Matcher.Flush();
+    };
+
+    std::string AllocatingResponse;
+    std::string TableResponse;
+
+    //Warm up, the table path keeps its grown buffers from here on
+    RunAllocating(AllocatingResponse);
+    RunTable(TableResponse);
+    const size_t WarmCapacity = TableResponse.capacity();
+
+    double Start = FPlatformTime::Seconds();
+    RunAllocating(AllocatingResponse);
+    const double AllocatingSeconds = FPlatformTime::Seconds() - Start;
+
+    Start = FPlatformTime::Seconds();
+    RunTable(TableResponse);
+    const double TableSeconds = FPlatformTime::Seconds() - Start;
+
+    TestTrue(TEXT("Allocating path streams the exact text"), AllocatingResponse == Expected);
+    TestTrue(TEXT("Table path streams the exact text"), TableResponse == Expected);
+    TestEqual(TEXT("Reused response buffer didn't grow"), (int64)TableResponse.capacity(), (int64)WarmCapacity);
+    TestEqual(TEXT("Every byte reached the callbacks"), CallbackBytes, (int64)Expected.size() * 4);
+
+    AddInfo(FString::Printf(TEXT("Per token overhead excluding decode: %.1f ns allocating, %.1f ns table (%d tokens, piece table %llu KB)"),
+        AllocatingSeconds * 1e9 / BenchTokenCount, TableSeconds * 1e9 / BenchTokenCount, BenchTokenCount, (uint64)(Table.GetAllocatedSize() / 1024)));
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -75,6 +75,9 @@ bool FLlamaUTF8ConversionRoundTripTest::RunTest(const FString& /*Parameters*/)
                       static_cast<int32>(Stage1.size()), ExpectedBytes);
         }
 
+        // View overload (token pieces aren't null terminated) must decode the same bytes.
+        TestEqual(TEXT("string_view conversion matches"), FLlamaString::ToUE(std::string_view(Stage1)), Original);
+
         // Triple round-trip — guards against any layer that truncates on second pass.
         const std::string Stage2 = FLlamaString::ToStd(Recovered);
         const FString  Recovered2 = FLlamaString::ToUE(Stage2);
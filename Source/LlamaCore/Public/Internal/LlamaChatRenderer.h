@@ -0,0 +1,59 @@
+// Copyright 2025-current Getnamo.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <string>
+#include <vector>
+#include "llama.h"
+
+/**
+* Incremental llama_chat_apply_template renderer for one growing message list.
+*
+* The rendered text of the first N messages is kept in the caller's buffer together with the end offset
+* of every message, so appending a message only renders that message (anchored on its predecessor so
+* templates that special-case a turn's neighbour stay exact) and rolling back just truncates. Templates
+* whose full render isn't the concatenation of these deltas fail the prefix-stability probe in
+* SetTemplate and are always fully re-rendered instead.
+*/
+class FLlamaChatTemplateRenderer
+{
+public:
+    //Empty template uses llama.cpp's default. Runs the prefix-stability probe and drops any cached prefix.
+    void SetTemplate(const std::string& InTemplate);
+
+    bool IsPrefixStable() const { return bPrefixStable; }
+
+    //Render Messages (+ assistant header if bAddAssistant) into Buffer from index 0 and return the length,
+    //or < 0 if the template failed. Buffer is grown as needed but never shrunk. The cached prefix is reused
+    //as long as Messages still starts with the messages rendered last time and Buffer wasn't cleared.
+    int32 Render(const std::vector<llama_chat_message>& Messages, bool bAddAssistant, std::vector<char>& Buffer);
+
+    //Forget the cached prefix, e.g. after the message list or buffer were cleared externally
+    void Reset();
+
+    //Full render of a message list, grows Out to fit. Shared by the incremental path and the fallback.
+    static int32 RenderFull(const std::string& Template, const llama_chat_message* Messages, size_t Count, bool bAddAssistant, std::vector<char>& Out);
+
+    //True if rendering message by message matches the full render for a synthetic multi-turn conversation
+    static bool ProbePrefixStable(const std::string& Template);
+
+protected:
+    //Text that message Index adds after its predecessor. Returns false if the anchored renders aren't prefix-stable.
+    bool RenderMessageDelta(const std::vector<llama_chat_message>& Messages, int32 Index, std::string& OutDelta);
+
+    //Assistant header that bAddAssistant adds after the last message
+    bool RenderAssistantHeader(const std::vector<llama_chat_message>& Messages, std::string& OutHeader);
+
+    std::string Template;
+    bool bPrefixStable = false;
+
+    //Cached prefix: content pointers of rendered messages and the buffer length after each one
+    std::vector<const char*> CachedContents;
+    std::vector<int32> MessageEndOffsets;
+
+    //Scratch buffers for the small anchored renders
+    std::vector<char> ScratchA;
+    std::vector<char> ScratchB;
+};
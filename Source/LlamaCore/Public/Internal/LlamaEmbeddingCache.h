@@ -0,0 +1,103 @@
+// Copyright 2025-current Getnamo.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "HAL/CriticalSection.h"
+
+#include <string>
+#include <vector>
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+//Identifies one embedded text. ModelKey folds in the model file fingerprint, pooling and normalization.
+struct FLlamaEmbeddingCacheKey
+{
+    uint64 ModelKey = 0;
+    uint64 TextHash = 0;
+    uint32 TextBytes = 0;
+
+    bool operator==(const FLlamaEmbeddingCacheKey& Other) const
+    {
+        return ModelKey == Other.ModelKey && TextHash == Other.TextHash && TextBytes == Other.TextBytes;
+    }
+
+    friend uint32 GetTypeHash(const FLlamaEmbeddingCacheKey& Key)
+    {
+        return HashCombine(GetTypeHash(Key.ModelKey), GetTypeHash(Key.TextHash));
+    }
+};
+
+/**
+* Process-wide embedding cache consulted by FLlamaInternal::GetPromptEmbeddingsBatch before anything is
+* tokenized or decoded, so every embedding path (RAG ingest and queries, EmbedTextsAsync, component and
+* subsystem embedding calls) reuses vectors for text it has seen before.
+*
+* Two tiers: an in-memory LRU of recent vectors and an append-only file under Saved/LlamaCache that is
+* memory-mapped and indexed on first use. New vectors are buffered and appended on Flush(). A record cut
+* short by a crash is dropped on the next open. A file past its size limit is rewritten with the newest half
+* of its records, which also bounds the on-disk index. Threadsafe.
+*/
+class FLlamaEmbeddingCache
+{
+public:
+    static FLlamaEmbeddingCache& Get();
+
+    //Grows the in-memory tier to at least MemoryEntries and opens the backing file when bPersist is set.
+    //Called by every instance that loads with the cache enabled, the largest request wins (also for MaxFileBytes).
+    void Configure(int32 MemoryEntries, bool bPersist, int64 MaxFileBytes);
+
+    //Copies the cached vector for this key into OutEmbedding, false on a miss
+    bool Find(const FLlamaEmbeddingCacheKey& Key, std::vector<float>& OutEmbedding);
+
+    //Stores a vector in memory and, when persistent, queues it for the backing file
+    void Add(const FLlamaEmbeddingCacheKey& Key, const std::vector<float>& Embedding);
+
+    //Appends queued vectors to the backing file and remaps it. GetPromptEmbeddingsBatch flushes after every call.
+    void Flush();
+
+    //Drops every cached vector, and the backing file with bDeleteFile
+    void Clear(bool bDeleteFile);
+
+    int32 NumInMemory() const;
+    int32 NumOnDisk() const;
+    FString GetFilePath() const;
+
+    //Moves the backing file, e.g. for tests. Flushes the current file and drops both tiers, the new file is
+    //opened right away when persistent, otherwise on the first Configure that asks for it.
+    void SetFilePath(const FString& InFilePath);
+
+    static FLlamaEmbeddingCacheKey MakeKey(uint64 ModelKey, const std::string& Text);
+
+    //Size plus hash of the first and last MiB of the file. Cheap next to hashing a multi-GB GGUF, and the
+    //head (metadata, tensor table) and tail (weights) change with any requantization or fine-tune.
+    static uint64 FingerprintModelFile(const FString& Path);
+
+protected:
+    FLlamaEmbeddingCache();
+
+    void OpenFile();
+    void MapFile();
+    void UnmapFile();
+    void IndexMappedRecords();
+
+    //Rewrites the file with the newest records that fit in half of MaxFileBytes, pending ones included
+    void CompactFile();
+
+    TLruCache<FLlamaEmbeddingCacheKey, std::vector<float>> Memory;
+
+    //Byte offset of each record's header in the file, offsets at or past MappedSize are in Pending
+    TMap<FLlamaEmbeddingCacheKey, int64> DiskIndex;
+
+    FString FilePath;
+    bool bPersistent = false;
+    int64 MaxFileBytes = 0;
+    TUniquePtr<IMappedFileHandle> MappedHandle;
+    TUniquePtr<IMappedFileRegion> MappedRegion;
+    int64 MappedSize = 0;
+    TArray<uint8> Pending;
+
+    mutable FCriticalSection Mutex;
+};
@@ -3,15 +3,173 @@
 #pragma once
 
 #include "LlamaDataTypes.h"
+#include "Internal/LlamaChatRenderer.h"
+#include "Internal/LlamaStopMatcher.h"
+#include "Internal/LlamaTokenPieceTable.h"
+#include "Internal/LlamaThreadpools.h"
 #include "HAL/ThreadSafeBool.h"
 #include "HAL/ThreadSafeCounter.h"
 
+#include <deque>
 #include <string>
 #include <vector>
 #include "llama.h"
 
 struct mtmd_context;
 
+/** A templated prompt waiting for its slot to become free in the continuous batching scheduler. */
+struct FLlamaScheduledPrompt
+{
+    std::string Prompt;
+    EChatTemplateRole Role = EChatTemplateRole::User;
+    bool bAddAssistantBoS = true;
+    bool bGenerateReply = true;
+    std::string AssistantPrefill;
+
+    //Constrains the reply, see FLlamaInternal::SetSlotGrammar
+    std::string Grammar;
+    std::string JsonSchema;
+
+    //Sampling for this reply only, see FLlamaInternal::SetSlotSampling
+    bool bOverrideSampling = false;
+    FLLMSamplingParams SamplingOverride;
+
+    //LoRA adapter set for this prompt and its reply, see FLlamaInternal::SetSlotLoraOverride
+    bool bOverrideLoraAdapters = false;
+    TArray<FLlamaLoraAdapterScale> LoraAdapters;
+
+    //Called on BT with the emitted response once the reply finishes (only if bGenerateReply)
+    TFunction<void(const std::string& Response)> OnReplyFinished = nullptr;
+};
+
+/** A slot's sampler clones for one FLLMSamplingParams set, see FLlamaInternal::SetSlotSampling. */
+struct FLlamaSamplerSet
+{
+    uint32 ParamsHash = 0;                      //0 == the params the model was loaded with, else a pre-check for Params
+    FLLMSamplingParams Params;                  //compared field-wise on lookup, hashes can collide
+    llama_sampler* Sampler = nullptr;
+    struct common_sampler* CommonSampler = nullptr;
+    uint64 LastUsed = 0;
+};
+
+/** KV of a templated system prompt kept in a reserved sequence past the conversation slots. */
+struct FLlamaPrefixCacheEntry
+{
+    llama_seq_id SeqId = -1;
+    uint64 TokenHash = 0;
+    std::vector<llama_token> Tokens;
+    std::vector<float> LoraScales;              //adapter set the prefix was decoded with
+    uint64 LastUsed = 0;
+};
+
+/** Saved point of a conversation slot, see FLlamaInternal::SnapshotSlot. */
+struct FLlamaKVSnapshot
+{
+    llama_seq_id SeqId = -1;                //spare sequence sharing the KV cells, -1 when held in HostKV
+    std::vector<uint8_t> HostKV;            //llama_state_seq_get_data blob
+    std::vector<std::string> Roles;
+    std::vector<std::string> Contents;
+    std::vector<llama_token> KVTokens;
+    bool bKVTokensValid = true;
+    std::vector<int32> MessageTokenStarts;
+    std::vector<int32> MessageTokenEnds;
+    int32 SharedPrefixTokens = 0;
+};
+
+/** One alternative reply of FLlamaInternal::InsertTemplatedPromptCandidates, decoding in its own KV sequence. */
+struct FLlamaReplyCandidate
+{
+    llama_seq_id SeqId = -1;                    //candidate 0 decodes in the slot's own sequence
+
+    //Own sampler clones (independent RNG), null for candidate 0 which samples with the slot's
+    llama_sampler* Sampler = nullptr;
+    struct common_sampler* CommonSampler = nullptr;
+    llama_sampler* GrammarSampler = nullptr;
+
+    FLlamaStopSequenceMatcher StopMatcher;
+    std::vector<llama_token> Tokens;            //reply tokens in KV, starting at the shared prompt end
+    std::string Response;
+    llama_token NextToken = LLAMA_TOKEN_NULL;   //sampled, decoded in the next step
+    int32 BatchLogitIndex = -1;
+    bool bDone = false;
+    bool bStopMatched = false;
+};
+
+/**
+* Per-conversation state. The slot index doubles as the llama_seq_id of its KV range, so several
+* slots can share one model + context while keeping independent histories.
+*/
+struct FLlamaConversationSlot
+{
+    std::vector<llama_chat_message> Messages;
+    std::vector<char> ContextHistory;
+    int32 FilledContextCharLength = 0;
+
+    //Renders Messages into ContextHistory, caching the rendered prefix so each turn only renders its delta
+    FLlamaChatTemplateRenderer Renderer;
+
+    // Tracks the next KV position for generation. Must be updated explicitly after
+    // multimodal eval (seq_pos_max is wrong for M-RoPE due to 2D spatial positions).
+    llama_pos NextGenerationNPast = 0;
+
+    //Owned clones of the prototype samplers so RNG/penalty history doesn't bleed between slots
+    llama_sampler* Sampler = nullptr;
+    struct common_sampler* CommonSampler = nullptr;
+
+    //Sampler sets not in use right now (the load-time set while an override is active, and recent overrides)
+    std::vector<FLlamaSamplerSet> SamplerPool;
+    uint32 ActiveSamplingHash = 0;
+    FLLMSamplingParams ActiveSampling;          //params of Sampler/CommonSampler, used to build candidate samplers
+
+    //LoRA scale per loaded adapter (FLlamaInternal::LoraAdapters order). The override is the current request's set.
+    std::vector<float> LoraScales;
+    std::vector<float> LoraOverrideScales;
+    bool bLoraOverride = false;
+
+    const std::vector<float>& ActiveLoraScales() const { return bLoraOverride ? LoraOverrideScales : LoraScales; }
+
+    //Continuous batching state, advanced by FLlamaInternal::StepScheduledSlots
+    std::deque<FLlamaScheduledPrompt> QueuedPrompts;
+    FLlamaScheduledPrompt CurrentPrompt;
+    std::vector<llama_token> PrefillTokens;     //templated delta of CurrentPrompt still being decoded
+    int32 PrefillOffset = 0;
+    int32 PrefillInFlight = 0;                  //tokens of PrefillTokens in the batch being decoded
+    bool bScheduledGenerating = false;
+    llama_token PendingToken = LLAMA_TOKEN_NULL; //sampled + emitted, decoded in the next step
+    int32 BatchLogitIndex = -1;                 //row of this slot's logits in the batch being decoded
+    llama_pos ScheduledNPast = 0;
+    std::string ScheduledResponse;
+    int32 ScheduledNDecoded = 0;
+    int64 ScheduledStartTime = 0;
+    bool bStorePrefillInCache = false;          //CurrentPrompt is a system prompt decoded from an empty sequence
+
+    //Token mirror of this slot's KV sequence, KVTokens[i] sits at position i. Appended by every decode
+    //so token rollback is an exact seq_rm. Invalidated by media prompts whose positions aren't 1:1.
+    std::vector<llama_token> KVTokens;
+    bool bKVTokensValid = true;
+
+    //Per-message token span in KVTokens, parallel to Messages. Start is the first content token,
+    //End is one past the last token before the next turn's header. Kept only while the renderer is prefix-stable.
+    std::vector<int32> MessageTokenStarts;
+    std::vector<int32> MessageTokenEnds;
+    int32 ReplyTokenStart = 0;                  //KVTokens size when the current/last reply started sampling
+    std::string ReplyPrefill;                   //assistant prefill the last reply was seeded with
+    int32 SharedPrefixTokens = 0;               //leading cells shared with a prefix cache sequence, never shifted
+    int32 ShiftedTokenCount = 0;                //tokens discarded by context shifts since the last reset
+
+    //FLLMModelParams::StopSequences matcher for the reply being generated, tags are KV positions
+    FLlamaStopSequenceMatcher StopMatcher;
+
+    //Per-request grammar constraint applied ahead of the slot sampler, and its reusable candidate array
+    llama_sampler* GrammarSampler = nullptr;
+    std::vector<llama_token_data> GrammarCandidates;
+
+    bool IsScheduled() const
+    {
+        return bScheduledGenerating || PrefillOffset < (int32)PrefillTokens.size() || !QueuedPrompts.empty();
+    }
+};
+
 /** 
 * Uses mostly Llama.cpp native API, meant to be embedded in LlamaNative that wraps 
 * unreal threading and data types.
@@ -22,6 +180,8 @@ public:
     //Core State
     llama_model* LlamaModel = nullptr;
     llama_context* Context = nullptr;
+
+    //Prototype samplers built from params, cloned into each conversation slot on load
     llama_sampler* Sampler = nullptr;
     struct common_sampler* CommonSampler = nullptr;
 
@@ -29,17 +189,38 @@ public:
     mtmd_context* MtmdContext = nullptr;
     FThreadSafeBool bMtmdLoaded = false;
 
-    //main streaming callback
-    TFunction<void(const std::string& TokenPiece)>OnTokenGenerated = nullptr;
+    //Speculative decoding draft model, only loaded when DraftModelPath is set
+    llama_model* DraftModel = nullptr;
+    llama_context* DraftContext = nullptr;
+
+    //Timings of the last finished generation, valid inside OnGenerationComplete. Should be accessed on BT.
+    FLlamaRunTimings LastRunTimings;
+
+    //Phase timings of the last LoadModelFromParams (system prompt time is filled by the caller)
+    FLlamaLoadTimings LastLoadTimings;
+
+    //main streaming callback. Pieces are views into reused buffers, only valid during the call.
+    TFunction<void(std::string_view TokenPiece)>OnTokenGenerated = nullptr;
+    TFunction<void(int32 CandidateIndex, std::string_view TokenPiece)>OnCandidateTokenGenerated = nullptr;   //InsertTemplatedPromptCandidates streaming
     TFunction<void(int32 TokensProcessed, EChatTemplateRole ForRole, float Speed)>OnPromptProcessed = nullptr;   //useful for waiting for system prompt ready
+    TFunction<void(int32 TokensDone, int32 TokensTotal)>OnPromptProgress = nullptr;   //after each prefill chunk (n_batch tokens)
     TFunction<void(const std::string& Response, float Time, int32 Tokens, float Speed)>OnGenerationComplete = nullptr;
+    TFunction<void(float Progress)>OnLoadProgress = nullptr;    //weight loading 0-1 on the loading thread, in ~1% steps
 
     //NB basic error codes: 1x == Load Error, 2x == Process Prompt error, 3x == Generate error. 1xx == Misc errors
     TFunction<void(const FString& ErrorMessage, int32 ErrorCode)> OnError = nullptr;     //doesn't use std::string due to expected consumer
 
-    //Messaging state
-    std::vector<llama_chat_message> Messages;
-    std::vector<char> ContextHistory;
+    //Messaging state, one entry per conversation slot (sized from MaxConversationSlots on load)
+    std::vector<FLlamaConversationSlot> Slots;
+
+    //Slot the current BG call operates on. Set by every slot-taking entry point and valid while
+    //callbacks fire, so listeners can route per-slot output. Should be accessed on BT.
+    int32 ActiveSlotId = 0;
+
+    FLlamaConversationSlot& ActiveSlot();
+    FLlamaConversationSlot& GetSlot(int32 SlotId);
+    int32 NumSlots() const;
+    bool IsValidSlot(int32 SlotId) const;
 
     //Loaded state
     std::string Template;
@@ -60,13 +241,20 @@ public:
     void UnloadModel();
     bool IsModelLoaded();
 
-    //Generation
-    void ResetContextHistory(bool bKeepSystemsPrompt = false);
-    void RollbackContextHistoryByTokens(int32 NTokensToErase);
-    void RollbackContextHistoryByMessages(int32 NMessagesToErase);
+    //Set from any thread to abort a LoadModelFromParams in progress, it then unloads and returns false.
+    //Not cleared by the load itself so a cancel issued before the load starts still lands, the caller resets it.
+    FThreadSafeBool bLoadCancelRequested = false;
+
+    //True when the last LoadModelFromParams returned false because of bLoadCancelRequested
+    bool bLastLoadCancelled = false;
+
+    //Generation. SlotId selects the conversation (KV sequence) for every call below, 0 is the default slot.
+    void ResetContextHistory(bool bKeepSystemsPrompt = false, int32 SlotId = 0);
+    void RollbackContextHistoryByTokens(int32 NTokensToErase, int32 SlotId = 0);
+    void RollbackContextHistoryByMessages(int32 NMessagesToErase, int32 SlotId = 0);
 
     //raw prompt insert doesn't not update messages, just context history
-    std::string InsertRawPrompt(const std::string& Prompt, bool bGenerateReply = true);
+    std::string InsertRawPrompt(const std::string& Prompt, bool bGenerateReply = true, int32 SlotId = 0);
 
     //main function for structure insert and generation
     //AssistantPrefill: optional text prepended into the assistant turn before sampling resumes.
@@ -75,28 +263,86 @@ public:
     //  OnTokenGenerated, included in the returned response, and stored in the assistant message
     //  history. Useful for steering first-token behavior (e.g. forcing "Answer: " or pre-closing a
     //  thinking block).
-    std::string InsertTemplatedPrompt(const std::string& Prompt, EChatTemplateRole Role = EChatTemplateRole::User, bool bAddAssistantBoS = true, bool bGenerateReply = true, const std::string& AssistantPrefill = "");
+    std::string InsertTemplatedPrompt(const std::string& Prompt, EChatTemplateRole Role = EChatTemplateRole::User, bool bAddAssistantBoS = true, bool bGenerateReply = true, const std::string& AssistantPrefill = "", int32 SlotId = 0);
+
+    //Generate NumCandidates alternative replies to one prompt. The prompt is decoded once and seq_cp'd into spare
+    //candidate sequences (shared cells), then every live candidate advances one token per batched llama_decode with
+    //its own sampler RNG. Pieces stream through OnCandidateTokenGenerated. Candidate 0 is committed as the reply,
+    //the others stay in KV until SelectReplyCandidate or the next candidates call. Returns responses in candidate order.
+    std::vector<std::string> InsertTemplatedPromptCandidates(const std::string& Prompt, EChatTemplateRole Role, int32 NumCandidates, const std::string& AssistantPrefill = "", int32 SlotId = 0);
+
+    //Replace the committed reply with candidate CandidateIndex of the last candidates call (KV copy, no decode).
+    //Fails with error 33 if the conversation changed since. Releases the other candidates either way.
+    bool SelectReplyCandidate(int32 CandidateIndex, int32 SlotId = 0);
 
     //Wipe KV + message state and re-ingest the supplied messages so the KV cache mirrors `Messages`.
     //Each message is fed via InsertTemplatedPrompt(bGenerateReply=false) so the existing template+decode path runs.
     //No reply generation. Caller is responsible for any GT-side state sync.
-    void RebuildContextFromHistory(const TArray<FStructuredChatMessage>& Messages);
+    void RebuildContextFromHistory(const TArray<FStructuredChatMessage>& Messages, int32 SlotId = 0);
 
     //continue generating from last stop
-    std::string ResumeGeneration();
+    std::string ResumeGeneration(int32 SlotId = 0);
 
-    //Feature todo: delete the last message and try again
-    //std::string RerollLastGeneration();
+    //Continuous batching. Queues a templated prompt on a slot without blocking; StepScheduledSlots then
+    //packs one token per generating slot plus prompt prefill chunks into a single llama_decode per step,
+    //so concurrent conversations share each forward pass. Prompts on the same slot run in FIFO order.
+    void ScheduleTemplatedPrompt(const FLlamaScheduledPrompt& Prompt, int32 SlotId = 0);
+
+    //Constrain the slot's following replies to a GBNF grammar, or to JSON matching JsonSchema when Grammar is
+    //empty. Both empty removes the constraint. Emits error 24 and leaves the slot unconstrained if invalid.
+    bool SetSlotGrammar(const std::string& Grammar, const std::string& JsonSchema = "", int32 SlotId = 0);
+
+    //Sample the slot's following replies with Override instead of the load-time FLLMSamplingParams, nullptr
+    //goes back to them. Only sampler chains are built (and pooled per parameter set), model and context are untouched.
+    void SetSlotSampling(const FLLMSamplingParams* Override, int32 SlotId = 0);
+
+    //Select the slot's LoRA adapter set by FLLMModelParams::LoraAdapters name, unlisted adapters are off. nullptr goes
+    //back to the load-time scales. LoRA is set per context, so it's applied whenever the slot decodes and scheduler
+    //steps only batch slots running the same set. Unknown names are skipped with a warning.
+    void SetSlotLoraAdapters(const TArray<FLlamaLoraAdapterScale>* Adapters, int32 SlotId = 0);
+
+    //Same for the next request only (prompt + reply) on top of the slot's set, nullptr clears it
+    void SetSlotLoraOverride(const TArray<FLlamaLoraAdapterScale>* Adapters, int32 SlotId = 0);
+
+    //One scheduler step, returns the number of tokens decoded (0 == nothing to do). Call on BT.
+    int32 StepScheduledSlots();
+
+    //Threadsafe, true while any slot has queued, prefilling or generating scheduled work
+    bool HasScheduledWork();
+
+    //Drop the last assistant reply and generate a new one. With an exact token index this is a seq_rm back
+    //to the reply start plus a single re-decode for fresh logits, no tokenizer pass; otherwise it falls back
+    //to a message rollback + ResumeGeneration.
+    std::string RegenerateLastReply(int32 SlotId = 0);
+
+    //Session state. Save writes a versioned blob with the slot's KV sequence (llama_state_seq_get_data), token
+    //mirror, messages and sampler seed; Load restores it with a single llama_state_seq_set_data, no re-decode.
+    //Errors: 104 save failed, 105 bad/corrupt file or rejected KV, 106 saved with a different model.
+    bool SaveSlotState(TArray<uint8>& OutData, bool bCompress = false, int32 SlotId = 0);
+    bool LoadSlotState(const TArray<uint8>& InData, int32 SlotId = 0);
+
+    //Fingerprint of the loaded model stored in session files
+    uint64 ModelStateHash() const;
+
+    //In-memory branch points. SnapshotSlot stores the slot's KV + history under Handle, seq_cp'd into a spare
+    //sequence when one is free (shared cells, no copy) or copied to host memory otherwise. RestoreSnapshot
+    //puts it back into a slot and keeps the snapshot, so several branches can be explored from one point.
+    bool SnapshotSlot(int32 Handle, int32 SlotId = 0);
+    bool RestoreSnapshot(int32 Handle, int32 SlotId = 0);
+    void ReleaseSnapshot(int32 Handle);
 
     std::string WrapPromptForRole(const std::string& Text, EChatTemplateRole Role, const std::string& OverrideTemplate, bool bAddAssistantBoS = false);
 
 
-    //flips bGenerationActive which will stop generation on next token. Threadsafe call.
+    //flips bGenerationActive which will stop generation on next token, scheduled slots stop on the next step.
+    //A prefill in progress stops at the next chunk and its prompt is rolled back. Threadsafe call.
     void StopGeneration();
+
+    //True while the synchronous Generate loop runs. Scheduled slot generation is tracked by HasScheduledWork.
     bool IsGenerating();
 
     int32 MaxContext();
-    int32 UsedContext();
+    int32 UsedContext(int32 SlotId = 0);
 
     FLlamaInternal();
     ~FLlamaInternal();
@@ -111,7 +357,7 @@ public:
     int32 GetAudioSampleRate();
 
     //Main multimodal prompt entry point
-    std::string InsertMultimodalPrompt(const std::string& TextWithMarkers, const TArray<FLlamaMediaEntry>& MediaEntries, EChatTemplateRole Role, bool bAddAssistantBoS, bool bGenerateReply);
+    std::string InsertMultimodalPrompt(const std::string& TextWithMarkers, const TArray<FLlamaMediaEntry>& MediaEntries, EChatTemplateRole Role, bool bAddAssistantBoS, bool bGenerateReply, int32 SlotId = 0);
 
     //for embedding models
 
@@ -120,12 +366,21 @@ public:
     //with LLAMA_POOLING_TYPE_NONE, per-token embeddings are mean-pooled and re-L2-normalized.
     void GetPromptEmbeddings(const std::string& Text, std::vector<float>& Embeddings);
 
+    //Embed many texts, packed one per sequence into shared decodes of up to n_batch tokens / n_seq_max sequences
+    //(FLLMModelAdvancedParams::EmbeddingBatchSequences). With bBucketEmbeddingsByLength texts are decoded grouped by
+    //token-length bucket. OutEmbeddings is in input order, empty for texts that failed. OnEmbedding fires after each
+    //decode for the texts it produced, which isn't input order when bucketing. With bEmbeddingCache, texts found in
+    //FLlamaEmbeddingCache are returned first without being tokenized or decoded.
+    void GetPromptEmbeddingsBatch(const std::vector<std::string>& Texts, std::vector<std::vector<float>>& OutEmbeddings,
+        TFunction<void(int32 Index, const std::vector<float>& Embedding)> OnEmbedding = nullptr);
+
     //Per-vector embedding dimension of the loaded embedding model. 0 if not loaded.
     int32 GetEmbeddingDimension() const;
 
 protected:
     //Wrapper for user<->assistant templated conversation
     int32 ProcessPrompt(const std::string& Prompt, EChatTemplateRole Role = EChatTemplateRole::Unknown);
+    int32 ProcessPromptTokens(const std::vector<llama_token>& PromptTokens, EChatTemplateRole Role = EChatTemplateRole::Unknown);
     int32 ProcessMultimodalPrompt(const std::string& FormattedPrompt, const TArray<FLlamaMediaEntry>& MediaEntries, EChatTemplateRole Role, bool bLogitsLast = true);
     //AssistantPrefill: if non-empty, seeds the response accumulator with this text and emits it
     //  through OnTokenGenerated as if the model produced it. Caller is responsible for having
@@ -139,16 +394,185 @@ protected:
 
     const char* RoleForEnum(EChatTemplateRole Role);
 
+    //Validates and activates a slot for the current call. Emits error 103 and returns false if out of range.
+    bool SelectSlot(int32 SlotId, const FString& FunctionName);
+
+    //Allocate per-slot state + sampler clones (plus reserved prefix cache sequences), and free them again on unload
+    void InitSlots(int32 SlotCount, int32 PrefixCacheCount = 0, int32 SnapshotSeqCount = 0, int32 CandidateSeqCount = 0);
+    void FreeSlots();
+
+    //Shared system prompt prefix cache. Only applies to a system prompt inserted into an empty sequence.
+    //Restore copies a cached KV range into SeqId (llama_memory_seq_cp) and returns false on a miss.
+    bool RestorePrefixFromCache(const std::vector<llama_token>& Tokens, llama_seq_id SeqId);
+    void StorePrefixInCache(const std::vector<llama_token>& Tokens, llama_seq_id SeqId);
+
+    //Sync insert path for a system prompt into an empty slot: cache hit or decode + store.
+    //Returns false when the cache doesn't apply and the caller should use ProcessPromptTokens.
+    bool ProcessPromptWithPrefixCache(const std::vector<llama_token>& Tokens, EChatTemplateRole Role);
+
+    std::vector<FLlamaPrefixCacheEntry> PrefixCache;
+    uint64 PrefixCacheClock = 0;
+
+    TMap<int32, FLlamaKVSnapshot> Snapshots;
+    std::vector<llama_seq_id> FreeSnapshotSeqs;
+
+    //Move sequence-held snapshots to host memory, needed before seq_add shifts cells they share
+    void DemoteSequenceSnapshots();
+
+    //Reply candidates held for SelectReplyCandidate. Index 0 mirrors the reply committed to CandidateSlotId.
+    std::vector<FLlamaReplyCandidate> ReplyCandidates;
+    std::vector<llama_seq_id> CandidateSeqs;
+    int32 CandidateSlotId = -1;
+    int32 CandidateReplyStart = 0;
+
+    //Batched decode loop of InsertTemplatedPromptCandidates, the prompt is already in the active slot's KV
+    std::vector<std::string> GenerateCandidates(int32 NumCandidates, const std::string& AssistantPrefill);
+
+    //Sample with a candidate's samplers by swapping them into the slot for the call
+    llama_token SampleCandidateToken(FLlamaConversationSlot& Slot, FLlamaReplyCandidate& Candidate, int32 LogitIndex);
+    void FreeCandidateSamplers(FLlamaReplyCandidate& Candidate);
+
+    //Drop held candidates and clear their sequences, needed before seq_add shifts cells they share
+    void ReleaseReplyCandidates();
+
+    //Decode a contiguous token run into one sequence starting at StartPos, splitting at n_batch.
+    //Only the final token requests logits. Returns llama_decode's result (0 == success).
+    int32 DecodeTokensForSeq(const llama_token* Tokens, int32 NTokens, llama_pos StartPos, llama_seq_id SeqId);
+
+    //Token mirror upkeep (see FLlamaConversationSlot::KVTokens)
+    void AppendToTokenMirror(llama_seq_id SeqId, const llama_token* Tokens, int32 NTokens, llama_pos StartPos);
+    void TruncateSlotKV(int32 SlotId, int32 NTokensToKeep);
+    void ClearTokenMirror(FLlamaConversationSlot& Slot);
+    void RecordMessageTokenSpan(int32 Start, int32 End);
+    bool HasExactTokenIndex(const FLlamaConversationSlot& Slot) const;
+
+    //ContextOverflowPolicy::ShiftContext: frees room for NTokensNeeded more tokens by discarding the oldest
+    //tokens after the kept prefix and shifting the rest down. Returns the number discarded, 0 if it can't.
+    int32 ShiftSlotContext(int32 SlotId, int32 NTokensNeeded);
+
+    //Tokenize a templated delta whose first MessageBytes are the message and the rest its assistant header
+    //(+ think/prefill injection). OutMessageTokens is the number of leading tokens that belong to the message.
+    void TokenizeTemplatedDelta(const std::string& Delta, int32 MessageBytes, std::vector<llama_token>& OutTokens, int32& OutMessageTokens);
+
+    //Build the sampler chain (+ common sampler if enabled) for a parameter set
+    void BuildSamplers(const FLLMSamplingParams& Params, int32 Seed, llama_sampler*& OutSampler, struct common_sampler*& OutCommonSampler);
+
+    //Reset the slot's active samplers and feed them the tail of the slot's reply tokens so penalties see the history
+    void ReplaySamplerHistory(FLlamaConversationSlot& Slot, int32 PenaltyLastN);
+
+    //Max parked override sets per slot, the load-time set is never evicted
+    static constexpr int32 MaxPooledSamplerSets = 4;
+    uint64 SamplerPoolClock = 0;
+
+    //Sample the next token for a slot from the logits at LogitIndex and accept it into the slot sampler
+    llama_token SampleSlotToken(FLlamaConversationSlot& Slot, int32 LogitIndex);
+
+    //Grammar path of SampleSlotToken: mask with the grammar, skip the sampler chain when only one token is allowed
+    llama_token SampleConstrainedSlotToken(FLlamaConversationSlot& Slot, int32 LogitIndex);
+
+    //Tokens the active slot's grammar forces after its last accepted token (only one continuation allowed).
+    //Verified like draft tokens, so they are batch decoded and always accepted.
+    void ProposeForcedTokens(int32 MaxDraft, std::vector<llama_token>& OutDraft);
+
+    //Forced tokens batched per decode, independent of Speculative.DraftTokens (also bounded by the batch size)
+    static constexpr int32 MaxForcedTokens = 32;
+
+    //Number of grammar-allowed candidates (stops counting at 2), OutToken is the last allowed one
+    static int32 CountAllowedCandidates(const llama_token_data_array& Candidates, llama_token& OutToken);
+
+    //Draft model lifetime. Init emits error 12 and leaves speculation off if the draft can't be used.
+    bool InitDraftModel(const FString& DraftModelPath);
+    void FreeDraftModel();
+
+    //Greedy draft of up to MaxDraft tokens following the active slot's KV + LastToken. Stops early at
+    //low draft confidence or end of generation. OutDraft is empty when speculation doesn't apply.
+    void ProposeDraftTokens(llama_token LastToken, int32 MaxDraft, std::vector<llama_token>& OutDraft);
+
+    //Prompt lookup drafting: continuation of the most recent earlier occurrence of the n-gram ending in LastToken
+    void ProposeLookupTokens(llama_token LastToken, int32 MaxDraft, std::vector<llama_token>& OutDraft);
+
+    //n-gram hash -> mirror index of the n-gram's last token, indexed incrementally for LookupSlotId
+    TMap<uint64, int32> LookupTable;
+    int32 LookupIndexedTokens = 0;
+    int32 LookupSlotId = -1;
+    int32 LookupShiftCount = 0;
+
+    //Tokens held in the draft context's single sequence, used to reuse its KV across calls
+    std::vector<llama_token> DraftKVTokens;
+    llama_batch DraftBatch = {};
+    int32 DraftBatchCapacity = 0;
+
+    //Piece of every vocab token, built on load so sampled tokens detokenize without allocating
+    FLlamaTokenPieceTable PieceTable;
+
+    //LoRA adapters of the loaded model (registry shared), the scales they start at, and what the context runs now
+    std::vector<llama_adapter_lora*> LoraAdapters;
+    std::vector<std::string> LoraAdapterNames;
+    std::vector<float> DefaultLoraScales;
+    std::vector<float> AppliedLoraScales;
+
+    //Load FLLMModelParams::LoraAdapters, emits error 13 for each one that fails (the model stays loaded without it)
+    void LoadLoraAdapters(const TArray<FLlamaLoraAdapter>& Adapters);
+    void FreeLoraAdapters();
+    void ResolveLoraScales(const TArray<FLlamaLoraAdapterScale>& Adapters, std::vector<float>& OutScales) const;
+
+    //Set the adapters on the context if they differ from what it runs
+    void ApplyLoraScales(const std::vector<float>& Scales);
+
+    //CPU decode/prefill pools shared by the main and draft contexts, kept across reloads with the same settings
+    FLlamaThreadpools Threadpools;
+
+    //Response accumulator of the sync Generate loop, keeps its capacity across generations
+    std::string ResponseBuffer;
+
+    //Reused for all sequence-addressed decodes, sized to n_batch on load
+    llama_batch SeqBatch = {};
+    int32 SeqBatchCapacity = 0;
+
+    //Embedding mode: FLlamaEmbeddingCache key of the loaded model file + pooling + normalization, 0 when the cache is off
+    uint64 EmbeddingCacheModelKey = 0;
+
+    //Shared by InsertTemplatedPrompt and the scheduler: appends the message (plus think/prefill injection)
+    //to the active slot's history and returns the new filled length, or < 0 if templating failed.
+    //OutMessageEndLen receives the length up to the end of the message itself, before the assistant header.
+    int32 AppendTemplatedPromptToHistory(const std::string& Prompt, EChatTemplateRole Role, bool bAddAssistantBoS, const std::string& AssistantPrefill, int32* OutMessageEndLen = nullptr);
+
+    //Appends the finished assistant reply to the active slot's messages, returns the (thinking-stripped) emitted response
+    std::string CommitResponse(const std::string& Response, bool bAppendToMessageHistory);
+
+    //Scheduler helpers, each selects SlotId as the active slot so callbacks can route by it
+    bool BeginScheduledPrompt(int32 SlotId);
+    //bCommitResponse=false is the error path: the partial reply is handed back but not added to history
+    void FinishScheduledGeneration(int32 SlotId, bool bCommitResponse = true);
+    void SampleScheduledSlot(int32 SlotId);
+
+    //Run a slot's scheduled work to completion before a synchronous call touches it
+    void DrainScheduledSlot(int32 SlotId);
+
+    //Stop a slot's scheduled work: outstanding prefill/pending tokens are flushed into KV so it stays
+    //in sync with the message history, the partial reply is committed and queued prompts are dropped.
+    void CancelScheduledSlot(int32 SlotId);
+    void UpdateScheduledWorkState();
+
+    //Decode a batch and a single token on a context and clear it, so first-use costs are paid at load
+    void WarmUpContext(llama_context* WarmContext, const llama_model* WarmModel);
+
+    //Unloads what was loaded so far if bLoadCancelRequested is set
+    bool HandleLoadCancel(const TCHAR* Phase);
+    float LastReportedLoadProgress = 0.f;
+
+    int32 PrefillCursor = 0;
+    FThreadSafeBool bScheduledWorkActive = false;
+    FThreadSafeBool bStopScheduledRequested = false;
+
     FThreadSafeBool bIsModelLoaded = false;
-    int32 FilledContextCharLength = 0;
     FThreadSafeBool bGenerationActive = false;
-    enum llama_flash_attn_type SavedFlashAttnType = LLAMA_FLASH_ATTN_TYPE_AUTO;
 
-    // Tracks the next KV position for generation. Must be updated explicitly after
-    // multimodal eval (seq_pos_max is wrong for M-RoPE due to 2D spatial positions).
-    llama_pos NextGenerationNPast = 0;
+    //Set by ProcessPromptTokens when StopGeneration landed mid-prefill or a chunk failed to decode, the partial prompt is already cut from KV
+    bool bPrefillCancelled = false;
+    enum llama_flash_attn_type SavedFlashAttnType = LLAMA_FLASH_ATTN_TYPE_AUTO;
 
     //Embedding Decoding utilities
-    void BatchDecodeEmbedding(llama_context* ctx, llama_batch& batch, float* output, int n_seq, int n_embd, int embd_norm, int max_rows = 0);
+    bool BatchDecodeEmbedding(llama_context* ctx, llama_batch& batch, float* output, int n_seq, int n_embd, int embd_norm, int max_rows = 0);
     void BatchAddSeq(llama_batch& batch, const std::vector<int32_t>& tokens, llama_seq_id seq_id);
 };
\ No newline at end of file
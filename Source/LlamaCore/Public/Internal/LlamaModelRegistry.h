@@ -0,0 +1,63 @@
+// Copyright 2025-current Getnamo.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "llama.h"
+
+#include <string>
+
+/**
+* Process-wide, ref-counted llama_model cache. Every FLlamaInternal (components, subsystems, RAG stores) gets
+* its weights from here, so instances pointing at the same GGUF with the same load settings share one
+* llama_model and only pay for their own context and KV cache.
+*
+* Models are keyed by full path + GPU layers + mmap/mlock. Weights are read-only during inference, so
+* contexts on different threads may decode against the same model concurrently. Threadsafe.
+*/
+class FLlamaModelRegistry
+{
+public:
+    static FLlamaModelRegistry& Get();
+
+    //Returns the shared model for this path/params, loading it on first use. nullptr if the load failed.
+    //Every successful Acquire must be paired with a Release once all contexts on the model are freed.
+    llama_model* Acquire(const std::string& Path, const llama_model_params& Params);
+
+    //Drops one reference, the weights are freed with the last one
+    void Release(llama_model* Model);
+
+    //Number of instances holding this model, 0 if it isn't registry owned
+    int32 GetRefCount(const llama_model* Model) const;
+
+    //Distinct models currently loaded
+    int32 Num() const;
+
+    //LoRA adapters are shared the same way, per model + adapter path. Release every adapter before its model,
+    //adapters still held when the model is freed go with it.
+    llama_adapter_lora* AcquireLora(llama_model* Model, const std::string& Path);
+    void ReleaseLora(llama_model* Model, llama_adapter_lora* Adapter);
+
+protected:
+    static FString MakeKey(const std::string& Path, const llama_model_params& Params);
+
+    struct FLoraEntry
+    {
+        FString Key;
+        llama_adapter_lora* Adapter = nullptr;
+        int32 RefCount = 0;
+    };
+
+    struct FEntry
+    {
+        FString Key;
+        llama_model* Model = nullptr;
+        int32 RefCount = 0;
+        TArray<FLoraEntry> Adapters;
+    };
+
+    FEntry* FindEntry(const llama_model* Model);
+    TArray<FEntry> Entries;
+    mutable FCriticalSection Mutex;
+};
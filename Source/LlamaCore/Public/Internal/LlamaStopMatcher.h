@@ -0,0 +1,77 @@
+// Copyright 2025-current Getnamo.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+* Incremental multi-pattern stop sequence matcher over a streamed byte sequence (Aho-Corasick DFA).
+*
+* Pieces are fed as they are sampled. Bytes that can no longer start a stop sequence are released through
+* GetEmitted() right away; only the suffix that is still a prefix of some pattern is held back, so streaming
+* is delayed by at most one stop sequence length. When a pattern completes, everything before it is released,
+* the match and held bytes are dropped and the caller should stop generating.
+*
+* Each fed piece carries a tag (the KV position of its token) so the caller can cut the KV back to just
+* after the last token whose text was released.
+*/
+class FLlamaStopSequenceMatcher
+{
+public:
+    //Build the automaton. Empty patterns are ignored, no patterns makes Feed a passthrough.
+    void SetPatterns(const std::vector<std::string>& Patterns);
+
+    bool HasPatterns() const { return bHasPatterns; }
+
+    //Start a new stream (keeps patterns)
+    void Reset();
+
+    //Feed the next piece. Returns true when a stop sequence completed inside it. Either way GetEmitted()
+    //then holds the bytes that are safe to stream/append, which excludes the match.
+    //Buffers are reused across calls, so steady state feeding doesn't allocate.
+    bool Feed(std::string_view Piece, int32 Tag);
+
+    const std::string& GetEmitted() const { return Emitted; }
+
+    //Tag of the piece the last match started in. Pieces from this one on hold stop sequence bytes.
+    int32 GetMatchTag() const { return MatchTag; }
+
+    //Tag of the first piece holding no released bytes, i.e. where the KV can be cut without losing streamed
+    //text. When the match starts mid-piece that piece stays, and this is its tag + 1 (tags are consecutive).
+    int32 GetKeepTag() const { return KeepTag; }
+
+    //Release the held suffix at the end of a stream without a match
+    const std::string& Flush();
+
+    //Shift the tags of held pieces, e.g. after a context shift moved their KV positions
+    void OffsetTags(int32 Delta);
+
+protected:
+    //Dense transition table, 256 entries per node
+    std::vector<int32> Transitions;
+
+    //Per node: length of the matched string, and the longest pattern ending here (0 if none)
+    std::vector<int32> Depth;
+    std::vector<int32> MatchLength;
+    bool bHasPatterns = false;
+
+    //Stream state
+    int32 State = 0;
+    int64 StreamOffset = 0;             //absolute offset of Pending[0]
+    std::string Pending;
+    std::string Emitted;
+
+    //First byte offset + tag of the pieces still overlapping Pending
+    struct FPieceMark
+    {
+        int64 Offset;
+        int32 Tag;
+    };
+    std::vector<FPieceMark> Marks;
+    int32 MatchTag = -1;
+    int32 KeepTag = -1;
+};
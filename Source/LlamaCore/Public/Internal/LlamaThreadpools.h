@@ -0,0 +1,44 @@
+// Copyright 2025-current Getnamo.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ggml.h"
+
+struct FLLMThreadingParams;
+struct llama_context;
+
+/**
+* Decode and prefill ggml CPU threadpools owned by one FLlamaInternal. Without them ggml spins up a throwaway
+* pool per graph compute, which adds thread creation jitter to every decoded token and ignores core placement.
+*
+* The pools are attached to every context of the loaded model (main + draft). They are kept across reloads
+* with the same settings and only rebuilt when those change. One pool serves both roles when the thread
+* counts match. Pools are never shared between FLlamaInternal instances, a ggml pool runs one graph at a time.
+*/
+class FLlamaThreadpools
+{
+public:
+    ~FLlamaThreadpools();
+
+    //Create or reuse the pools for these settings. Contexts using the previous pools must be freed first.
+    //Returns false if the CPU backend doesn't provide threadpools, contexts then keep ggml's default threading.
+    bool Configure(const FLLMThreadingParams& Params, int32 DefaultThreads);
+
+    //Attach the pools to a context created after Configure
+    void Attach(llama_context* Context) const;
+
+    void Reset();
+
+    int32 GetDecodeThreads() const { return DecodeThreads; }
+    int32 GetPrefillThreads() const { return PrefillThreads; }
+
+protected:
+    ggml_threadpool_t DecodePool = nullptr;
+    ggml_threadpool_t PrefillPool = nullptr;
+    ggml_threadpool_params DecodePoolParams;
+    ggml_threadpool_params PrefillPoolParams;
+
+    int32 DecodeThreads = 0;
+    int32 PrefillThreads = 0;
+};
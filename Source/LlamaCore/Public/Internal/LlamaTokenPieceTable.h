@@ -0,0 +1,48 @@
+// Copyright 2025-current Getnamo.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct llama_vocab;
+
+/**
+* Detokenized piece of every vocab token, built once at model load so the generation loops can turn a
+* sampled token into text with a lookup instead of a llama_token_to_piece call and a fresh std::string.
+*
+* All pieces live in one byte buffer owned by this module (see the allocator note in LlamaInternal.cpp),
+* Get() returns a view into it that stays valid until the next Build/Reset.
+*/
+class FLlamaTokenPieceTable
+{
+public:
+    //Detokenize the whole vocab, special tokens rendered as text like the generation loops expect
+    void Build(const llama_vocab* Vocab);
+
+    //Table over caller supplied pieces, token i maps to Pieces[i]
+    void BuildFromPieces(const std::vector<std::string>& Pieces);
+
+    void Reset();
+
+    //Piece of Token, empty for ids outside the vocab
+    std::string_view Get(int32 Token) const
+    {
+        if (Token < 0 || Token + 1 >= (int32)Offsets.size())
+        {
+            return std::string_view();
+        }
+        return std::string_view(Bytes.data() + Offsets[Token], Offsets[Token + 1] - Offsets[Token]);
+    }
+
+    int32 Num() const { return FMath::Max((int32)Offsets.size() - 1, 0); }
+
+    SIZE_T GetAllocatedSize() const { return Bytes.capacity() + Offsets.capacity() * sizeof(int32); }
+
+protected:
+    std::vector<char> Bytes;
+    std::vector<int32> Offsets;         //piece i is [Offsets[i], Offsets[i + 1])
+};
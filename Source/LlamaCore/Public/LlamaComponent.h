@@ -57,6 +57,9 @@ public:
     UPROPERTY(BlueprintAssignable)
     FOnPromptProcessedSignature OnPromptProcessed;
 
+    UPROPERTY(BlueprintAssignable)
+    FOnPromptProgressSignature OnPromptProgress;
+
     UPROPERTY(BlueprintAssignable)
     FOnEmbeddingsSignature OnEmbeddings;
 
@@ -72,6 +75,9 @@ public:
     UPROPERTY(BlueprintAssignable)
     FModelNameSignature OnModelLoaded;
 
+    UPROPERTY(BlueprintAssignable)
+    FOnModelLoadProgressSignature OnModelLoadProgress;
+
     UPROPERTY(BlueprintAssignable)
     FOnErrorSignature OnError;
 
@@ -125,6 +131,10 @@ public:
     UFUNCTION(BlueprintCallable, Category = "LLM Model Component")
     void UnloadModel();
 
+    /** Abort a LoadModel in progress, OnModelLoaded won't fire for it. */
+    UFUNCTION(BlueprintCallable, Category = "LLM Model Component")
+    void CancelLoadModel();
+
     UFUNCTION(BlueprintPure, Category = "LLM Model Component")
     bool IsModelLoaded() const;
 
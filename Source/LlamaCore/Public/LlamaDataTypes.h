@@ -18,10 +18,12 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnErrorSignature, const FString&,
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnTokenGeneratedSignature, const FString&, Token);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnResponseGeneratedSignature, const FString&, Response);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FModelNameSignature, const FString&, ModelName);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnModelLoadProgressSignature, float, Progress);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPartialSignature, const FString&, Partial);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPromptHistorySignature, FString, History);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnEndOfStreamSignature, bool, bStopSequenceTriggered, float, TokensPerSecond);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnPromptProcessedSignature, int32, TokensProcessed, EChatTemplateRole, Role, float, TokensPerSecond);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnPromptProgressSignature, int32, TokensDone, int32, TokensTotal);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FVoidEventSignature);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnEmbeddingsSignature, const TArray<float>&, Embeddings, const FString&, SourceText);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnEmbeddingsBatchSignature, const TArray<FString>&, SourceTexts);
@@ -40,6 +42,33 @@ enum class EMarkdownStreamState : uint8
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnMarkdownPartialSignature, const FString&, Partial, EMarkdownStreamState, State);
 
+//What happens when a prompt or reply no longer fits in a conversation's context
+UENUM(BlueprintType)
+enum class ELlamaContextOverflowPolicy : uint8
+{
+    Error,          //Stop with error 22 (prompt) / 31 (generation)
+    ShiftContext    //Drop the oldest tokens after the kept prefix and shift the rest down, conversation continues
+};
+
+//Storage type of the K or V cache. Quantized types roughly halve (Q8_0) or quarter (Q4_0) KV memory per token.
+UENUM(BlueprintType)
+enum class ELlamaKVCacheType : uint8
+{
+    F16,
+    BF16,
+    F32,
+    Q8_0,
+    Q4_0
+};
+
+UENUM(BlueprintType)
+enum class ELlamaFlashAttention : uint8
+{
+    Auto,           //llama.cpp enables it when the backend supports it
+    Enabled,
+    Disabled
+};
+
 UENUM(BlueprintType)
 enum class ELlamaMediaType : uint8
 {
@@ -115,8 +144,53 @@ struct FLlamaRunTimings
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
     float TokensPerSecond = 0.f;
+
+    //Speculative decoding: tokens proposed by the draft and how many the main model accepted
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    int32 DraftTokensProposed = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    int32 DraftTokensAccepted = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    float DraftAcceptanceRate = 0.f;
 };
 
+//Where the time of the last LoadModel went, in seconds. Valid in OnModelLoaded via ModelState.LastLoadTimings.
+USTRUCT(BlueprintType)
+struct FLlamaLoadTimings
+{
+    GENERATED_USTRUCT_BODY();
+
+    //Reading weights (near 0 when bSharedWeights)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float ModelLoadTime = 0.f;
+
+    //Context, KV cache and sampler setup
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float ContextInitTime = 0.f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float MultimodalInitTime = 0.f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float DraftModelInitTime = 0.f;
+
+    //Warm-up decode, see FLLMModelParams::bWarmUpOnLoad
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float WarmUpTime = 0.f;
+
+    //Prefill of the auto inserted system prompt
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float SystemPromptTime = 0.f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    float TotalTime = 0.f;
+
+    //Weights were already loaded by another instance and are shared
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Load Timings")
+    bool bSharedWeights = false;
+};
 
 USTRUCT(BlueprintType)
 struct FLLMSamplingParams
@@ -254,6 +328,101 @@ struct FLLMOutputParams
     int32 PromptProcessingPacingSplitN = 4;
 };
 
+USTRUCT(BlueprintType)
+struct FLLMSpeculativeParams
+{
+    GENERATED_USTRUCT_BODY();
+
+    //Max tokens proposed per verification batch
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Speculative", meta = (ClampMin = 1))
+    int32 DraftTokens = 8;
+
+    //Drafting stops early once the draft model's top token probability falls below this
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Speculative", meta = (ClampMin = 0, ClampMax = 1))
+    float DraftMinProbability = 0.6f;
+
+    //Draft model GPU layers, -1 uses the main model's GPULayers
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Speculative")
+    int32 DraftGPULayers = -1;
+
+    //Model-free drafting: propose the tokens that followed the last n-gram's previous occurrence in the
+    //conversation. Cheap, and effective when replies quote the prompt (e.g. RAG answers). Tried before the draft model.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Speculative")
+    bool bPromptLookup = false;
+
+    //Tokens that must match before a lookup continuation is proposed
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Speculative", meta = (ClampMin = 1, ClampMax = 8))
+    int32 PromptLookupNGram = 3;
+};
+
+//Context and model memory layout. Applied on load, also to the draft model when one is set.
+USTRUCT(BlueprintType)
+struct FLLMMemoryParams
+{
+    GENERATED_USTRUCT_BODY();
+
+    //K cache type. Q8_0 is close to lossless at about half the memory of F16.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    ELlamaKVCacheType KCacheType = ELlamaKVCacheType::F16;
+
+    //V cache type. Quantized V needs flash attention, Disabled is raised to Auto when one is picked.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    ELlamaKVCacheType VCacheType = ELlamaKVCacheType::F16;
+
+    //Vision models need flash attention for their projector, keep Auto or Enabled when MmprojPath is set
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    ELlamaFlashAttention FlashAttention = ELlamaFlashAttention::Auto;
+
+    //Physical batch size (n_ubatch), capped at MaxBatchLength. Larger values speed up prefill at the cost of compute buffer memory.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory", meta = (ClampMin = 1))
+    int32 MicroBatchLength = 512;
+
+    //Memory map the model file instead of reading it into RAM. Faster loads and pages shared between processes.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    bool bUseMmap = true;
+
+    //Lock the model in RAM so the OS can't page it out
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    bool bUseMlock = false;
+
+    //Run host tensor ops (e.g. CPU resident layers' matmuls for big batches) on the GPU
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    bool bOffloadHostOps = true;
+
+    //One KV pool shared by all conversation slots. When false every slot gets a fixed MaxContextLength / slots share.
+    //Always on while SystemPromptCacheEntries, KVSnapshotSequences or ReplyCandidateSequences are used, they share cells across sequences.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+    bool bUnifiedKVCache = true;
+};
+
+//CPU threading of the decode loop. Pools are created once per loaded model and reused by its main and draft contexts.
+USTRUCT(BlueprintType)
+struct FLLMThreadingParams
+{
+    GENERATED_USTRUCT_BODY();
+
+    //Threads for prompt prefill (compute bound, scales with cores). 0 uses FLLMModelParams::Threads.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Threading", meta = (ClampMin = 0))
+    int32 PrefillThreads = 0;
+
+    //Threads for single token decode (memory bandwidth bound, usually saturates early). 0 uses FLLMModelParams::Threads.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Threading", meta = (ClampMin = 0))
+    int32 DecodeThreads = 0;
+
+    //Logical cores the inference threads may run on, e.g. to keep them off the game and render thread cores.
+    //Empty leaves placement to the OS.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Threading")
+    TArray<int32> CPUAffinityCores;
+
+    //Pin each thread to one core of CPUAffinityCores instead of letting them float across the set
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Threading")
+    bool bStrictCPUPlacement = false;
+
+    //How long idle pool threads spin before sleeping, 0 (never, least CPU contention) to 100 (lowest wake latency)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Threading", meta = (ClampMin = 0, ClampMax = 100))
+    int32 PollLevel = 50;
+};
+
 USTRUCT(BlueprintType)
 struct FLLMModelAdvancedParams
 {
@@ -271,6 +440,15 @@ struct FLLMModelAdvancedParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
     FLLMThinkingParams Thinking;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    FLLMSpeculativeParams Speculative;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    FLLMMemoryParams Memory;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    FLLMThreadingParams Threading;
+
     //use common_init instead of normal - may break functionality, use with care
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
     bool bUseCommonParams = false;
@@ -278,6 +456,33 @@ struct FLLMModelAdvancedParams
     //set to true if you want to use GeneratePromptEmbeddingsForText
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
     bool bEmbeddingMode = false;
+
+    //Embedding mode: max texts packed into one decode by batched embedding calls, each takes a KV sequence.
+    //Texts are packed until MaxBatchLength tokens or this many sequences, a text is truncated to MaxBatchLength.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params", meta = (ClampMin = 1))
+    int32 EmbeddingBatchSequences = 16;
+
+    //Embedding mode: group batched texts into power of two token-length buckets and decode each bucket on its own,
+    //so short chunks don't share a decode with long ones. Results still come back in input order.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    bool bBucketEmbeddingsByLength = true;
+
+    //Embedding mode: reuse vectors for text embedded before, keyed by model file fingerprint, pooling, normalization
+    //and text hash. Checked before tokenizing, so re-ingesting unchanged text or repeating a query costs only hashing.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    bool bEmbeddingCache = true;
+
+    //Embedding cache: vectors kept in memory (LRU), shared by every instance in the process. The largest value wins.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params", meta = (ClampMin = 1))
+    int32 EmbeddingCacheEntries = 16384;
+
+    //Embedding cache: also append vectors to Saved/LlamaCache/Embeddings.lec, memory-mapped on the next run
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params")
+    bool bPersistEmbeddingCache = true;
+
+    //Embedding cache: size limit of the backing file. Past it the file is compacted to the newest half of its vectors.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Advanced Params", meta = (ClampMin = 1))
+    int32 EmbeddingCacheMaxFileMB = 256;
 };
 
 USTRUCT(BlueprintType)
@@ -359,6 +564,41 @@ struct FJinjaChatTemplate
     FString Jinja = TEXT("");
 };
 
+//LoRA adapter loaded once with the model, conversations select it by Name
+USTRUCT(BlueprintType)
+struct FLlamaLoraAdapter
+{
+    GENERATED_USTRUCT_BODY();
+
+    //Referenced by FLlamaLoraAdapterScale::Name, defaults to the file name without extension
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LoRA")
+    FString Name;
+
+    //LoRA GGUF trained for the base model. Paths beginning with '.' are relative to Saved/Models path.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LoRA")
+    FString Path;
+
+    //Scale every conversation starts with, 0 keeps the adapter loaded but inactive until selected
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LoRA")
+    float Scale = 0.f;
+};
+
+//One entry of a conversation's or prompt's active adapter set
+USTRUCT(BlueprintType)
+struct FLlamaLoraAdapterScale
+{
+    GENERATED_USTRUCT_BODY();
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LoRA")
+    FString Name;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LoRA")
+    float Scale = 1.f;
+
+    FLlamaLoraAdapterScale() {}
+    FLlamaLoraAdapterScale(const FString& InName, float InScale = 1.f) : Name(InName), Scale(InScale) {}
+};
+
 //Initial state fed into the model
 USTRUCT(BlueprintType)
 struct FLLMModelParams
@@ -374,6 +614,18 @@ struct FLLMModelParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     FString MmprojPath;
 
+    // Optional small model sharing the main model's vocab for speculative decoding. It drafts up to
+    // Advanced.Speculative.DraftTokens tokens which the main model verifies in one batched decode; output is
+    // identical to normal sampling. Paths beginning with '.' are relative to Saved/Models path.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
+    FString DraftModelPath;
+
+    // LoRA adapters applied on top of the base weights, loaded once and shared by every conversation slot.
+    // Each slot (FLlamaNative::SetLoraAdapters) or prompt (FLlamaChatPrompt::LoraAdapters) picks its own
+    // adapter set and scales, switching needs no reload. Adapters don't apply to the draft model.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
+    TArray<FLlamaLoraAdapter> LoraAdapters;
+
     //Gets embedded on first input after a model load
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params", meta=(MultiLine=true))
     FString SystemPrompt = "You are a helpful assistant.";
@@ -385,6 +637,12 @@ struct FLLMModelParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     bool bAutoLoadModelOnStartup = true;
 
+    //Run a tiny decode right after load so weight paging and GPU kernel setup don't land on the first real prompt.
+    //Moves that cost into the load instead: up to a few seconds for large mmapped models on a cold disk, and a
+    //second pass with a draft model. Off by default, see FLlamaLoadTimings::WarmUpTime when tuning.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
+    bool bWarmUpOnLoad = false;
+
     //When true, this component's local model KV cache is being driven externally (e.g. via
     //ImpersonateTemplatedPrompt / ImpersonateTemplatedToken). Rollback helpers (RemoveLastAssistantReply,
     //RemoveLastUserInput) and RebuildContextFromHistory mutate ModelState only — they will NOT call
@@ -401,7 +659,8 @@ struct FLLMModelParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     EChatTemplateRole ModelRole = EChatTemplateRole::Assistant;
 
-    //Additional stop sequences - not currently active
+    //Additional stop sequences. Generation ends as soon as the reply contains one; the sequence itself is trimmed
+    //from the response and never streamed. Matched natively on the local backend and forwarded as `stop` to remote servers.
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     TArray<FString> StopSequences;
 
@@ -411,6 +670,7 @@ struct FLLMModelParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     int32 GPULayers = 50;
 
+    //CPU threads for prefill and decode, Advanced.Threading can set them separately and pin them to cores
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     int32 Threads = 8;
 
@@ -420,6 +680,40 @@ struct FLLMModelParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     int32 Seed = -1;
 
+    //Number of independent conversations (KV sequences) sharing this model and context. Slot 0 is the
+    //default conversation; extra slots are driven via the FLlamaNative slot API. When > 1 the KV cache
+    //is unified so MaxContextLength is a shared pool across all slots rather than split per slot.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params", meta = (ClampMin = 1))
+    int32 MaxConversationSlots = 1;
+
+    //Number of distinct templated system prompts whose KV is kept in reserved sequences. A new conversation
+    //or a full reset that starts with a cached system prompt copies that KV range instead of re-decoding it,
+    //so slots sharing a persona preamble skip its prefill. Copies share KV cells, 0 disables the cache.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params", meta = (ClampMin = 0))
+    int32 SystemPromptCacheEntries = 1;
+
+    //Spare KV sequences for FLlamaNative::SnapshotState. A snapshot held in a spare sequence shares KV cells
+    //with its conversation so taking/restoring it is near free; once they run out snapshots fall back to a
+    //host memory copy of the sequence. 0 means host copies only.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params", meta = (ClampMin = 0))
+    int32 KVSnapshotSequences = 2;
+
+    //Spare KV sequences for FLlamaNative::InsertTemplatedPromptCandidates, which can generate up to this + 1
+    //alternative replies per prompt. Candidates share the prompt's KV cells and decode in one batch per step.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params", meta = (ClampMin = 0))
+    int32 ReplyCandidateSequences = 3;
+
+    //ShiftContext keeps the system prompt plus ContextShiftKeepTokens, discards half of what follows
+    //(at least enough to fit) and shifts the remainder's positions down, so long chats run at constant
+    //memory without a re-prefill. Discarded turns stay in the chat history but the model no longer sees them.
+    //Text-only, a context holding media embeddings still errors.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
+    ELlamaContextOverflowPolicy ContextOverflowPolicy = ELlamaContextOverflowPolicy::Error;
+
+    //Tokens after the system prompt that are never shifted out, e.g. an opening scene description
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params", meta = (ClampMin = 0))
+    int32 ContextShiftKeepTokens = 0;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model Params")
     FLLMModelAdvancedParams Advanced;
 };
@@ -462,6 +756,10 @@ struct FLLMModelState
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model State")
     FJinjaChatTemplate ChatTemplateInUse;
+
+    //Phase breakdown of the last successful load
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LLM Model State")
+    FLlamaLoadTimings LastLoadTimings;
 };
 
 USTRUCT()
@@ -508,6 +806,32 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat", meta=(MultiLine=true))
     FString AssistantPrefill;
 
+    /** Optional GBNF grammar (root rule "root") the reply must follow, e.g. for structured NPC actions.
+     *  Only applies to this prompt's reply. Tokens the grammar forces are batch decoded without sampling. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat", meta=(MultiLine=true))
+    FString Grammar;
+
+    /** Optional JSON schema the reply must match, converted to a grammar. Ignored when Grammar is set.
+     *  Supports object/array/string/number/integer/boolean/null, enum, const and anyOf/oneOf ($ref isn't). */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat", meta=(MultiLine=true))
+    FString JsonSchema;
+
+    /** Sample this prompt's reply with SamplingOverride instead of the model's load-time sampling params,
+     *  e.g. a low temperature for an NPC's tool call and a high one for banter. Model and context are untouched. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat")
+    bool bOverrideSampling = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat", meta = (EditCondition = "bOverrideSampling"))
+    FLLMSamplingParams SamplingOverride;
+
+    /** Run this prompt and its reply with exactly LoraAdapters (names from ModelParams.LoraAdapters, unlisted ones off)
+     *  instead of the conversation's adapter set, e.g. a persona adapter for one NPC line. Local backend only. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat")
+    bool bOverrideLoraAdapters = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chat", meta = (EditCondition = "bOverrideLoraAdapters"))
+    TArray<FLlamaLoraAdapterScale> LoraAdapters;
+
     FLlamaChatPrompt() {}
 
     FLlamaChatPrompt(const FString& InPrompt, EChatTemplateRole InRole = EChatTemplateRole::User, bool bInAddAssistantBOS = false, bool bInGenerateReply = true, const FString& InAssistantPrefill = TEXT(""))
@@ -65,9 +65,11 @@ public:
     TFunction<void(const FString& Partial, EMarkdownStreamState State)> OnMarkdownPartialGenerated;
     TFunction<void(const FString& Response)>                 OnResponseGenerated;
     TFunction<void(int32 Tokens, EChatTemplateRole, float Speed)> OnPromptProcessed;
+    TFunction<void(int32 TokensDone, int32 TokensTotal)>     OnPromptProgress;
     TFunction<void(bool bStopSeq, float Tps)>                OnEndOfStream;
     TFunction<void()>                                        OnContextReset;
     TFunction<void(const FString& ModelName)>                OnModelLoaded;
+    TFunction<void(float Progress)>                          OnModelLoadProgress;
     TFunction<void(const FString& Err, int32 Code)>          OnError;
     TFunction<void(const TArray<float>&, const FString&)>    OnEmbeddings;
     TFunction<void(const TArray<FString>&)>                  OnAllEmbeddingsGenerated;
@@ -105,6 +107,9 @@ public:
     void UnloadModel();
     bool IsModelLoaded() const;
 
+    /** Abort a local load in progress. Remote loads are just health/props requests and aren't cancelled. */
+    void CancelLoadModel();
+
     // --- Chat / inference ---------------------------------------------------
 
     void InsertTemplatedPrompt(const FLlamaChatPrompt& Prompt);
@@ -178,6 +183,13 @@ private:
     /** Media queued to attach to the next outgoing remote user message. */
     TArray<FLlamaRemoteMediaBlob> PendingUserMedia;
 
+    /** Grammar / JSON schema of the prompt whose reply is about to be streamed. */
+    FString PendingGrammar;
+    FString PendingJsonSchema;
+
+    /** Per-prompt sampling override of the prompt whose reply is about to be streamed. */
+    TOptional<FLLMSamplingParams> PendingSampling;
+
     /** Sentence-splitter buffer for OnPartialGenerated emulation over HTTP deltas. */
     FString PartialBuffer;
 
@@ -26,19 +26,32 @@ public:
 	TFunction<void(const FString& Partial, EMarkdownStreamState State)> OnMarkdownPartialGenerated; //markdown-aware partials
 	TFunction<void(const FString& Response)> OnResponseGenerated;	//per round
 	TFunction<void(int32 TokensProcessed, EChatTemplateRole ForRole, float Speed)> OnPromptProcessed;	//when an inserted prompt has finished processing (non-generation prompt)
+	TFunction<void(int32 TokensDone, int32 TokensTotal)> OnPromptProgress;	//prefill progress of the prompt being processed, per n_batch chunk
+	TFunction<void(float Progress)> OnModelLoadProgress;	//weight loading progress 0-1 during LoadModel
 	TFunction<void()> OnGenerationStarted;
 	TFunction<void(const FLlamaRunTimings& Timings)> OnGenerationFinished;
 	TFunction<void(const FString& ErrorMessage, int32 ErrorCode)> OnError;
 	TFunction<void(const FLLMModelState& UpdatedModelState)> OnModelStateChanged;
 
+	//Per-slot streaming, fires for every conversation slot including slot 0 (see FLLMModelParams::MaxConversationSlots)
+	TFunction<void(int32 SlotId, const FString& Token)> OnSlotTokenGenerated;
+	TFunction<void(int32 SlotId, const FString& Response)> OnSlotResponseGenerated;
+
+	//Reply candidate streaming, see InsertTemplatedPromptCandidates
+	TFunction<void(int32 CandidateIndex, const FString& Token)> OnCandidateTokenGenerated;
+
 	//Expected to be set before load model
 	void SetModelParams(const FLLMModelParams& Params);
 
-	//Loads the model found at ModelParams.PathToModel, use SetModelParams to specify params before loading
+	//Loads the model found at ModelParams.PathToModel, use SetModelParams to specify params before loading.
+	//StatusCode is 0 on success, 15 on failure and 16 when cancelled. ModelState.LastLoadTimings holds the phase breakdown.
 	void LoadModel(bool bForceReload = false, TFunction<void(const FString&, int32 StatusCode)> ModelLoadedCallback = nullptr);
 	void UnloadModel(TFunction<void(int32 StatusCode)> ModelUnloadedCallback = nullptr);
 	bool IsModelLoaded();
 
+	//Aborts a queued or running LoadModel, the partial load is freed. Threadsafe.
+	void CancelLoadModel();
+
 	//Prompt input
 	void InsertTemplatedPrompt(const FLlamaChatPrompt& Prompt,
 		TFunction<void(const FString& Response)>OnResponseFinished = nullptr);
@@ -55,6 +68,39 @@ public:
 	 *  Runs on a BG task; OnDone fires on the game thread once GT model state has been synced. */
 	void RebuildContextFromHistory(const FStructuredChatHistory& History,
 		TFunction<void()> OnDone = nullptr);
+	/** Persist a conversation's KV cache, token mirror and messages so a save game resumes without
+	 *  re-evaluating its history. Load is a straight KV copy (no decode) followed by a GT model state sync.
+	 *  Files are versioned and tied to the loaded model; bCompress trades save/load time for ~2-4x smaller files.
+	 *  Paths beginning with '.' are relative to Saved/Models. OnDone fires on the game thread. */
+	void SaveSessionState(const FString& FilePath, bool bCompress = false,
+		TFunction<void(bool bSuccess)> OnDone = nullptr, int32 SlotId = 0);
+	void LoadSessionState(const FString& FilePath,
+		TFunction<void(bool bSuccess)> OnDone = nullptr, int32 SlotId = 0);
+
+	/** Branch points for dialogue trees and rerolls. SnapshotState returns a handle immediately (the capture
+	 *  runs in order on the BG thread, so a following RestoreSnapshot sees it). RestoreSnapshot rewinds the
+	 *  conversation without re-decoding the shared history and keeps the snapshot for further branches.
+	 *  Snapshots live in spare KV sequences (ModelParams.KVSnapshotSequences) or host memory; release unused ones. */
+	int32 SnapshotState(int32 SlotId = 0);
+	void RestoreSnapshot(int32 Handle, TFunction<void(bool bSuccess)> OnDone = nullptr, int32 SlotId = 0);
+	void ReleaseSnapshot(int32 Handle);
+
+	/** Pick the conversation's LoRA adapters by ModelParams.LoraAdapters name and scale, unlisted adapters are off.
+	 *  Applies from the slot's next prompt, no reload. Reset goes back to the load-time scales. Per prompt
+	 *  selection is FLlamaChatPrompt::LoraAdapters. Slots with different sets don't share a batched decode. */
+	void SetLoraAdapters(const TArray<FLlamaLoraAdapterScale>& Adapters, int32 SlotId = 0);
+	void ResetLoraAdapters(int32 SlotId = 0);
+
+	/** Dialogue options: NumCandidates alternative replies to one prompt. The prompt is prefilled once and shared
+	 *  by all candidates, which then decode together one batched token per step with independent sampler RNGs.
+	 *  Tokens stream through OnCandidateTokenGenerated. Candidate 0 is committed to the chat history (and fires
+	 *  the usual response callbacks); SelectReplyCandidate swaps in another one without re-decoding.
+	 *  Needs ModelParams.ReplyCandidateSequences >= NumCandidates - 1. Candidates belong to SlotId, select with
+	 *  the same slot; a new candidate prompt on any slot releases the previous ones. */
+	void InsertTemplatedPromptCandidates(const FLlamaChatPrompt& Prompt, int32 NumCandidates,
+		TFunction<void(const TArray<FString>& Candidates)> OnCandidatesFinished = nullptr, int32 SlotId = 0);
+	void SelectReplyCandidate(int32 CandidateIndex, TFunction<void(bool bSuccess)> OnDone = nullptr, int32 SlotId = 0);
+
 	bool IsGenerating();
 	void StopGeneration();
 	void ResumeGeneration();
@@ -72,7 +118,7 @@ public:
 	void ResetContextHistory(bool bKeepSystemPrompt = false);	//full reset
 	void RemoveLastUserInput();		//chat rollback to undo last user input
 	void RemoveLastReply();		//chat rollback to undo last assistant input.
-	void RegenerateLastReply(); //removes last reply and regenerates (changing seed?)
+	void RegenerateLastReply(); //removes last reply and regenerates from the same KV prefix
 
 	//Base api to do message rollback
 	void RemoveLastNMessages(int32 MessageCount);	//rollback
@@ -82,6 +128,19 @@ public:
 	//Pure query of current game thread context
 	void SyncPassedModelStateToNative(FLLMModelState& StateToSync);
 
+	/** Conversation slots: independent chats sharing this model + KV context, one KV sequence each.
+	 *  Slot 0 is the default conversation driven by the API above and mirrored in ModelState; slots
+	 *  1..N-1 only stream through OnSlotTokenGenerated / OnSlotResponseGenerated. Requires
+	 *  ModelParams.MaxConversationSlots > 1 at load, invalid slots raise error 103.
+	 *  Slot prompts are continuously batched: every active slot advances one token per shared decode,
+	 *  interleaved with prefill of newly queued prompts, so concurrent chats scale aggregate tokens/sec. */
+	void InsertTemplatedPromptInSlot(int32 SlotId, const FLlamaChatPrompt& Prompt,
+		TFunction<void(const FString& Response)>OnResponseFinished = nullptr);
+	void ResetSlotContextHistory(int32 SlotId, bool bKeepSystemPrompt = false);
+	void RemoveLastNMessagesInSlot(int32 SlotId, int32 MessageCount);
+	void GetSlotChatHistory(int32 SlotId, TFunction<void(const FStructuredChatHistory& History)> OnHistory);
+	int32 GetConversationSlotCount() const;
+
 	FString WrapPromptForRole(const FString& Text, EChatTemplateRole Role, const FString& OverrideTemplate, bool bAddAssistantBoS = false);
 
 	//Multimodal queries
@@ -95,9 +154,9 @@ public:
 	//Embed a prompt and return the embeddings (single pooled vector of length GetEmbeddingDimension()).
 	void GetPromptEmbeddings(const FString& Text, TFunction<void(const TArray<float>& Embeddings, const FString& SourceText)>OnEmbeddings = nullptr);
 
-	//Sequentially embed N prompts on the BG thread, emitting once per text. The OnAllEmbeddings
-	//callback (if provided) fires once on the GT after every input has been processed, with results
-	//in input order. Useful for ingesting a corpus into a vector store.
+	//Embed N prompts on the BG thread, packing several texts into each decode (ModelParams.Advanced.EmbeddingBatchSequences).
+	//OnEmbeddings fires once per text in input order. The OnAllEmbeddings callback (if provided) fires once on the GT
+	//after every input has been processed, with results in input order. Useful for ingesting a corpus into a vector store.
 	void GetPromptEmbeddingsBatch(const TArray<FString>& Texts,
 		TFunction<void(const TArray<float>& Embeddings, const FString& SourceText)>OnEmbeddings = nullptr,
 		TFunction<void(const TArray<TArray<float>>& AllEmbeddings, const TArray<FString>& AllSourceTexts)>OnAllEmbeddings = nullptr);
@@ -124,8 +183,9 @@ protected:
 	void SyncModelStateToInternal(TFunction<void()>AdditionalGTStateUpdates = nullptr);
 
 	//utility functions, only safe to call on bg thread
-	int32 RawContextHistory(FString& OutContextString);
-	void GetStructuredChatHistory(FStructuredChatHistory& OutChatHistory);
+	void SchedulePromptInSlot(int32 SlotId, const FLlamaChatPrompt& Prompt, TFunction<void(const FString& Response)> OnResponseFinished);
+	int32 RawContextHistory(FString& OutContextString, int32 SlotId = 0);
+	void GetStructuredChatHistory(FStructuredChatHistory& OutChatHistory, int32 SlotId = 0);
 	int32 UsedContextLength();
 
 	//GT State - safely accesible on game thread
@@ -151,6 +211,7 @@ protected:
 	FThreadSafeBool bThreadIsActive = false;
 	FThreadSafeBool bThreadShouldRun = false;
 	FThreadSafeCounter TaskIdCounter = 0;
+	FThreadSafeCounter SnapshotHandleCounter = 0;
 	int64 GetNextTaskId();
 
 	void EnqueueBGTask(TFunction<void(int64)> Task);
@@ -46,6 +46,9 @@ public:
     UPROPERTY(BlueprintAssignable)
     FOnPromptProcessedSignature OnPromptProcessed;
 
+    UPROPERTY(BlueprintAssignable)
+    FOnPromptProgressSignature OnPromptProgress;
+
     UPROPERTY(BlueprintAssignable)
     FOnEmbeddingsSignature OnEmbeddings;
 
@@ -64,6 +67,9 @@ public:
     UPROPERTY(BlueprintAssignable)
     FModelNameSignature OnModelLoaded;
 
+    UPROPERTY(BlueprintAssignable)
+    FOnModelLoadProgressSignature OnModelLoadProgress;
+
     UPROPERTY(BlueprintAssignable)
     FOnErrorSignature OnError;
 
@@ -117,6 +123,10 @@ public:
     UFUNCTION(BlueprintCallable, Category = "LLM Model Subsystem")
     void UnloadModel();
 
+    /** Abort a LoadModel in progress, OnModelLoaded won't fire for it. */
+    UFUNCTION(BlueprintCallable, Category = "LLM Model Subsystem")
+    void CancelLoadModel();
+
     UFUNCTION(BlueprintPure, Category = "LLM Model Subsystem")
     bool IsModelLoaded() const;
 
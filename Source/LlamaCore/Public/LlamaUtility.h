@@ -3,6 +3,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "CoreMinimal.h"
 
@@ -22,6 +23,7 @@ class LLAMACORE_API FLlamaString
 {
 public:
 	static FString ToUE(const std::string& String);
+	static FString ToUE(std::string_view String);		//no null terminator needed, e.g. token piece views
 	static std::string ToStd(const FString& String);
 
 	//Simple utility functions to find the last sentence
@@ -29,4 +31,13 @@ public:
 	static FString GetLastSentence(const FString& InputString);
 
 	static void AppendToCharVector(std::vector<char>& VectorHistory, const std::string& Text);
-};
\ No newline at end of file
+};
+
+class LLAMACORE_API FLlamaGrammar
+{
+public:
+	//Convert a JSON schema into a GBNF grammar whose root rule only accepts matching JSON. Supports the
+	//subset game actions need: object (properties/required), array (items/minItems/maxItems), string, number,
+	//integer, boolean, null, enum, const, anyOf/oneOf and type lists. Returns false with OutError otherwise.
+	static bool JsonSchemaToGbnf(const FString& JsonSchema, FString& OutGrammar, FString& OutError);
+};
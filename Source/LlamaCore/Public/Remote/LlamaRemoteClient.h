@@ -26,6 +26,10 @@ struct FLlamaRemoteChatRequest
     /** For /v1/completions path: raw prompt string (bypasses chat template). */
     FString RawPrompt;
     bool bUseRawCompletion = false;
+
+    /** Reply constraint forwarded as llama-server `grammar` (GBNF) or `json_schema`. Grammar wins if both are set. */
+    FString Grammar;
+    FString JsonSchema;
 };
 
 /**
@@ -12,25 +12,128 @@
 
 #include "hnswlib/hnswlib.h"
 
+#include <algorithm>
 #include <random>
 
 namespace
 {
     // Versioned magic header so future format changes don't silently corrupt loads.
+    // v2 adds Quantization + RescoreMultiplier after the HNSW params.
+    // v3 adds bKeepFloatVectors and the kept float vectors after the text sidecar.
     constexpr uint32 VDB_MAGIC = 0x56444231; // 'VDB1'
-    constexpr uint32 VDB_VERSION = 1;
+    constexpr uint32 VDB_VERSION = 3;
+
+    // DataSize comes first: hnswlib's getDataByLabel reads the leading size_t of the dist param
+    // as the element count, so getDataByLabel<uint8> returns the whole code.
+    struct FQuantizedSpaceParams
+    {
+        size_t DataSize = 0;
+        size_t Dimensions = 0;
+    };
+
+    // Int8 codes: Dimensions signed bytes then the float scale. Distance is L2 between the dequantized
+    // vectors, expanded so the inner loop stays in integers.
+    class FInt8L2Space : public hnswlib::SpaceInterface<float>
+    {
+    public:
+        explicit FInt8L2Space(size_t Dimensions)
+        {
+            SpaceParams.Dimensions = Dimensions;
+            SpaceParams.DataSize = Dimensions + sizeof(float);
+        }
+
+        size_t get_data_size() override { return SpaceParams.DataSize; }
+        hnswlib::DISTFUNC<float> get_dist_func() override { return &Distance; }
+        void* get_dist_func_param() override { return &SpaceParams; }
+
+        static float Distance(const void* A, const void* B, const void* Param)
+        {
+            const size_t Dimensions = static_cast<const FQuantizedSpaceParams*>(Param)->Dimensions;
+            const int8* CodeA = static_cast<const int8*>(A);
+            const int8* CodeB = static_cast<const int8*>(B);
+
+            int32 AA = 0, BB = 0, AB = 0;
+            for (size_t i = 0; i < Dimensions; ++i)
+            {
+                const int32 ValA = CodeA[i];
+                const int32 ValB = CodeB[i];
+                AA += ValA * ValA;
+                BB += ValB * ValB;
+                AB += ValA * ValB;
+            }
+
+            float ScaleA, ScaleB;
+            FMemory::Memcpy(&ScaleA, CodeA + Dimensions, sizeof(float));
+            FMemory::Memcpy(&ScaleB, CodeB + Dimensions, sizeof(float));
+            return FMath::Max(ScaleA * ScaleA * AA + ScaleB * ScaleB * BB - 2.f * ScaleA * ScaleB * AB, 0.f);
+        }
+
+    private:
+        FQuantizedSpaceParams SpaceParams;
+    };
+
+    // Binary codes: one sign bit per dimension in 64-bit words. Hamming distance, scaled to the squared L2
+    // between the +-1/sqrt(D) sign vectors so values sit in the same range as normalized float L2.
+    class FBinaryHammingSpace : public hnswlib::SpaceInterface<float>
+    {
+    public:
+        explicit FBinaryHammingSpace(size_t Dimensions)
+        {
+            SpaceParams.Dimensions = Dimensions;
+            SpaceParams.DataSize = ((Dimensions + 63) / 64) * sizeof(uint64);
+        }
+
+        size_t get_data_size() override { return SpaceParams.DataSize; }
+        hnswlib::DISTFUNC<float> get_dist_func() override { return &Distance; }
+        void* get_dist_func_param() override { return &SpaceParams; }
+
+        static float Distance(const void* A, const void* B, const void* Param)
+        {
+            const FQuantizedSpaceParams* SP = static_cast<const FQuantizedSpaceParams*>(Param);
+            const uint8* BytesA = static_cast<const uint8*>(A);
+            const uint8* BytesB = static_cast<const uint8*>(B);
+
+            uint32 Hamming = 0;
+            for (size_t Offset = 0; Offset < SP->DataSize; Offset += sizeof(uint64))
+            {
+                uint64 WordA, WordB;
+                FMemory::Memcpy(&WordA, BytesA + Offset, sizeof(uint64));
+                FMemory::Memcpy(&WordB, BytesB + Offset, sizeof(uint64));
+                Hamming += static_cast<uint32>(FPlatformMath::CountBits(WordA ^ WordB));
+            }
+            return 4.f * static_cast<float>(Hamming) / static_cast<float>(SP->Dimensions);
+        }
+
+    private:
+        FQuantizedSpaceParams SpaceParams;
+    };
+
+    static TUniquePtr<hnswlib::SpaceInterface<float>> MakeSpace(const FVectorDBParams& Params)
+    {
+        const size_t Dimensions = static_cast<size_t>(Params.Dimensions);
+        switch (Params.Quantization)
+        {
+        case EVectorQuantization::Int8:   return MakeUnique<FInt8L2Space>(Dimensions);
+        case EVectorQuantization::Binary: return MakeUnique<FBinaryHammingSpace>(Dimensions);
+        default:                          return MakeUnique<hnswlib::L2Space>(Dimensions);
+        }
+    }
 }
 
 class FHNSWPrivate
 {
 public:
-    TUniquePtr<hnswlib::L2Space> Space;
+    TUniquePtr<hnswlib::SpaceInterface<float>> Space;
     hnswlib::HierarchicalNSW<float>* HNSW = nullptr;
 
+    // Original vectors of a quantized index, by label, when Params.bKeepFloatVectors is set
+    TMap<int64, TArray<float>> FloatVectors;
+    FCriticalSection FloatLock;
+
     void Initialize(const FVectorDBParams& Params)
     {
         Release();
-        Space = MakeUnique<hnswlib::L2Space>(static_cast<size_t>(Params.Dimensions));
+        Space = MakeSpace(Params);
         HNSW = new hnswlib::HierarchicalNSW<float>(
             Space.Get(),
             static_cast<size_t>(Params.MaxElements),
@@ -42,7 +145,7 @@ public:
     bool LoadFromFile(const FVectorDBParams& Params, const std::string& Path)
     {
         Release();
-        Space = MakeUnique<hnswlib::L2Space>(static_cast<size_t>(Params.Dimensions));
+        Space = MakeSpace(Params);
         try
         {
             HNSW = new hnswlib::HierarchicalNSW<float>(
@@ -68,6 +171,9 @@ public:
             HNSW = nullptr;
         }
         Space.Reset();
+
+        FScopeLock Lock(&FloatLock);
+        FloatVectors.Empty();
     }
 
     ~FHNSWPrivate() { Release(); }
@@ -138,8 +244,23 @@ void FVectorDatabase::AddVectorEmbeddingIdPair(const TArray<float>& Embedding, i
         return;
     }
 
-    Private->HNSW->addPoint(static_cast<const void*>(Embedding.GetData()),
+    if (Params.Quantization == EVectorQuantization::Float32)
+    {
+        Private->HNSW->addPoint(static_cast<const void*>(Embedding.GetData()),
+                                static_cast<hnswlib::labeltype>(UniqueId));
+        return;
+    }
+
+    TArray<uint8> Code;
+    QuantizeEmbedding(Embedding, Params.Quantization, Code);
+    Private->HNSW->addPoint(static_cast<const void*>(Code.GetData()),
                             static_cast<hnswlib::labeltype>(UniqueId));
+
+    if (Params.bKeepFloatVectors)
+    {
+        FScopeLock Lock(&Private->FloatLock);
+        Private->FloatVectors.Add(UniqueId, Embedding);
+    }
 }
 
 int64 FVectorDatabase::AddVectorEmbeddingStringPair(const TArray<float>& Embedding, const FString& Text)
@@ -199,10 +320,60 @@ void FVectorDatabase::FindNearestNIds(TArray<int64>& OutIds, TArray<float>& OutD
     }
     if (Private->HNSW->getCurrentElementCount() == 0) { return; }
 
+    // Quantized indexes search with the quantized query over N * RescoreMultiplier candidates.
+    const bool bQuantized = Params.Quantization != EVectorQuantization::Float32;
+    const bool bRescore = bQuantized && Params.RescoreMultiplier > 1;
+    TArray<uint8> QueryCode;
+    const void* Query = ForEmbedding.GetData();
+    if (bQuantized)
+    {
+        QuantizeEmbedding(ForEmbedding, Params.Quantization, QueryCode);
+        Query = QueryCode.GetData();
+    }
+    const int32 SearchK = bRescore ? N * Params.RescoreMultiplier : N;
+
     // hnswlib returns a max-heap of (distance, label); top is FARTHEST among the K.
     // Pop into temp arrays and reverse so index 0 is the nearest.
     std::priority_queue<std::pair<float, hnswlib::labeltype>> Results =
-        Private->HNSW->searchKnn(static_cast<const void*>(ForEmbedding.GetData()), static_cast<size_t>(N));
+        Private->HNSW->searchKnn(Query, static_cast<size_t>(SearchK));
+
+    if (bRescore)
+    {
+        // Re-rank by L2 between the float query and each candidate's kept float vector, or its
+        // dequantized code when the floats weren't kept.
+        std::vector<std::pair<float, hnswlib::labeltype>> Rescored;
+        Rescored.reserve(Results.size());
+        TArray<float> Dequantized;
+        FScopeLock Lock(&Private->FloatLock);
+        for (; !Results.empty(); Results.pop())
+        {
+            const hnswlib::labeltype Label = Results.top().second;
+            const TArray<float>* Candidate = Private->FloatVectors.Find(static_cast<int64>(Label));
+            if (!Candidate)
+            {
+                auto Code = Private->HNSW->getDataByLabelNoExceptions<uint8>(Label);
+                if (!Code.ok()) { continue; }
+
+                DequantizeEmbedding(Code.value().data(), Params.Dimensions, Params.Quantization, Dequantized);
+                Candidate = &Dequantized;
+            }
+
+            float Distance = 0.f;
+            for (int32 d = 0; d < Params.Dimensions; ++d)
+            {
+                const float Diff = ForEmbedding[d] - (*Candidate)[d];
+                Distance += Diff * Diff;
+            }
+            Rescored.emplace_back(Distance, Label);
+        }
+
+        std::sort(Rescored.begin(), Rescored.end());
+        Rescored.resize(FMath::Min(static_cast<size_t>(N), Rescored.size()));
+        for (const auto& Pair : Rescored)
+        {
+            Results.push(Pair);
+        }
+    }
 
     const int32 Count = static_cast<int32>(Results.size());
     OutIds.SetNumUninitialized(Count);
@@ -256,6 +427,91 @@ bool FVectorDatabase::TryGetText(int64 UniqueId, FString& OutText) const
     return false;
 }
 
+// ---- Quantization -----------------------------------------------------------
+
+int32 FVectorDatabase::GetCodeSize(int32 Dimensions, EVectorQuantization Quantization)
+{
+    switch (Quantization)
+    {
+    case EVectorQuantization::Int8:   return Dimensions + static_cast<int32>(sizeof(float));
+    case EVectorQuantization::Binary: return ((Dimensions + 63) / 64) * static_cast<int32>(sizeof(uint64));
+    default:                          return Dimensions * static_cast<int32>(sizeof(float));
+    }
+}
+
+void FVectorDatabase::QuantizeEmbedding(const TArray<float>& Embedding, EVectorQuantization Quantization, TArray<uint8>& OutCode)
+{
+    const int32 D = Embedding.Num();
+    OutCode.SetNumZeroed(GetCodeSize(D, Quantization));
+
+    switch (Quantization)
+    {
+    case EVectorQuantization::Int8:
+    {
+        // Symmetric per-vector scale: the largest magnitude maps to 127.
+        float MaxAbs = 0.f;
+        for (const float Value : Embedding)
+        {
+            MaxAbs = FMath::Max(MaxAbs, FMath::Abs(Value));
+        }
+        const float Scale = MaxAbs > 0.f ? MaxAbs / 127.f : 1.f;
+        int8* Code = reinterpret_cast<int8*>(OutCode.GetData());
+        for (int32 i = 0; i < D; ++i)
+        {
+            Code[i] = static_cast<int8>(FMath::Clamp(FMath::RoundToInt(Embedding[i] / Scale), -127, 127));
+        }
+        FMemory::Memcpy(OutCode.GetData() + D, &Scale, sizeof(float));
+        break;
+    }
+    case EVectorQuantization::Binary:
+    {
+        for (int32 i = 0; i < D; ++i)
+        {
+            if (Embedding[i] > 0.f)
+            {
+                OutCode[i / 8] |= static_cast<uint8>(1u << (i % 8));
+            }
+        }
+        break;
+    }
+    default:
+        FMemory::Memcpy(OutCode.GetData(), Embedding.GetData(), OutCode.Num());
+        break;
+    }
+}
+
+void FVectorDatabase::DequantizeEmbedding(const uint8* Code, int32 Dimensions, EVectorQuantization Quantization, TArray<float>& OutEmbedding)
+{
+    OutEmbedding.SetNumUninitialized(Dimensions);
+
+    switch (Quantization)
+    {
+    case EVectorQuantization::Int8:
+    {
+        float Scale;
+        FMemory::Memcpy(&Scale, Code + Dimensions, sizeof(float));
+        const int8* Values = reinterpret_cast<const int8*>(Code);
+        for (int32 i = 0; i < Dimensions; ++i)
+        {
+            OutEmbedding[i] = Values[i] * Scale;
+        }
+        break;
+    }
+    case EVectorQuantization::Binary:
+    {
+        const float Magnitude = 1.f / FMath::Sqrt(static_cast<float>(FMath::Max(Dimensions, 1)));
+        for (int32 i = 0; i < Dimensions; ++i)
+        {
+            OutEmbedding[i] = (Code[i / 8] >> (i % 8)) & 1 ? Magnitude : -Magnitude;
+        }
+        break;
+    }
+    default:
+        FMemory::Memcpy(OutEmbedding.GetData(), Code, Dimensions * sizeof(float));
+        break;
+    }
+}
+
 // ---- Persistence ------------------------------------------------------------
 
 bool FVectorDatabase::Save(const FString& FilePath) const
@@ -312,6 +568,11 @@ bool FVectorDatabase::Save(const FString& FilePath) const
     int32 EFQ    = Params.EFQuery;
     Writer << Dim << MaxEl << M << EFC << EFQ;
 
+    uint8 Quant  = static_cast<uint8>(Params.Quantization);
+    int32 Rescore = Params.RescoreMultiplier;
+    uint8 KeepFloats = Params.bKeepFloatVectors ? 1 : 0;
+    Writer << Quant << Rescore << KeepFloats;
+
     int64 MaxIdCopy;
     {
         FScopeLock Lock(&TextLock);
@@ -329,6 +590,18 @@ bool FVectorDatabase::Save(const FString& FilePath) const
         }
     }
 
+    {
+        FScopeLock Lock(&Private->FloatLock);
+        int32 FloatCount = Private->FloatVectors.Num();
+        Writer << FloatCount;
+        for (auto& Pair : Private->FloatVectors)
+        {
+            int64 K = Pair.Key;
+            Writer << K;
+            Writer << Pair.Value;
+        }
+    }
+
     int64 HnswSize = static_cast<int64>(HnswBytes.Num());
     Writer << HnswSize;
     Writer.Serialize(HnswBytes.GetData(), HnswBytes.Num());
@@ -354,9 +627,9 @@ bool FVectorDatabase::Load(const FString& FilePath)
         UE_LOG(LlamaLog, Warning, TEXT("FVectorDatabase::Load bad magic in %s"), *FilePath);
         return false;
     }
-    if (Version != VDB_VERSION)
+    if (Version < 1 || Version > VDB_VERSION)
     {
-        UE_LOG(LlamaLog, Warning, TEXT("FVectorDatabase::Load version mismatch %u != %u"), Version, VDB_VERSION);
+        UE_LOG(LlamaLog, Warning, TEXT("FVectorDatabase::Load unsupported version %u (max %u)"), Version, VDB_VERSION);
         return false;
     }
 
@@ -369,6 +642,27 @@ bool FVectorDatabase::Load(const FString& FilePath)
     Params.EFConstruction = EFC;
     Params.EFQuery        = EFQ;
 
+    // v1 files predate quantization and are always float.
+    uint8 Quant = static_cast<uint8>(EVectorQuantization::Float32);
+    int32 Rescore = Params.RescoreMultiplier;
+    uint8 KeepFloats = 0;
+    if (Version >= 2)
+    {
+        Reader << Quant << Rescore;
+    }
+    if (Version >= 3)
+    {
+        Reader << KeepFloats;
+    }
+    if (Quant > static_cast<uint8>(EVectorQuantization::Binary))
+    {
+        UE_LOG(LlamaLog, Warning, TEXT("FVectorDatabase::Load unknown quantization %u in %s"), Quant, *FilePath);
+        return false;
+    }
+    Params.Quantization      = static_cast<EVectorQuantization>(Quant);
+    Params.RescoreMultiplier = Rescore;
+    Params.bKeepFloatVectors = KeepFloats != 0;
+
     int64 MaxIdRead = 0;
     int32 TextCount = 0;
     Reader << MaxIdRead;
@@ -385,6 +679,33 @@ bool FVectorDatabase::Load(const FString& FilePath)
         NewText.Add(K, MoveTemp(V));
     }
 
+    // v2 and older quantized files didn't keep floats, their rescoring stays on the dequantized codes
+    TMap<int64, TArray<float>> NewFloats;
+    if (Version >= 3)
+    {
+        int32 FloatCount = 0;
+        Reader << FloatCount;
+        if (FloatCount < 0 || static_cast<int64>(FloatCount) * Dim * sizeof(float) > Buffer.Num())
+        {
+            UE_LOG(LlamaLog, Warning, TEXT("FVectorDatabase::Load suspicious float vector count %d"), FloatCount);
+            return false;
+        }
+        NewFloats.Reserve(FloatCount);
+        for (int32 i = 0; i < FloatCount; ++i)
+        {
+            int64 K = 0;
+            TArray<float> V;
+            Reader << K;
+            Reader << V;
+            if (V.Num() != Dim)
+            {
+                UE_LOG(LlamaLog, Warning, TEXT("FVectorDatabase::Load float vector %lld has %d dims, expected %d"), K, V.Num(), Dim);
+                return false;
+            }
+            NewFloats.Add(K, MoveTemp(V));
+        }
+    }
+
     int64 HnswSize = 0;
     Reader << HnswSize;
     if (HnswSize <= 0 || HnswSize > static_cast<int64>(Buffer.Num()))
@@ -410,6 +731,11 @@ bool FVectorDatabase::Load(const FString& FilePath)
 
     if (!bOk) { return false; }
 
+    {
+        FScopeLock Lock(&Private->FloatLock);
+        Private->FloatVectors = MoveTemp(NewFloats);
+    }
+
     {
         FScopeLock Lock(&TextLock);
         TextDatabase = MoveTemp(NewText);
@@ -27,6 +27,38 @@ namespace
     {
         return TArray<float>(Data.GetData() + Index * D, D);
     }
+
+    // Zero-mean, L2-normalized, like embedder output. Uniform [0,1) data has every sign bit set.
+    // Scattered around random cluster centers so neighbors are actually near and top-K overlap measures
+    // ranking, isotropic noise leaves every vector about equally far from all others.
+    static void FillClusteredVectors(TArray<float>& OutData, int32 D, int32 N, int32 Clusters, float Spread, uint32 Seed)
+    {
+        std::mt19937 Rng(Seed);
+        std::normal_distribution<float> Dist;
+        TArray<float> Centers;
+        Centers.SetNumUninitialized(D * Clusters);
+        for (float& Value : Centers)
+        {
+            Value = Dist(Rng);
+        }
+
+        OutData.SetNumUninitialized(D * N);
+        for (int32 i = 0; i < N; ++i)
+        {
+            const float* Center = Centers.GetData() + (i % Clusters) * D;
+            float SumSq = 0.f;
+            for (int32 d = 0; d < D; ++d)
+            {
+                OutData[i * D + d] = Center[d] + Spread * Dist(Rng);
+                SumSq += OutData[i * D + d] * OutData[i * D + d];
+            }
+            const float InvNorm = 1.f / FMath::Sqrt(SumSq);
+            for (int32 d = 0; d < D; ++d)
+            {
+                OutData[i * D + d] *= InvNorm;
+            }
+        }
+    }
 }
 
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVectorDatabaseSelfRecallTest,
@@ -211,4 +243,106 @@ bool FVectorDatabaseDimMismatchTest::RunTest(const FString& /*Parameters*/)
     return true;
 }
 
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVectorDatabaseQuantizedTest,
+    "LlamaTools.VectorDatabase.Quantized",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVectorDatabaseQuantizedTest::RunTest(const FString& /*Parameters*/)
+{
+    constexpr int32 D = 128;
+    constexpr int32 N = 500;
+    constexpr int32 K = 10;
+
+    TArray<float> Data;
+    FillClusteredVectors(Data, D, N, 20, 0.5f, 53u);
+
+    // Float index is the reference for top-K overlap
+    FVectorDatabase Reference;
+    Reference.Params.Dimensions = D;
+    Reference.Params.MaxElements = N;
+    Reference.InitializeDB();
+    for (int32 i = 0; i < N; ++i)
+    {
+        Reference.AddVectorEmbeddingIdPair(SliceVector(Data, i, D), i);
+    }
+
+    const EVectorQuantization Modes[] = { EVectorQuantization::Int8, EVectorQuantization::Binary };
+    for (const EVectorQuantization Mode : Modes)
+    {
+        const TCHAR* Name = Mode == EVectorQuantization::Int8 ? TEXT("Int8") : TEXT("Binary");
+
+        FVectorDatabase DB;
+        DB.Params.Dimensions = D;
+        DB.Params.MaxElements = N;
+        DB.Params.Quantization = Mode;
+        DB.Params.RescoreMultiplier = 8;
+        DB.InitializeDB();
+        for (int32 i = 0; i < N; ++i)
+        {
+            DB.AddVectorEmbeddingIdPair(SliceVector(Data, i, D), i);
+        }
+
+        int32 SelfHits = 0;
+        int32 Overlap = 0;
+        for (int32 i = 0; i < N; ++i)
+        {
+            const TArray<float> Query = SliceVector(Data, i, D);
+
+            TArray<int64> Ids, RefIds;
+            TArray<float> Distances;
+            DB.FindNearestNIds(Ids, Distances, Query, K);
+            Reference.FindNearestNIds(RefIds, Query, K);
+
+            if (Ids.Num() > 0 && Ids[0] == i) { ++SelfHits; }
+            for (const int64 Id : Ids)
+            {
+                Overlap += RefIds.Contains(Id) ? 1 : 0;
+            }
+            for (int32 r = 1; r < Distances.Num(); ++r)
+            {
+                if (Distances[r - 1] > Distances[r] + 1e-5f)
+                {
+                    AddError(FString::Printf(TEXT("%s: rescored distances not sorted for query %d"), Name, i));
+                    break;
+                }
+            }
+        }
+
+        const float SelfRecall = static_cast<float>(SelfHits) / N;
+        const float TopKRecall = static_cast<float>(Overlap) / (N * K);
+        AddInfo(FString::Printf(TEXT("%s: self recall %.3f, top-%d overlap with float %.3f"), Name, SelfRecall, K, TopKRecall));
+        TestTrue(FString::Printf(TEXT("%s self recall %.3f >= 0.95"), Name, SelfRecall), SelfRecall >= 0.95f);
+        TestTrue(FString::Printf(TEXT("%s top-%d overlap %.3f >= 0.9"), Name, K, TopKRecall), TopKRecall >= 0.9f);
+    }
+
+    // Quantization and the kept float vectors survive Save/Load
+    const FString TmpPath = FPaths::ProjectIntermediateDir() / TEXT("LlamaCoreTests") / TEXT("vdb_binary.vdb");
+    {
+        FVectorDatabase DB;
+        DB.Params.Dimensions = D;
+        DB.Params.MaxElements = N;
+        DB.Params.Quantization = EVectorQuantization::Binary;
+        DB.InitializeDB();
+        for (int32 i = 0; i < N; ++i)
+        {
+            DB.AddVectorEmbeddingIdPair(SliceVector(Data, i, D), i);
+        }
+        TestTrue(TEXT("Save quantized"), DB.Save(TmpPath));
+    }
+    {
+        FVectorDatabase DB;
+        TestTrue(TEXT("Load quantized"), DB.Load(TmpPath));
+        TestTrue(TEXT("Quantization restored"), DB.Params.Quantization == EVectorQuantization::Binary);
+        TestTrue(TEXT("Float vectors kept"), DB.Params.bKeepFloatVectors);
+
+        TArray<int64> Ids;
+        TArray<float> Distances;
+        DB.FindNearestNIds(Ids, Distances, SliceVector(Data, 7, D), 1);
+        TestTrue(TEXT("Nearest after load"), Ids.Num() == 1 && Ids[0] == 7);
+        TestTrue(TEXT("Rescored against the float vector, not its signs"), Distances.Num() == 1 && Distances[0] < 1e-4f);
+    }
+    IFileManager::Get().Delete(*TmpPath, false, true, true);
+    return true;
+}
+
 #endif // WITH_DEV_AUTOMATION_TESTS
@@ -6,6 +6,18 @@
 #include "HAL/CriticalSection.h"
 #include "VectorDatabase.generated.h"
 
+/** How FVectorDatabase stores vectors. Embeddings are always passed in and queried as float. */
+UENUM(BlueprintType)
+enum class EVectorQuantization : uint8
+{
+    /** 4 bytes per dimension, exact L2. */
+    Float32 UMETA(DisplayName = "Float32"),
+    /** 1 byte per dimension plus a per-vector scale, ~4x smaller. */
+    Int8    UMETA(DisplayName = "Int8"),
+    /** 1 bit per dimension (sign), ~32x smaller, Hamming distance. Pair with rescoring. */
+    Binary  UMETA(DisplayName = "Binary")
+};
+
 USTRUCT(BlueprintType)
 struct FVectorDBParams
 {
@@ -31,6 +43,21 @@ struct FVectorDBParams
     // Query-time search depth. Higher = better recall but slower queries.
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "VectorDB Params")
     int32 EFQuery = 64;
+
+    // Storage format of the index. Quantized indexes search in their own space, then rescore.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "VectorDB Params")
+    EVectorQuantization Quantization = EVectorQuantization::Float32;
+
+    // Quantized indexes only: fetch N * RescoreMultiplier candidates and re-rank them by L2 between the
+    // float query and the dequantized vectors. 1 disables rescoring (distances stay in the quantized space).
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "VectorDB Params", meta = (ClampMin = 1))
+    int32 RescoreMultiplier = 4;
+
+    // Quantized indexes only: keep the float vectors next to the codes (in memory and in saved files) and
+    // rescore against them instead of the dequantized codes. The graph and its search stay compact, but the
+    // memory saving is lost. Binary rankings barely improve without it, the signs are all rescoring sees.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "VectorDB Params")
+    bool bKeepFloatVectors = true;
 };
 
 
@@ -39,6 +66,11 @@ struct FVectorDBParams
  * float embeddings. L2 distance metric (works as cosine when input is L2-normalized — which
  * `FLlamaInternal::GetPromptEmbeddings` produces by default).
  *
+ * Quantization: with Params.Quantization set to Int8 or Binary, vectors are quantized on add and the
+ * HNSW graph is built and searched over the compact codes. The top candidates are then rescored against
+ * the float query, so returned distances are L2 to the kept float vectors (Params.bKeepFloatVectors) or
+ * to the dequantized ones.
+ *
  * Thread-safety: hnswlib's add/search are concurrent-safe on the same instance. The
  * accompanying TextDatabase is guarded internally by a critical section.
  *
@@ -102,6 +134,18 @@ public:
     /** Lookup the text for a given id. Returns true and sets OutText on hit. */
     bool TryGetText(int64 UniqueId, FString& OutText) const;
 
+    /**
+     * Encode a float vector the way the index stores it under Quantization: Int8 is Num() signed bytes
+     * followed by a float scale, Binary is sign bits packed into 64-bit words. Float32 copies the bytes.
+     */
+    static void QuantizeEmbedding(const TArray<float>& Embedding, EVectorQuantization Quantization, TArray<uint8>& OutCode);
+
+    /** Inverse of QuantizeEmbedding. Binary decodes to +-1/sqrt(Dimensions), the L2-normalized sign vector. */
+    static void DequantizeEmbedding(const uint8* Code, int32 Dimensions, EVectorQuantization Quantization, TArray<float>& OutEmbedding);
+
+    /** Bytes one stored vector takes in the index for these params. */
+    static int32 GetCodeSize(int32 Dimensions, EVectorQuantization Quantization);
+
     // ---- Persistence --------------------------------------------------------
 
     /** Persist the full database (HNSW + text sidecar + Params) to a single .vdb file. */